@@ -0,0 +1,760 @@
+#include "emitter.hpp"
+#include "generator.hpp"
+
+#include "arena.hpp"
+#include "bytecode.hpp"
+#include "code_cache.hpp"
+#include "codegen.hpp"
+#include "error.hpp"
+#include "incremental.hpp"
+#include "interner.hpp"
+#include "ir.hpp"
+#include "ir_passes.hpp"
+#include "lexer.hpp"
+#include "line_table.hpp"
+#include "parser.hpp"
+#include "pipelined_lexer.hpp"
+#include "regalloc.hpp"
+#include "resolver.hpp"
+#include "source.hpp"
+#include "stats.hpp"
+#include "task_scheduler.hpp"
+#include "token_array.hpp"
+#include "type_table.hpp"
+#include "vm.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Microbenchmarks over a generated program. Each phase runs `repeat` times
+// and the fastest run is reported, as one JSON object so that reports from
+// two builds can be diffed or compared by a script.
+//
+//   bench [--functions=N] [--depth=N] [--expr=N] [--identifiers=N]
+//         [--comments=PERCENT] [--seed=N] [--repeat=N]
+//         [--fib=N] [--locals=N] [--workers=N] [--out=report.json]
+//         [--write-source=program.txt]
+//
+// The interpreter is measured separately on a call-heavy program, a naive
+// recursive fib(N), since generated programs are not meant to be run. The
+// register allocator is also run on one function with N locals, to show
+// how it scales with function size. Code generation is timed on one worker
+// and on `workers` (one per core by default), also with that large
+// function added to the program to make function sizes uneven, and then
+// with a code cache: cold, warm, for an unchanged file, and with one or a
+// tenth of the functions changed. Last, single-function edits are
+// reparsed incrementally, timed against a full parse and checked to give
+// the same tree.
+
+namespace {
+
+struct BenchOptions {
+    GeneratorOptions program;
+    uint32_t repeat  = 5;
+    uint32_t fib     = 27;
+    uint32_t locals  = 20000;
+    unsigned workers = std::max(1u, std::thread::hardware_concurrency());
+    const char* report_path = nullptr; // stdout when unset
+    const char* source_path = nullptr; // also write the generated program here
+};
+
+using Clock = std::chrono::steady_clock;
+
+template<typename F>
+double best_of(uint32_t repeat, F&& run) {
+    double best = 1e300;
+    for (uint32_t i = 0; i < repeat; i++) {
+        auto start = Clock::now();
+        run();
+        double s = std::chrono::duration<double>(Clock::now() - start).count();
+        best     = std::min(best, s);
+    }
+    return best;
+}
+
+// Minimal JSON writer for a flat report of named numbers.
+class Report {
+  public:
+    void begin(std::string_view name) {
+        separator();
+        text += '"';
+        text += name;
+        text += "\":{";
+        first = true;
+    }
+
+    void end() {
+        text += '}';
+        first = false;
+    }
+
+    void number(std::string_view name, double value) {
+        char buf[64];
+        std::snprintf(buf, sizeof buf, "%.6g", value);
+        field(name, buf);
+    }
+
+    void integer(std::string_view name, uint64_t value) { field(name, std::to_string(value)); }
+
+    std::string finish() { return "{" + text + "}\n"; }
+
+  private:
+    std::string text;
+    bool first = true;
+
+    void separator() {
+        if (!first)
+            text += ',';
+        first = false;
+    }
+
+    void field(std::string_view name, std::string_view value) {
+        separator();
+        text += '"';
+        text += name;
+        text += "\":";
+        text += value;
+    }
+};
+
+bool parse_uint(std::string_view arg, std::string_view flag, uint64_t& out) {
+    if (!arg.starts_with(flag))
+        return false;
+
+    std::string value(arg.substr(flag.size()));
+    out = std::stoull(value);
+    return true;
+}
+
+bool parse_args(int argc, char* argv[], BenchOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+        uint64_t n;
+
+        try {
+            if (parse_uint(arg, "--functions=", n))
+                options.program.functions = n;
+            else if (parse_uint(arg, "--depth=", n))
+                options.program.depth = n;
+            else if (parse_uint(arg, "--expr=", n))
+                options.program.expr_size = n;
+            else if (parse_uint(arg, "--identifiers=", n))
+                options.program.identifiers = n;
+            else if (parse_uint(arg, "--comments=", n))
+                options.program.comments = n;
+            else if (parse_uint(arg, "--seed=", n))
+                options.program.seed = n;
+            else if (parse_uint(arg, "--repeat=", n))
+                options.repeat = n ? n : 1;
+            else if (parse_uint(arg, "--fib=", n))
+                options.fib = n;
+            else if (parse_uint(arg, "--locals=", n))
+                options.locals = n;
+            else if (parse_uint(arg, "--workers=", n))
+                options.workers = n ? n : 1;
+            else if (arg.starts_with("--out="))
+                options.report_path = argv[i] + 6;
+            else if (arg.starts_with("--write-source="))
+                options.source_path = argv[i] + 15;
+            else {
+                std::cerr << "unknown option " << arg << std::endl;
+                return false;
+            }
+        } catch (const std::exception&) {
+            std::cerr << "invalid value in " << arg << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string fib_program(uint32_t n) {
+    std::string out = "function fib(n: i32) => i32 {\n"
+                      "    if n < 2 {\n"
+                      "        return n;\n"
+                      "    }\n"
+                      "    return fib(n - 1) + fib(n - 2);\n"
+                      "}\n"
+                      "\n"
+                      "function main() => i32 {\n"
+                      "    return fib(";
+    out += std::to_string(n);
+    out += ");\n}\n";
+    return out;
+}
+
+// One function with `n` locals. Each is computed from the one before it and
+// one from halfway back, so about n / 2 values are live at a time, and
+// every eighth comes from a call.
+std::string locals_program(uint32_t n) {
+    std::string out = "function g(a: i32, b: i32) => i32 {\n"
+                      "    return a - b;\n"
+                      "}\n"
+                      "\n"
+                      "function f(x: i32) => i32 {\n"
+                      "    let v0: i32 = x;\n";
+    for (uint32_t i = 1; i < n; i++) {
+        out += "    let v";
+        out += std::to_string(i);
+        out += ": i32 = ";
+        out += i % 8 == 0 ? "g(v" : "v";
+        out += std::to_string(i - 1);
+        out += i % 8 == 0 ? ", v" : i % 2 ? " + v" : " * v";
+        out += std::to_string(i / 2);
+        out += i % 8 == 0 ? ");\n" : ";\n";
+    }
+    out += "    return v";
+    out += std::to_string(n ? n - 1 : 0);
+    out += ";\n}\n";
+    return out;
+}
+
+// Allocates registers for every function of `module`, returning the
+// totals in `sum`.
+double allocate_module(const IrModule& module, uint32_t repeat, Allocation& sum) {
+    return best_of(repeat, [&] {
+        sum = Allocation{};
+        for (const IrFunction& f : module.functions) {
+            Allocation a = allocate_registers(f);
+            sum.intervals += a.intervals;
+            sum.spilled += a.spilled;
+            sum.coalesced += a.coalesced;
+        }
+    });
+}
+
+void bench_regalloc(const BenchOptions& options, const IrModule& program, Report& report) {
+    Allocation sum;
+    double seconds = allocate_module(program, options.repeat, sum);
+
+    report.begin("regalloc");
+    report.number("seconds", seconds);
+    report.integer("intervals", sum.intervals);
+    report.number("intervals_per_s", sum.intervals / seconds);
+    report.integer("spilled", sum.spilled);
+    report.integer("coalesced", sum.coalesced);
+
+    Source source("<locals>", locals_program(options.locals));
+    Arena lexer_arena;
+    Arena parser_arena;
+    Arena resolver_arena;
+    Arena ir_arena;
+    Interner interner;
+    TypeTable types;
+
+    Lexer lexer(source, lexer_arena);
+    Parser parser(lexer, parser_arena, interner, types);
+    auto fns = parser.parse();
+    Resolver(source, resolver_arena, interner).resolve(fns);
+    IrModule module = lower_ir(fns, interner, ir_arena);
+    (void)PassManager::standard().run(module);
+
+    double wide = allocate_module(module, options.repeat, sum);
+    report.integer("locals", options.locals);
+    report.number("locals_seconds", wide);
+    report.integer("locals_intervals", sum.intervals);
+    report.number("locals_intervals_per_s", sum.intervals / wide);
+    report.integer("locals_spilled", sum.spilled);
+    report.end();
+}
+
+// Generates IR for `text` on `workers` threads, returning the best time and
+// how many tasks were stolen in the last run. With `cache_dir` each run
+// opens the code cache there, and its accounting on close is timed too.
+double generate(const std::string& text, unsigned workers, uint32_t repeat, uint64_t& steals,
+                const char* cache_dir = nullptr) {
+    Source source("<codegen>", text);
+    Arena lexer_arena;
+    Arena parser_arena;
+    Arena resolver_arena;
+    Arena ir_arena;
+    Interner interner;
+    TypeTable types;
+
+    Lexer lexer(source, lexer_arena);
+    Parser parser(lexer, parser_arena, interner, types);
+    auto fns = parser.parse();
+    Resolver(source, resolver_arena, interner).resolve(fns);
+
+    TaskScheduler scheduler(workers);
+    return best_of(repeat, [&] {
+        ir_arena.reset();
+        std::optional<CodeCache> cache;
+        if (cache_dir)
+            cache.emplace(cache_dir, uint64_t(1) << 30);
+
+        CodegenOptions codegen{
+            .format = EmitFormat::Ir,
+            .cache  = cache ? &*cache : nullptr,
+            .source = source.text(),
+            .path   = "<codegen>",
+        };
+        Emitter out(interner);
+        uint64_t before = scheduler.steals();
+        generate_code(fns, interner, codegen, scheduler, ir_arena, out);
+        steals = scheduler.steals() - before;
+    });
+}
+
+void bench_scheduler(const BenchOptions& options, const std::string& program, Report& report) {
+    std::string uneven = program;
+    uneven += locals_program(options.locals);
+
+    uint64_t steals = 0;
+    double one      = generate(program, 1, options.repeat, steals);
+    double all      = generate(program, options.workers, options.repeat, steals);
+
+    report.begin("scheduler");
+    report.integer("workers", options.workers);
+    report.number("seconds_1", one);
+    report.number("seconds", all);
+    report.number("speedup", one / all);
+    report.integer("steals", steals);
+
+    one = generate(uneven, 1, options.repeat, steals);
+    all = generate(uneven, options.workers, options.repeat, steals);
+    report.number("uneven_seconds_1", one);
+    report.number("uneven_seconds", all);
+    report.number("uneven_speedup", one / all);
+    report.integer("uneven_steals", steals);
+    report.end();
+}
+
+// Adds `variant` spaces after the `function` keyword of every `every`th
+// function, which changes their text and so their cache keys but nothing
+// else.
+std::string edit_program(const std::string& program, size_t every, uint32_t variant) {
+    std::string out;
+    size_t count = 0;
+    size_t from  = 0;
+    for (size_t at; (at = program.find("function ", from)) != std::string::npos; from = at + 9) {
+        out.append(program, from, at + 9 - from);
+        if (count++ % every == 0)
+            out.append(variant, ' ');
+    }
+    out.append(program, from);
+    return out;
+}
+
+void bench_code_cache(const BenchOptions& options, const std::string& program, Report& report) {
+    char dir[] = "/tmp/bench-code-cache-XXXXXX";
+    if (!mkdtemp(dir)) {
+        std::cerr << "cannot create a directory for the code cache" << std::endl;
+        return;
+    }
+
+    uint64_t steals = 0;
+    double cold     = generate(program, options.workers, 1, steals, dir);
+    double warm     = generate(program, options.workers, options.repeat, steals, dir);
+
+    // An unchanged file, found through its manifest without being parsed.
+    size_t file_bytes = 0;
+    double file       = best_of(options.repeat, [&] {
+        CodeCache cache(dir, uint64_t(1) << 30);
+        CodegenOptions codegen{
+            .format = EmitFormat::Ir,
+            .cache  = &cache,
+            .source = program,
+            .path   = "<codegen>",
+        };
+        std::optional<std::string> text = cached_output(codegen);
+        file_bytes                      = text ? text->size() : 0;
+    });
+    if (!file_bytes)
+        std::cerr << "unchanged file missed the code cache" << std::endl;
+
+    // Each run edits different text, so none of it is cached yet.
+    double one   = 1e300;
+    double tenth = 1e300;
+    for (uint32_t i = 1; i <= options.repeat; i++) {
+        one   = std::min(one, generate(edit_program(program, SIZE_MAX, i), options.workers, 1, steals, dir));
+        tenth = std::min(tenth, generate(edit_program(program, 10, i), options.workers, 1, steals, dir));
+    }
+
+    std::error_code ignored;
+    std::filesystem::remove_all(dir, ignored);
+
+    report.begin("code_cache");
+    report.number("cold_seconds", cold);
+    report.number("warm_seconds", warm);
+    report.number("unchanged_file_seconds", file);
+    report.number("one_changed_seconds", one);
+    report.number("tenth_changed_seconds", tenth);
+    report.number("warm_speedup", cold / warm);
+    report.end();
+}
+
+// Inserts a space into one function at a time, as an editor would, and
+// reparses after each edit. The reparse is timed against a full parse of
+// the same text, and the final tree must match a fresh parse of it.
+void bench_incremental(const BenchOptions& options, const std::string& program, Report& report) {
+    auto dump = [](const Interner& interner, std::span<FunctionDecl* const> fns) {
+        Emitter out(interner);
+        out.program(fns);
+        return out.take();
+    };
+
+    std::string text = program;
+    Interner interner;
+    IncrementalParser parser(interner);
+    {
+        Source source("<incremental>", text);
+        parser.parse(source);
+    }
+
+    const uint32_t edits = 100 * options.repeat;
+    double reparse       = 1e300;
+    double total         = 0;
+    uint64_t reparsed    = 0;
+    for (uint32_t i = 0; i < edits && !parser.functions().empty(); i++) {
+        const auto& fns        = parser.functions();
+        const FunctionDecl* fn = fns[size_t(i) * 7919 % fns.size()];
+        uint32_t at            = fn->span.begin + 8; // after `function`
+        text.insert(at, " ");
+
+        Source source("<incremental>", text);
+        TextEdit edit{at, at, 1};
+        auto start = Clock::now();
+        parser.reparse(source, {&edit, 1});
+        double s = std::chrono::duration<double>(Clock::now() - start).count();
+        reparse  = std::min(reparse, s);
+        total += s;
+        reparsed += parser.reparsed();
+    }
+
+    Source source("<incremental>", text);
+    Arena lexer_arena;
+    Arena parser_arena;
+    Interner full_interner;
+    TypeTable types;
+    std::vector<FunctionDecl*> fns;
+    double full = best_of(options.repeat, [&] {
+        lexer_arena.reset();
+        parser_arena.reset();
+        Lexer lexer(source, lexer_arena);
+        Parser full_parser(lexer, parser_arena, full_interner, types);
+        fns = full_parser.parse();
+    });
+
+    bool same = dump(interner, parser.functions()) == dump(full_interner, fns);
+    if (!same)
+        std::cerr << "incremental reparse does not match a full parse" << std::endl;
+
+    report.begin("incremental");
+    report.integer("edits", edits);
+    report.number("reparse_seconds", reparse);
+    report.number("mean_reparse_seconds", total / edits);
+    report.number("full_parse_seconds", full);
+    report.number("speedup", full / (total / edits));
+    report.integer("functions_reparsed", reparsed);
+    report.integer("matches_full_parse", same);
+    report.end();
+}
+
+void bench_vm(const BenchOptions& options, Report& report) {
+    Source source("<fib>", fib_program(options.fib));
+    Arena lexer_arena;
+    Arena parser_arena;
+    Arena resolver_arena;
+    Interner interner;
+    TypeTable types;
+
+    Lexer lexer(source, lexer_arena);
+    Parser parser(lexer, parser_arena, interner, types);
+    auto fns = parser.parse();
+    Resolver(source, resolver_arena, interner).resolve(fns);
+
+    Bytecode code;
+    double compile = best_of(options.repeat, [&] { code = compile_bytecode(fns, interner); });
+
+    Vm vm(code, interner);
+    auto main      = static_cast<uint32_t>(code.find(interner.intern("main")));
+    int64_t value  = 0;
+    uint64_t calls = 0;
+    double run     = best_of(options.repeat, [&] {
+        uint64_t before = vm.calls();
+        value           = vm.run(main, {});
+        calls           = vm.calls() - before;
+    });
+
+    report.begin("vm");
+    report.integer("fib", options.fib);
+    report.integer("result", static_cast<uint64_t>(value));
+    report.integer("instructions", code.code.size());
+    report.number("compile_seconds", compile);
+    report.number("run_seconds", run);
+    report.integer("calls", calls);
+    report.number("calls_per_s", calls / run);
+    report.end();
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    BenchOptions options;
+    if (!parse_args(argc, argv, options))
+        return -1;
+
+    std::string program = generate_program(options.program);
+
+    if (options.source_path) {
+        std::ofstream file(options.source_path, std::ios::binary);
+        file << program;
+        if (!file) {
+            std::cerr << "error writing " << options.source_path << std::endl;
+            return -1;
+        }
+    }
+
+    Source source("<generated>", program);
+    const double mb = source.size() / 1e6;
+
+    Report report;
+    report.begin("input");
+    report.integer("functions", options.program.functions);
+    report.integer("depth", options.program.depth);
+    report.integer("expr_size", options.program.expr_size);
+    report.integer("identifiers", options.program.identifiers);
+    report.integer("comments", options.program.comments);
+    report.integer("seed", options.program.seed);
+    report.integer("bytes", source.size());
+    report.integer("repeat", options.repeat);
+    report.end();
+
+    try {
+        Arena lexer_arena;
+        Arena parser_arena;
+
+        // Lexer alone.
+        size_t tokens = 0;
+        double lex    = best_of(options.repeat, [&] {
+            lexer_arena.reset();
+            Lexer lexer(source, lexer_arena);
+            tokens = 0;
+            while (lexer.next().type != TokenType::FileEnd)
+                tokens++;
+        });
+
+        report.begin("lex");
+        report.number("seconds", lex);
+        report.integer("tokens", tokens);
+        report.number("mb_per_s", mb / lex);
+        report.number("tokens_per_s", tokens / lex);
+
+        // What the first diagnostic costs: building the line table.
+        LineTable lines;
+        double line_table = best_of(options.repeat, [&] { lines.build(source.text()); });
+        report.number("line_table_seconds", line_table);
+        report.number("line_table_mb_per_s", mb / line_table);
+        report.end();
+
+        // Pointer AST, including lexing and interning.
+        size_t nodes        = 0;
+        size_t arena_bytes  = 0;
+        size_t annotations  = 0;
+        size_t unique_types = 0;
+        double parse = best_of(options.repeat, [&] {
+            lexer_arena.reset();
+            parser_arena.reset();
+            Interner interner;
+            TypeTable types;
+            Lexer lexer(source, lexer_arena);
+            Parser parser(lexer, parser_arena, interner, types);
+            auto fns = parser.parse();
+
+            Stats stats;
+            stats.count_nodes(fns);
+            nodes        = stats.node_count();
+            arena_bytes  = parser_arena.used() + lexer_arena.used() + types.bytes();
+            annotations  = stats.types;
+            unique_types = types.size();
+        });
+
+        report.begin("parse");
+        report.number("seconds", parse);
+        report.integer("nodes", nodes);
+        report.number("mb_per_s", mb / parse);
+        report.number("nodes_per_s", nodes / parse);
+        report.integer("arena_bytes", arena_bytes);
+        report.number("arena_bytes_per_source_byte", double(arena_bytes) / source.size());
+        report.integer("type_nodes", annotations);
+        report.integer("unique_types", unique_types);
+        report.end();
+
+        // Whole input lexed into a TokenArray first, then parsed by index.
+        size_t array_bytes = 0;
+        double pre_lex     = best_of(options.repeat, [&] {
+            TokenArray array(source);
+            array_bytes = array.bytes();
+        });
+
+        TokenArray array(source);
+        double indexed = best_of(options.repeat, [&] {
+            parser_arena.reset();
+            Interner interner;
+            TypeTable types;
+            Parser parser(array, parser_arena, interner, types);
+            auto fns = parser.parse();
+        });
+
+        report.begin("token_array");
+        report.number("lex_seconds", pre_lex);
+        report.number("lex_mb_per_s", mb / pre_lex);
+        report.number("parse_seconds", indexed);
+        report.number("nodes_per_s", nodes / indexed);
+        report.number("total_mb_per_s", mb / (pre_lex + indexed));
+        report.integer("bytes", array_bytes);
+        report.number("bytes_per_token", double(array_bytes) / array.size());
+        report.end();
+
+        // Lexer on its own thread feeding the parser through a ring.
+        double pipelined = best_of(options.repeat, [&] {
+            parser_arena.reset();
+            Interner interner;
+            TypeTable types;
+            PipelinedLexer stream(source);
+            Parser parser(stream, parser_arena, interner, types);
+            auto fns = parser.parse();
+        });
+
+        report.begin("pipeline");
+        report.number("seconds", pipelined);
+        report.number("mb_per_s", mb / pipelined);
+        report.number("nodes_per_s", nodes / pipelined);
+        report.end();
+
+        // Flat AST. Its tables live in vectors rather than the arena.
+        size_t flat_nodes = 0;
+        size_t flat_bytes = 0;
+        double flat = best_of(options.repeat, [&] {
+            lexer_arena.reset();
+            parser_arena.reset();
+            Interner interner;
+            TypeTable types;
+            Lexer lexer(source, lexer_arena);
+            Parser parser(lexer, parser_arena, interner, types);
+            FlatAst ast = parser.parse_flat();
+            flat_nodes  = ast.view().node_count;
+            flat_bytes  = ast.bytes() + parser_arena.used() + lexer_arena.used();
+        });
+
+        report.begin("parse_flat");
+        report.number("seconds", flat);
+        report.integer("nodes", flat_nodes);
+        report.number("mb_per_s", mb / flat);
+        report.number("nodes_per_s", flat_nodes / flat);
+        report.integer("bytes", flat_bytes);
+        report.number("bytes_per_source_byte", double(flat_bytes) / source.size());
+        report.end();
+
+        // Passes over an already parsed program.
+        lexer_arena.reset();
+        parser_arena.reset();
+        Interner interner;
+        TypeTable types;
+        Lexer lexer(source, lexer_arena);
+        Parser parser(lexer, parser_arena, interner, types);
+        auto fns = parser.parse();
+
+        Arena resolver_arena;
+        double resolve = best_of(options.repeat, [&] { Resolver(source, resolver_arena, interner).resolve(fns); });
+
+        report.begin("resolve");
+        report.number("seconds", resolve);
+        report.number("functions_per_s", fns.size() / resolve);
+        report.number("nodes_per_s", nodes / resolve);
+        report.integer("arena_bytes", resolver_arena.peak());
+        report.end();
+
+        // SSA lowering, then the standard pass pipeline on a fresh copy each
+        // time. The fastest run of each pass is reported on its own.
+        Arena ir_arena;
+        size_t lowered = 0;
+        double lower   = best_of(options.repeat, [&] {
+            ir_arena.reset();
+            IrModule module = lower_ir(fns, interner, ir_arena);
+            lowered         = 0;
+            for (const IrFunction& f : module.functions)
+                lowered += f.instruction_count();
+        });
+
+        std::vector<PassReport> passes;
+        for (uint32_t i = 0; i < options.repeat; i++) {
+            ir_arena.reset();
+            IrModule module                 = lower_ir(fns, interner, ir_arena);
+            std::vector<PassReport> reports = PassManager::standard().run(module);
+            if (passes.empty())
+                passes = reports;
+            for (size_t p = 0; p < passes.size(); p++)
+                passes[p].seconds = std::min(passes[p].seconds, reports[p].seconds);
+        }
+
+        report.begin("ir");
+        report.number("lower_seconds", lower);
+        report.integer("instructions", lowered);
+        report.number("instructions_per_s", lowered / lower);
+        uint64_t left = lowered;
+        for (size_t p = 0; p < passes.size(); p++) {
+            // Passes that run twice are told apart by their position.
+            std::string name = std::to_string(p + 1) + "_" + passes[p].name;
+            report.number(name + "_seconds", passes[p].seconds);
+            report.integer(name + "_removed", passes[p].removed);
+            left -= passes[p].removed;
+        }
+        report.integer("remaining", left);
+        report.end();
+
+        ir_arena.reset();
+        IrModule optimized = lower_ir(fns, interner, ir_arena);
+        (void)PassManager::standard().run(optimized);
+        bench_regalloc(options, optimized, report);
+        bench_scheduler(options, program, report);
+        bench_code_cache(options, program, report);
+        bench_incremental(options, program, report);
+
+        // Tree dump, kept in memory.
+
+        size_t emitted = 0;
+        double emit    = best_of(options.repeat, [&] {
+            Emitter out(interner);
+            out.program(fns);
+            emitted = out.take().size();
+        });
+
+        report.begin("emit");
+        report.number("seconds", emit);
+        report.integer("bytes", emitted);
+        report.number("mb_per_s", emitted / 1e6 / emit);
+        report.end();
+
+        bench_vm(options, report);
+    } catch (const CompileError& e) {
+        std::cerr << "generated program failed to parse:\n" << e.what() << std::endl;
+        return -1;
+    }
+
+    std::string text = report.finish();
+    if (!options.report_path) {
+        std::cout << text;
+        return 0;
+    }
+
+    std::ofstream file(options.report_path, std::ios::binary);
+    file << text;
+    if (!file) {
+        std::cerr << "error writing " << options.report_path << std::endl;
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,268 @@
+#include "generator.hpp"
+
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+// splitmix64: small, fast, and fully specified, unlike the distributions
+// in <random>.
+class Rng {
+  public:
+    explicit Rng(uint64_t seed) : state(seed) {}
+
+    uint64_t next() {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+        z          = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z          = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    uint32_t below(uint32_t n) { return n ? static_cast<uint32_t>(next() % n) : 0; }
+    bool percent(uint32_t p) { return below(100) < p; }
+
+  private:
+    uint64_t state;
+};
+
+constexpr std::string_view words[] = {
+    "value", "index", "count", "total", "buffer", "node", "left", "right",
+    "offset", "size", "item", "key", "result", "state", "acc", "x",
+};
+
+constexpr std::string_view types[] = {"u32", "i32", "f32", "u8", "bool", "string"};
+
+constexpr std::string_view generics[] = {"optional", "array", "map"};
+
+constexpr std::string_view binary_ops[] = {" + ", " - ", " * ", " / ", " < ", " > "};
+
+class Generator {
+  public:
+    explicit Generator(const GeneratorOptions& options) : options(options), rng(options.seed) {
+        uint32_t n = options.identifiers ? options.identifiers : 1;
+        for (uint32_t i = 0; i < n; i++) {
+            std::string name(words[i % std::size(words)]);
+            if (i >= std::size(words)) {
+                name += '_';
+                name += std::to_string(i / std::size(words));
+            }
+            names.push_back(std::move(name));
+        }
+    }
+
+    std::string run() {
+        for (uint32_t i = 0; i < options.functions; i++)
+            function(i);
+        return std::move(out);
+    }
+
+  private:
+    const GeneratorOptions& options;
+    Rng rng;
+    std::vector<std::string> names;
+    std::vector<uint32_t> visible; // names declared in the enclosing scopes
+    size_t scope_start = 0;        // where the innermost scope's names begin in `visible`
+    std::vector<uint32_t> arity;   // parameter count of each function so far
+    std::string out;
+    uint32_t current = 0; // index of the function being generated
+
+    void indent(uint32_t level) { out.append(level * 4, ' '); }
+
+    // Declares a fresh binding. It becomes usable once `visible` grows.
+    // Names are not repeated within a scope, which name resolution rejects;
+    // when every name is taken a new one is made up.
+    uint32_t declare() {
+        auto taken = [&](uint32_t n) {
+            return std::find(visible.begin() + scope_start, visible.end(), n) != visible.end();
+        };
+
+        auto n = static_cast<uint32_t>(rng.below(names.size()));
+        for (uint32_t tries = 0; taken(n) && tries < names.size(); tries++)
+            n = (n + 1) % names.size();
+        if (taken(n)) {
+            n = static_cast<uint32_t>(names.size());
+            names.push_back("v" + std::to_string(n));
+        }
+
+        out += names[n];
+        return n;
+    }
+
+    // Uses a name in scope, so the program passes name resolution. With
+    // nothing in scope a number stands in.
+    void use() {
+        if (visible.empty()) {
+            out += std::to_string(rng.below(1000));
+            return;
+        }
+        out += names[visible[rng.below(visible.size())]];
+    }
+
+    void type(uint32_t nesting = 0) {
+        if (nesting < 2 && rng.percent(25)) {
+            out += generics[rng.below(std::size(generics))];
+            out += '<';
+            type(nesting + 1);
+            out += '>';
+            return;
+        }
+        out += types[rng.below(std::size(types))];
+    }
+
+    void comment(uint32_t level) {
+        if (!rng.percent(options.comments))
+            return;
+
+        indent(level);
+        out += "# ";
+        for (uint32_t i = 0, n = 1 + rng.below(6); i < n; i++) {
+            out += words[rng.below(std::size(words))];
+            out += ' ';
+        }
+        out += '\n';
+    }
+
+    void operand() {
+        switch (rng.below(8)) {
+        case 0:
+        case 1:
+            out += std::to_string(rng.below(1000));
+            break;
+        case 2:
+            call();
+            break;
+        case 3:
+            out += '!';
+            use();
+            break;
+        default:
+            use();
+            break;
+        }
+    }
+
+    // Callees are earlier functions, so every call in the output resolves,
+    // and get as many arguments as they take.
+    void call() {
+        uint32_t callee = rng.below(current + 1);
+        out += 'f';
+        out += std::to_string(callee);
+        out += '(';
+        for (uint32_t i = 0, n = arity[callee]; i < n; i++) {
+            if (i)
+                out += ", ";
+            operand();
+        }
+        out += ')';
+    }
+
+    void expr(uint32_t size) {
+        if (size <= 1) {
+            operand();
+            return;
+        }
+
+        uint32_t left = 1 + rng.below(size - 1);
+        bool paren    = rng.percent(20);
+
+        if (paren)
+            out += '(';
+        expr(left);
+        out += binary_ops[rng.below(std::size(binary_ops))];
+        expr(size - left);
+        if (paren)
+            out += ')';
+    }
+
+    void statement(uint32_t level, uint32_t depth) {
+        comment(level);
+
+        uint32_t pick = rng.below(10);
+        if (pick < 3 && depth < options.depth) {
+            if_stmt(level, depth);
+            return;
+        }
+
+        indent(level);
+        if (pick < 7) {
+            out += "let ";
+            uint32_t n = declare();
+            out += ": ";
+            type();
+            out += " = ";
+            expr(1 + rng.below(options.expr_size));
+            visible.push_back(n);
+        }
+        else {
+            call();
+        }
+        out += ";\n";
+    }
+
+    void scope(uint32_t level, uint32_t depth) {
+        size_t outer       = visible.size();
+        size_t outer_start = scope_start;
+        scope_start        = outer;
+        out += "{\n";
+        for (uint32_t i = 0, n = 1 + rng.below(4); i < n; i++)
+            statement(level + 1, depth);
+
+        comment(level + 1);
+        indent(level + 1);
+        out += "return ";
+        expr(1 + rng.below(options.expr_size));
+        out += ";\n";
+
+        indent(level);
+        out += '}';
+        visible.resize(outer);
+        scope_start = outer_start;
+    }
+
+    void if_stmt(uint32_t level, uint32_t depth) {
+        indent(level);
+        out += "if ";
+        expr(1 + rng.below(options.expr_size));
+        out += ' ';
+        scope(level, depth + 1);
+
+        if (rng.percent(40)) {
+            out += " else ";
+            scope(level, depth + 1);
+        }
+        out += '\n';
+    }
+
+    void function(uint32_t i) {
+        current = i;
+        comment(0);
+
+        out += "function f";
+        out += std::to_string(i);
+        out += '(';
+        visible.clear();
+        scope_start = 0;
+        for (uint32_t p = 0, n = rng.below(4); p < n; p++) {
+            if (p)
+                out += ", ";
+            uint32_t name = declare();
+            out += ": ";
+            type();
+            visible.push_back(name);
+        }
+        arity.push_back(static_cast<uint32_t>(visible.size()));
+        out += ") => ";
+        type();
+        out += ' ';
+        scope(0, 0);
+        out += "\n\n";
+    }
+};
+
+} // namespace
+
+std::string generate_program(const GeneratorOptions& options) {
+    return Generator(options).run();
+}
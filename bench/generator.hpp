@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Shape of a synthetic program. The same options and seed always produce
+// the same text, on every platform.
+struct GeneratorOptions {
+    uint32_t functions   = 10000;
+    uint32_t depth       = 3;  // deepest nesting of if scopes
+    uint32_t expr_size   = 6;  // operands per generated expression
+    uint32_t identifiers = 64; // distinct local names to draw from
+    uint32_t comments    = 20; // percent of statements preceded by a comment
+    uint64_t seed        = 1;
+};
+
+std::string generate_program(const GeneratorOptions& options);
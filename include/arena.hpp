@@ -1,31 +1,46 @@
 #pragma once
 
+#include <algorithm>
 #include <cstddef>
+#include <cstdint>
 #include <cstring>
-#include <iostream>
+#include <memory>
+#include <new>
+#include <span>
 #include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
+// Bump allocator backed by a chain of geometrically growing blocks.
+// No memory is requested until the first allocation, and destructors of
+// objects placed in the arena are never run.
 class Arena {
   public:
-    explicit Arena(size_t capacity = 1024 * 1024) {
-        buffer = new char[capacity];
-        end = buffer + capacity;
-        ptr = buffer;
-    }
+    struct Mark {
+        void* block;
+        char* ptr;
+    };
 
-    ~Arena() {
-        delete[] buffer;
-    }
+    struct BlockStats {
+        size_t capacity;
+        size_t used;
+    };
+
+    explicit Arena(size_t initial_block = 64 * 1024, size_t max_block = 64 * 1024 * 1024)
+        : next_size(initial_block), max_size(std::max(initial_block, max_block)) {}
+
+    ~Arena() { release(); }
 
+    Arena(const Arena&)            = delete;
+    Arena& operator=(const Arena&) = delete;
 
     char* alloc_bytes(size_t size, size_t align = alignof(std::max_align_t)) {
         uintptr_t current = reinterpret_cast<uintptr_t>(ptr);
         uintptr_t aligned = (current + align - 1) & ~(align - 1);
 
-        if (aligned + size > reinterpret_cast<uintptr_t>(end)) {
-            std::cerr << "Arena out of memory" << std::endl;
-            std::exit(-1);
-        }
+        if (aligned + size > reinterpret_cast<uintptr_t>(end))
+            return grow(size, align);
 
         ptr = reinterpret_cast<char*>(aligned + size);
         return reinterpret_cast<char*>(aligned);
@@ -38,16 +53,176 @@ class Arena {
     }
 
     std::string_view copy(const char* begin, size_t len) {
-        char* mem = alloc_bytes(len);
+        char* mem = alloc_bytes(len, 1);
         std::memcpy(mem, begin, len);
         return std::string_view(mem, len);
     }
 
-    [[nodiscard]] size_t used() const { return ptr - buffer; }
+    template<typename T>
+    std::span<T> copy_span(const T* begin, size_t len) {
+        static_assert(std::is_trivially_destructible_v<T>);
+        T* mem = reinterpret_cast<T*>(alloc_bytes(sizeof(T) * len, alignof(T)));
+        std::uninitialized_copy_n(begin, len, mem);
+        return std::span<T>(mem, len);
+    }
+
+    // Everything allocated after `mark()` is discarded by `rollback()`.
+    // Blocks past the mark are kept and reused by later allocations.
+    [[nodiscard]] Mark mark() const { return {current, ptr}; }
+
+    void rollback(Mark m) {
+        note_peak();
+        if (!m.block) {
+            reset();
+            return;
+        }
+
+        for (Block* b = static_cast<Block*>(m.block)->next; b; b = b->next)
+            b->top = b->data();
+
+        current = static_cast<Block*>(m.block);
+        ptr     = m.ptr;
+        end     = current->data() + current->capacity;
+    }
+
+    // Drops every allocation. When the chain has grown past one block it is
+    // replaced by a single block of the same total capacity, so an arena
+    // reused across compilations settles into one allocation.
+    void reset() {
+        note_peak();
+        if (head && head->next) {
+            size_t total = capacity();
+            release();
+            next_size = std::min(std::max(next_size, total), max_size);
+            head      = new_block(total);
+        }
+
+        current = head;
+        if (head) {
+            head->top = head->data();
+            ptr       = head->data();
+            end       = head->data() + head->capacity;
+        }
+    }
+
+    // Returns all blocks to the system.
+    void release() {
+        Block* b = head;
+        while (b) {
+            Block* next = b->next;
+            ::operator delete(b);
+            b = next;
+        }
+
+        head = current = nullptr;
+        ptr = end = nullptr;
+    }
+
+    [[nodiscard]] size_t used() const {
+        size_t total = 0;
+        for (const Block* b = head; b; b = b->next) {
+            total += block_used(b);
+            if (b == current)
+                break;
+        }
+        return total;
+    }
+
+    // Largest used() seen so far. It is sampled only when memory is given
+    // back, so allocation itself pays nothing for it.
+    [[nodiscard]] size_t peak() const { return std::max(high_water, used()); }
+
     [[nodiscard]] size_t remaining() const { return end - ptr; }
 
+    [[nodiscard]] size_t capacity() const {
+        size_t total = 0;
+        for (const Block* b = head; b; b = b->next)
+            total += b->capacity;
+        return total;
+    }
+
+    [[nodiscard]] size_t block_count() const {
+        size_t n = 0;
+        for (const Block* b = head; b; b = b->next)
+            n++;
+        return n;
+    }
+
+    [[nodiscard]] std::vector<BlockStats> block_stats() const {
+        std::vector<BlockStats> stats;
+        for (const Block* b = head; b; b = b->next)
+            stats.push_back({b->capacity, block_used(b)});
+        return stats;
+    }
+
   private:
-    char* buffer;
-    char* ptr;
-    char* end;
+    struct alignas(std::max_align_t) Block {
+        Block* next;
+        char* top;
+        size_t capacity;
+
+        char* data() { return reinterpret_cast<char*>(this + 1); }
+        const char* data() const { return reinterpret_cast<const char*>(this + 1); }
+    };
+
+    static_assert(sizeof(Block) % alignof(std::max_align_t) == 0);
+
+    Block* head    = nullptr;
+    Block* current = nullptr;
+    char* ptr      = nullptr;
+    char* end      = nullptr;
+
+    size_t next_size;
+    size_t max_size;
+    size_t high_water = 0;
+
+    void note_peak() { high_water = std::max(high_water, used()); }
+
+    size_t block_used(const Block* b) const {
+        if (b == current)
+            return ptr - b->data();
+        return b->top - b->data();
+    }
+
+    static Block* new_block(size_t capacity) {
+        Block* b    = static_cast<Block*>(::operator new(sizeof(Block) + capacity));
+        b->next     = nullptr;
+        b->top      = b->data();
+        b->capacity = capacity;
+        return b;
+    }
+
+    char* enter(Block* b, size_t size, size_t align) {
+        if (current)
+            current->top = ptr;
+
+        current = b;
+        ptr     = b->data();
+        end     = b->data() + b->capacity;
+
+        uintptr_t aligned = (reinterpret_cast<uintptr_t>(ptr) + align - 1) & ~(align - 1);
+        ptr               = reinterpret_cast<char*>(aligned + size);
+        return reinterpret_cast<char*>(aligned);
+    }
+
+    // Slow path: move on to the next retained block if the request fits,
+    // otherwise link a fresh block in after the current one.
+    [[gnu::noinline]] char* grow(size_t size, size_t align) {
+        size_t needed = size + align;
+        Block* next   = current ? current->next : head;
+
+        if (next && next->capacity >= needed)
+            return enter(next, size, align);
+
+        Block* b  = new_block(std::max(next_size, needed));
+        next_size = std::min(next_size * 2, max_size);
+
+        b->next = next;
+        if (current)
+            current->next = b;
+        else
+            head = b;
+
+        return enter(b, size, align);
+    }
 };
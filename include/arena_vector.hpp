@@ -0,0 +1,87 @@
+#pragma once
+
+#include "arena.hpp"
+
+#include <cstddef>
+#include <cstring>
+#include <span>
+#include <type_traits>
+
+// Growable array whose storage lives in an Arena. Growing copies into a
+// larger allocation and leaves the old one to the arena, so it suits data
+// that is built up and then dropped with the arena as a whole, such as the
+// IR of one file. Elements are copied with memcpy and never destroyed.
+template<typename T>
+class ArenaVector {
+    static_assert(std::is_trivially_copyable_v<T> && std::is_trivially_destructible_v<T>);
+
+  public:
+    explicit ArenaVector(Arena& arena) : arena(&arena) {}
+
+    [[nodiscard]] size_t size() const noexcept { return count; }
+    [[nodiscard]] bool empty() const noexcept { return count == 0; }
+
+    T& operator[](size_t i) noexcept { return items[i]; }
+    const T& operator[](size_t i) const noexcept { return items[i]; }
+
+    T& back() noexcept { return items[count - 1]; }
+    const T& back() const noexcept { return items[count - 1]; }
+
+    T* begin() noexcept { return items; }
+    T* end() noexcept { return items + count; }
+    const T* begin() const noexcept { return items; }
+    const T* end() const noexcept { return items + count; }
+
+    operator std::span<T>() noexcept { return {items, count}; }
+    operator std::span<const T>() const noexcept { return {items, count}; }
+
+    void push_back(const T& item) {
+        if (count == capacity)
+            grow(capacity ? capacity * 2 : 8);
+        items[count++] = item;
+    }
+
+    void pop_back() noexcept { count--; }
+
+    // New elements are value-initialised.
+    void resize(size_t n) {
+        if (n > capacity)
+            grow(n);
+        for (size_t i = count; i < n; i++)
+            items[i] = T{};
+        count = n;
+    }
+
+    void clear() noexcept { count = 0; }
+
+    // Takes further growth from `to`. The current elements stay where they
+    // are, in whichever arena they were allocated from.
+    void rehome(Arena& to) noexcept { arena = &to; }
+
+    // Removes the elements matching `pred`, keeping the order of the rest.
+    template<typename Pred>
+    size_t erase_if(Pred pred) {
+        size_t kept = 0;
+        for (size_t i = 0; i < count; i++) {
+            if (!pred(items[i]))
+                items[kept++] = items[i];
+        }
+        size_t erased = count - kept;
+        count         = kept;
+        return erased;
+    }
+
+  private:
+    Arena* arena;
+    T* items        = nullptr;
+    size_t count    = 0;
+    size_t capacity = 0;
+
+    void grow(size_t n) {
+        T* bigger = reinterpret_cast<T*>(arena->alloc_bytes(sizeof(T) * n, alignof(T)));
+        if (count)
+            std::memcpy(static_cast<void*>(bigger), items, sizeof(T) * count);
+        items    = bigger;
+        capacity = n;
+    }
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "flat_ast.hpp"
+#include "interner.hpp"
+#include "source.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Binary copy of a FlatAst stored next to its source file.
+//
+// The file is a fixed header followed by the FlatAst tables and the string
+// table, each 8-byte aligned. Loading maps the file and points a FlatView
+// straight at the tables; only the strings are copied, into the Interner,
+// so symbols in the cached tree keep their ids.
+//
+// Opening checks a hash of everything after the header, then every table:
+// node kinds and operators, that each child index names an earlier node of
+// the right sort, and that every list, symbol and string lies inside its
+// table. A file that fails any check is not ok(), which callers treat as a
+// miss, so a damaged cache is rebuilt rather than crashing the compiler.
+class AstCache {
+  public:
+    static constexpr uint32_t version = 2;
+
+    static std::string path_for(const char* source_path);
+
+    // Writes to a temporary file of its own and renames it into place, so
+    // readers never see a partial cache, even with other threads or
+    // processes writing the same one.
+    static bool write(const char* cache_path, const Source& source, const FlatView& ast, const Interner& names);
+
+    explicit AstCache(const char* cache_path);
+    ~AstCache();
+
+    AstCache(const AstCache&)            = delete;
+    AstCache& operator=(const AstCache&) = delete;
+
+    [[nodiscard]] bool ok() const noexcept { return header != nullptr; }
+
+    // True when the cache was built from the current contents of the file.
+    // Size and mtime are checked first; if only the mtime moved the source
+    // is hashed and compared.
+    [[nodiscard]] bool fresh_for(const char* source_path) const;
+
+    // `names` must be empty so that the cached symbols line up with it.
+    FlatView load(Interner& names) const;
+
+    struct Header;
+
+  private:
+    const char* data     = nullptr;
+    size_t length        = 0;
+    const Header* header = nullptr;
+
+    bool validate() const;
+    FlatView view() const;
+};
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "interner.hpp"
+#include "parser.hpp"
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Register bytecode for the interpreter. Every value is a 64-bit integer;
+// `null` is 0, comparisons and `!` produce 0 or 1, and type annotations are
+// not enforced.
+enum class Op : uint8_t {
+    LoadInt,     // a = int32 in bc
+    LoadConst,   // a = constants[bc]
+    Move,        // a = b
+    Add,         // a = b + c, wrapping
+    Sub,         // a = b - c
+    Mul,         // a = b * c
+    Div,         // a = b / c, error if c is 0
+    Less,        // a = b < c
+    Greater,     // a = b > c
+    Not,         // a = !b
+    Neg,         // a = -b
+    Jump,        // pc = bc
+    JumpIfFalse, // if a == 0, pc = bc
+    Call,        // a = functions[bc](a, a + 1, ...)
+    Return,      // return a
+};
+
+inline constexpr size_t op_count = static_cast<size_t>(Op::Return) + 1;
+
+// Eight bytes. Registers are numbered from the base of the current frame;
+// `bc` joins b and c into one 32-bit operand for jump targets, constant
+// indices and function ids.
+struct Instr {
+    Op op;
+    uint8_t unused = 0;
+    uint16_t a     = 0;
+    uint16_t b     = 0;
+    uint16_t c     = 0;
+
+    [[nodiscard]] uint32_t bc() const noexcept { return b | uint32_t(c) << 16; }
+};
+
+static_assert(sizeof(Instr) == 8);
+
+struct BytecodeFunction {
+    Symbol name;
+    uint32_t entry;     // index of the first instruction in Bytecode::code
+    uint16_t params;    // passed in registers 0..params-1
+    uint16_t registers; // frame size, params included
+};
+
+// A whole program in flat arrays, with functions in source order.
+struct Bytecode {
+    std::vector<Instr> code;
+    std::vector<int64_t> constants;
+    std::vector<BytecodeFunction> functions;
+
+    // Index of the function called `name`, or -1.
+    [[nodiscard]] int64_t find(Symbol name) const noexcept;
+};
+
+// Compiles resolved functions; run the Resolver first. Throws CompileError
+// for calls to something that is not a function, calls with the wrong number
+// of arguments, and integer literals that do not fit in 64 bits.
+Bytecode compile_bytecode(std::span<FunctionDecl* const> fns, const Interner& interner);
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <compare>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// 128 bits, so that two different inputs sharing a key is not a concern
+// even for a cache shared by many builds.
+struct CacheKey {
+    uint64_t hi = 0;
+    uint64_t lo = 0;
+
+    static CacheKey of(std::string_view bytes);
+
+    // 32 hex digits.
+    [[nodiscard]] std::string hex() const;
+
+    auto operator<=>(const CacheKey&) const = default;
+};
+
+// Directory of compiled outputs shared by every build that points at it,
+// one file per key:
+//
+//     <dir>/<first hex digit of the key>/<key in hex>
+//
+// Each entry repeats its key and carries a checksum of its value, so a
+// truncated or foreign file reads as a miss. Entries are written to a
+// temporary file and renamed into place, so concurrent builds never see a
+// partial entry; two builds storing the same key both write the same value
+// and the later rename wins.
+//
+// A hit touches the entry's mtime, which makes eviction least recently
+// used. Each of the 16 shard directories keeps a running byte count in a
+// `size` file, updated under flock() when the cache is destroyed. A shard
+// that has outgrown its part of `limit` is scanned and its oldest entries
+// deleted until it is back under 80%, which recounts it exactly. Temporary
+// files less than an hour old belong to builds still writing them and are
+// neither counted nor deleted.
+class CodeCache {
+  public:
+    static constexpr uint32_t version = 1;
+    static constexpr size_t shards    = 16;
+
+    CodeCache(std::string dir, uint64_t limit);
+    ~CodeCache();
+
+    CodeCache(const CodeCache&)            = delete;
+    CodeCache& operator=(const CodeCache&) = delete;
+
+    // Both are safe to call from several threads at once.
+    std::optional<std::string> load(const CacheKey& key);
+    bool store(const CacheKey& key, std::string_view value);
+
+    [[nodiscard]] uint64_t hits() const { return hit_count.load(std::memory_order_relaxed); }
+    [[nodiscard]] uint64_t misses() const { return miss_count.load(std::memory_order_relaxed); }
+
+  private:
+    std::string dir;
+    uint64_t limit;
+
+    std::atomic<uint64_t> hit_count{0};
+    std::atomic<uint64_t> miss_count{0};
+    std::atomic<uint32_t> temp_count{0};
+    std::array<std::atomic<uint64_t>, shards> added{}; // bytes stored into each shard by this process
+
+    std::string shard_dir(size_t shard) const;
+    std::string entry_path(const CacheKey& key) const;
+
+    // Adds `bytes` to the shard's count and evicts if it is over its limit.
+    void account(size_t shard, uint64_t bytes);
+};
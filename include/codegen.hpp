@@ -0,0 +1,59 @@
+#pragma once
+
+#include "arena.hpp"
+#include "code_cache.hpp"
+#include "emitter.hpp"
+#include "interner.hpp"
+#include "parser.hpp"
+#include "stats.hpp"
+#include "task_scheduler.hpp"
+#include "trace.hpp"
+
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+struct CodegenOptions {
+    EmitFormat format = EmitFormat::Asm; // Ir or Asm
+    bool optimize     = true;            // run the standard passes
+
+    // Where to look up and store the output of each function. A function's
+    // key covers its source text, the name and parameter count of every
+    // function it refers to, and the options above, which is everything its
+    // output depends on. `source` is the text the functions' spans index.
+    CodeCache* cache = nullptr;
+    std::string_view source;
+
+    // The file `source` came from. With a cache, the file's manifest is
+    // stored under it: a hash of the text, the whole output, and the key
+    // and output of every function. Empty for none.
+    std::string_view path;
+};
+
+// The output of the last generate_code() for `options.path`, if it was for
+// the same text and options. One cache read and a hash of the text, so an
+// unchanged file skips lexing, parsing and resolving altogether.
+std::optional<std::string> cached_output(const CodegenOptions& options);
+
+// Lowers resolved functions to IR, runs the standard passes and writes the
+// IR or x86 assembly, as `options` say.
+//
+// Every function is lowered, optimized and written as three tasks on
+// `scheduler`, each spawning the next; with a cache, a first task looks
+// the function up, in the file's manifest and then in the cache, and ends
+// there on a hit. A changed file thus still pays for its front end but
+// reads one entry for all of its unchanged functions.
+//
+// Functions are queued largest first, by source size, so long ones start
+// early and short ones fill in at the end. Each worker allocates IR from
+// its own arena, including when it optimizes a function that another
+// worker lowered; `arena`, which also holds the module, is worker 0's.
+// Output is joined in source order and does not depend on the number of
+// workers or on what was cached.
+//
+// Throws the CompileError of the first function in source order that
+// failed, as lowering them one after another would.
+void generate_code(std::span<FunctionDecl* const> fns, const Interner& interner, const CodegenOptions& options,
+                   TaskScheduler& scheduler, Arena& arena, Emitter& out, Stats* stats = nullptr,
+                   Trace* trace = nullptr);
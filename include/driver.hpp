@@ -0,0 +1,80 @@
+#pragma once
+
+#include "arena.hpp"
+#include "emitter.hpp"
+#include "stats.hpp"
+#include "trace.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct DriverOptions {
+    bool flat     = false;
+    bool cache    = false;
+    unsigned jobs = 0; // 0 picks one worker per core
+
+    EmitFormat format = EmitFormat::Tree;
+
+    // Lex each file into a TokenArray before parsing instead of lexing on
+    // demand. Large files are then parsed on one thread.
+    bool token_array = false;
+
+    // Lex on a second thread while parsing, handing tokens over in batches.
+    // Like token_array, this replaces chunked parsing of large files.
+    bool pipeline = false;
+
+    // Bind identifiers to their declarations after parsing, reporting
+    // undefined names. Needs the pointer AST, so not usable with `flat`.
+    bool resolve = false;
+
+    // Compile to bytecode and print what `main` returns instead of the
+    // tree. Needs resolve. `main`'s parameters are all passed as 0.
+    bool run = false;
+
+    // Run the standard pass pipeline on the IR before printing it
+    // (EmitFormat::Ir) or generating assembly from it (EmitFormat::Asm).
+    // Both formats need resolve.
+    bool optimize = true;
+
+    // Directory of a CodeCache shared between runs and concurrent builds,
+    // from which EmitFormat::Ir and Asm reuse the output of functions that
+    // have not changed. Null for none.
+    const char* code_cache    = nullptr;
+    uint64_t code_cache_limit = uint64_t(512) << 20; // bytes, before eviction
+
+    bool stats             = false;   // print phase times and counters to stderr
+    const char* trace_path = nullptr; // write a Chrome trace here
+
+    // Threads used inside a single file. The driver sets this when there is
+    // only one input, so a large file is parsed in parallel chunks and its
+    // functions are compiled to IR or assembly on a TaskScheduler.
+    unsigned file_jobs = 1;
+};
+
+// Everything one input produced, held until it is that input's turn to be
+// written out.
+struct CompileResult {
+    std::string output; // empty when the output went straight to a descriptor
+    std::string diagnostics;
+    bool ok = true;
+    Stats stats; // filled in only with DriverOptions::stats
+};
+
+// Memory owned by one worker thread and reset between the files it compiles.
+struct Worker {
+    Arena lexer_arena;
+    Arena parser_arena;
+    Arena resolver_arena;
+    Arena ir_arena;
+};
+
+// With `out_fd` set, output is streamed to that descriptor instead of being
+// collected in the result. Phases and functions are recorded into `trace`
+// when it is not null.
+CompileResult compile_file(const char* path, const DriverOptions& options, Worker& worker, int out_fd = -1,
+                           Trace* trace = nullptr);
+
+// Compiles every input on a pool of workers and writes outputs and
+// diagnostics in input order. Returns the process exit status.
+int run_driver(const std::vector<const char*>& inputs, const DriverOptions& options);
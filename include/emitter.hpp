@@ -0,0 +1,64 @@
+#pragma once
+
+#include "flat_ast.hpp"
+#include "interner.hpp"
+#include "parser.hpp"
+
+#include <cstddef>
+#include <span>
+#include <string>
+#include <string_view>
+
+enum class EmitFormat {
+    Tree,  // indented dump, the historical output of main
+    Json,  // one compact JSON array of functions per program
+    Sexpr, // one S-expression per function
+    Asm,   // x86-64 assembly from the IR, see write_x86(); written by the driver
+    Ir,    // optimized SSA IR, see write_ir(); written by the driver
+};
+
+// Writes all of `data` to `fd`, retrying short writes. Returns false on error.
+bool write_all(int fd, std::string_view data);
+
+// Writes programs into a large reusable buffer.
+//
+// With a file descriptor the buffer is written out whenever it fills and on
+// flush() or destruction, so output costs one write per block rather than
+// one per line. Without one (`fd == -1`) everything stays in memory until
+// take().
+class Emitter {
+  public:
+    static constexpr size_t block_size = 1 << 20;
+
+    Emitter(const Interner& names, EmitFormat format = EmitFormat::Tree, int fd = -1);
+    ~Emitter();
+
+    Emitter(const Emitter&)            = delete;
+    Emitter& operator=(const Emitter&) = delete;
+
+    void program(std::span<FunctionDecl* const> fns);
+    void program(const FlatView& ast);
+
+    // Returns false if this or any earlier write to `fd` failed. Once one
+    // has, nothing more is written.
+    bool flush();
+    [[nodiscard]] std::string take();
+
+    void put(std::string_view s) {
+        buffer.append(s);
+        if (fd >= 0 && buffer.size() >= block_size)
+            flush();
+    }
+
+    void put(char c) { buffer.push_back(c); }
+
+    void put_indent(int n);
+    void put_symbol(Symbol s) { put(names.view(s)); }
+
+  private:
+    const Interner& names;
+    EmitFormat format;
+    int fd;
+    bool write_failed = false;
+    std::string buffer;
+};
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <stdexcept>
+
+// Raised for problems in the program being compiled. The driver catches it
+// per input file, reports `what()` and moves on.
+struct CompileError : std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
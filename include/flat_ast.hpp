@@ -0,0 +1,140 @@
+#pragma once
+
+#include "interner.hpp"
+#include "lexer.hpp"
+
+#include <cstdint>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+// Index-based AST stored as parallel tables. Nodes have no vtable and no
+// pointers: children are 32-bit indices into the same tables, so a tree can
+// be copied, moved or written to disk as a handful of flat arrays.
+
+using NodeIndex = uint32_t;
+
+inline constexpr NodeIndex NoNode = UINT32_MAX;
+
+enum class NodeKind : uint8_t {
+    Identifier,
+    Literal,
+    Binary,
+    Unary,
+    Paren,
+    Call,
+
+    Let,
+    Return,
+    Expr,
+    Scope,
+    If,
+
+    Type,
+};
+
+// Operand layout per kind. `list` operands index `extra`, where a list is
+// stored as its length followed by its items.
+//
+//   Identifier  lhs = name symbol
+//   Literal     lhs = value symbol
+//   Binary      op, lhs = left, rhs = right
+//   Unary       op, lhs = operand
+//   Paren       lhs = inner expression
+//   Call        lhs = callee, rhs = list of arguments
+//   Let         lhs = name symbol, rhs = extra[rhs] type, extra[rhs + 1] value
+//   Return      lhs = value
+//   Expr        lhs = expression
+//   Scope       rhs = list of statements
+//   If          lhs = condition, rhs = extra[rhs] then, extra[rhs + 1] else or NoNode
+//   Type        lhs = name symbol, rhs = list of type arguments
+
+struct FlatFunction {
+    Symbol name;
+    uint32_t params; // list of (name symbol, type node) pairs
+    NodeIndex return_type;
+    NodeIndex body;
+};
+
+// Non-owning view over the tables of a FlatAst, or over the same tables
+// mapped from disk.
+struct FlatView {
+    const NodeKind* kinds;
+    const uint8_t* ops;
+    const uint32_t* lhs;
+    const uint32_t* rhs;
+    const uint32_t* extra;
+    const FlatFunction* functions;
+
+    uint32_t node_count;
+    uint32_t extra_count;
+    uint32_t function_count;
+
+    [[nodiscard]] NodeKind kind(NodeIndex n) const noexcept { return kinds[n]; }
+    [[nodiscard]] TokenType op(NodeIndex n) const noexcept { return static_cast<TokenType>(ops[n]); }
+
+    [[nodiscard]] std::span<const uint32_t> list(uint32_t at) const noexcept { return {extra + at + 1, extra[at]}; }
+
+    [[nodiscard]] std::span<const FlatFunction> funcs() const noexcept { return {functions, function_count}; }
+};
+
+static_assert(std::is_trivially_copyable_v<FlatFunction>);
+static_assert(std::is_trivially_copyable_v<FlatView>);
+
+class FlatAst {
+  public:
+    // extra[0] is a shared empty list, so childless nodes cost no extra words.
+    FlatAst() { extra.push_back(0); }
+
+    NodeIndex add(NodeKind kind, uint32_t a, uint32_t b = 0, TokenType op = TokenType::Unknown) {
+        kinds.push_back(kind);
+        ops.push_back(static_cast<uint8_t>(op));
+        lhs.push_back(a);
+        rhs.push_back(b);
+        return static_cast<NodeIndex>(kinds.size() - 1);
+    }
+
+    uint32_t add_extra(std::span<const uint32_t> items) {
+        uint32_t at = static_cast<uint32_t>(extra.size());
+        extra.insert(extra.end(), items.begin(), items.end());
+        return at;
+    }
+
+    uint32_t add_list(std::span<const uint32_t> items) {
+        if (items.empty())
+            return 0;
+
+        uint32_t at = static_cast<uint32_t>(extra.size());
+        extra.push_back(static_cast<uint32_t>(items.size()));
+        extra.insert(extra.end(), items.begin(), items.end());
+        return at;
+    }
+
+    void add_function(const FlatFunction& fn) { functions.push_back(fn); }
+
+    [[nodiscard]] FlatView view() const noexcept {
+        return FlatView{kinds.data(),
+                        ops.data(),
+                        lhs.data(),
+                        rhs.data(),
+                        extra.data(),
+                        functions.data(),
+                        static_cast<uint32_t>(kinds.size()),
+                        static_cast<uint32_t>(extra.size()),
+                        static_cast<uint32_t>(functions.size())};
+    }
+
+    [[nodiscard]] size_t bytes() const noexcept {
+        return kinds.size() * (sizeof(NodeKind) + sizeof(uint8_t) + 2 * sizeof(uint32_t)) +
+               extra.size() * sizeof(uint32_t) + functions.size() * sizeof(FlatFunction);
+    }
+
+  private:
+    std::vector<NodeKind> kinds;
+    std::vector<uint8_t> ops;
+    std::vector<uint32_t> lhs;
+    std::vector<uint32_t> rhs;
+    std::vector<uint32_t> extra;
+    std::vector<FlatFunction> functions;
+};
+
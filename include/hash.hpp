@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Fast non-cryptographic 64-bit hash for cache keys and change detection.
+inline uint64_t hash_mix(uint64_t h) noexcept {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+inline uint64_t hash_bytes(const void* data, size_t len, uint64_t seed = 0) noexcept {
+    const char* p = static_cast<const char*>(data);
+    uint64_t h    = seed ^ (len * 0x9e3779b97f4a7c15ull);
+
+    for (; len >= 8; p += 8, len -= 8) {
+        uint64_t word;
+        std::memcpy(&word, p, 8);
+        h = (h ^ hash_mix(word)) * 0x9e3779b97f4a7c15ull;
+    }
+
+    uint64_t tail = 0;
+    std::memcpy(&tail, p, len);
+    return hash_mix(h ^ tail ^ (len << 56));
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "arena.hpp"
+#include "interner.hpp"
+#include "parser.hpp"
+#include "source.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Old bytes [begin, end) were replaced by `length` new bytes.
+struct TextEdit {
+    uint32_t begin;
+    uint32_t end;
+    uint32_t length;
+};
+
+// Keeps the functions of the previous parse and, after an edit, reparses
+// only the functions whose span an edit touches, plus any text between
+// functions that was edited. Untouched FunctionDecls keep their nodes and
+// only have their spans shifted.
+//
+// Replaced nodes stay in the arena, so once a reparse leaves the arena at
+// more than twice the size a full parse of the file needed, the file is
+// parsed again from scratch. That keeps memory within a constant factor of
+// the file and costs one full parse per file's worth of edited functions.
+class IncrementalParser {
+  public:
+    explicit IncrementalParser(Interner& interner) : interner(interner) {}
+
+    const std::vector<FunctionDecl*>& parse(const Source& source);
+
+    // `source` is the edited text. `edits` are in old-text offsets, sorted
+    // and non-overlapping. Throws CompileError if the edited text does not
+    // parse, leaving the previous result in place.
+    const std::vector<FunctionDecl*>& reparse(const Source& source, std::span<const TextEdit> edits);
+
+    [[nodiscard]] const std::vector<FunctionDecl*>& functions() const noexcept { return fns; }
+
+    // Number of functions rebuilt by the last call.
+    [[nodiscard]] size_t reparsed() const noexcept { return rebuilt; }
+
+  private:
+    Interner& interner;
+    TypeTable types; // outlives reparses, as old functions still point into it
+    Arena arena;
+    Arena lexer_arena;
+
+    std::vector<FunctionDecl*> fns;
+    size_t source_size = 0;
+    size_t rebuilt     = 0;
+    size_t full_bytes  = 0; // arena.used() after the last full parse
+
+    std::vector<FunctionDecl*> parse_range(const Source& source, size_t begin, size_t end);
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "arena.hpp"
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Dense id of an interned string. Ids are handed out in order of first
+// appearance, starting from 0.
+using Symbol = uint32_t;
+
+inline constexpr Symbol NoSymbol = UINT32_MAX;
+
+// Maps each distinct string to a Symbol. The interner keeps its own copy of
+// every string, so callers may release the text they interned from.
+class Interner {
+  public:
+    Interner();
+
+    Interner(const Interner&)            = delete;
+    Interner& operator=(const Interner&) = delete;
+
+    Symbol intern(std::string_view s);
+
+    [[nodiscard]] std::string_view view(Symbol s) const noexcept { return strings[s]; }
+    [[nodiscard]] size_t size() const noexcept { return strings.size(); }
+
+  private:
+    struct Slot {
+        uint32_t hash;
+        Symbol symbol;
+    };
+
+    Arena storage;
+    std::vector<Slot> slots;
+    std::vector<std::string_view> strings;
+    uint32_t mask;
+
+    static uint32_t hash(std::string_view s) noexcept;
+    void grow();
+};
@@ -0,0 +1,176 @@
+#pragma once
+
+#include "arena.hpp"
+#include "arena_vector.hpp"
+#include "emitter.hpp"
+#include "interner.hpp"
+#include "parser.hpp"
+
+#include <cstdint>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+// SSA intermediate representation. Every instruction defines at most one
+// value, named by the instruction's index; instructions are grouped into
+// basic blocks that each end in exactly one terminator. All arrays live in
+// an Arena, so a whole module is dropped at once.
+//
+// Values mean what they mean in the bytecode VM: I64 is a wrapping 64-bit
+// integer and I1 the result of a comparison or `!`. `let` bindings are
+// immutable, so lowering needs no variable renaming; the only phis it
+// creates merge the values returned along different paths into the single
+// exit block.
+
+using ValueId = uint32_t;
+using BlockId = uint32_t;
+
+inline constexpr uint32_t NoId = UINT32_MAX;
+
+enum class IrType : uint8_t {
+    Void, // terminators
+    I1,
+    I64,
+};
+
+enum class IrOp : uint8_t {
+    Nop,    // removed by a pass; ids of other instructions stay stable
+    Const,  // imm
+    Param,  // parameter number a
+    Add,    // a + b
+    Sub,    // a - b
+    Mul,    // a * b
+    Div,    // a / b, traps if b is 0
+    Lt,     // a < b
+    Gt,     // a > b
+    Eqz,    // a == 0
+    Nez,    // a != 0
+    ZExt,   // I1 a as I64
+    Neg,    // -a
+    Call,   // function a with `count` arguments at operands[args]
+    Phi,    // `count` (block, value) pairs at operands[args]
+    Jump,   // to block a
+    Branch, // to block b if a, else to block c
+    Ret,    // return a
+};
+
+struct IrInst {
+    IrOp op        = IrOp::Nop;
+    IrType type    = IrType::Void;
+    uint32_t count = 0;
+    uint32_t a     = 0;
+    uint32_t b     = 0;
+    uint32_t c     = 0;
+    uint32_t args  = 0;
+    int64_t imm    = 0;
+};
+static_assert(sizeof(IrInst) == 32);
+
+struct IrBlock {
+    ArenaVector<ValueId> insts; // phis first, terminator last
+    ArenaVector<BlockId> preds; // see IrFunction::compute_preds()
+    bool live = true;           // false once a pass has removed the block
+};
+
+struct IrFunction {
+    Symbol name;
+    uint32_t params;
+    ArenaVector<IrInst> insts;
+    ArenaVector<uint32_t> operands; // for Call and Phi
+    ArenaVector<IrBlock> blocks;    // block 0 is the entry
+
+    explicit IrFunction(Arena& arena) : insts(arena), operands(arena), blocks(arena) {}
+
+    [[nodiscard]] const IrInst& terminator(BlockId b) const { return insts[blocks[b].insts.back()]; }
+
+    // Up to two successors of `b`, NoId where there are fewer.
+    void successors(BlockId b, BlockId (&out)[2]) const;
+
+    // Refills every live block's `preds` from the terminators.
+    void compute_preds();
+
+    // Live blocks in reverse postorder from the entry. Unreachable blocks
+    // are left out.
+    [[nodiscard]] std::vector<BlockId> reverse_postorder() const;
+
+    // Instructions in live blocks.
+    [[nodiscard]] size_t instruction_count() const;
+
+    // Makes every vector of the function grow from `arena` from now on, so
+    // that a thread which owns `arena` can run passes over a function that
+    // another thread lowered.
+    void rehome(Arena& arena);
+};
+
+struct IrModule {
+    explicit IrModule(Arena& arena) : functions(arena) {}
+
+    ArenaVector<IrFunction> functions; // in source order; Call's `a` indexes these
+};
+
+// Calls `fn` on each value operand of `inst`, by reference, so passes can
+// rewrite them in place. Also takes a const function and instruction.
+template<typename Function, typename Inst, typename F>
+void for_each_operand(Function& f, Inst& inst, F&& fn) {
+    switch (inst.op) {
+    case IrOp::Add:
+    case IrOp::Sub:
+    case IrOp::Mul:
+    case IrOp::Div:
+    case IrOp::Lt:
+    case IrOp::Gt:
+        fn(inst.a);
+        fn(inst.b);
+        break;
+    case IrOp::Eqz:
+    case IrOp::Nez:
+    case IrOp::ZExt:
+    case IrOp::Neg:
+    case IrOp::Branch:
+    case IrOp::Ret:
+        fn(inst.a);
+        break;
+    case IrOp::Call:
+        for (uint32_t i = 0; i < inst.count; i++)
+            fn(f.operands[inst.args + i]);
+        break;
+    case IrOp::Phi:
+        for (uint32_t i = 0; i < inst.count; i++)
+            fn(f.operands[inst.args + 2 * i + 1]);
+        break;
+    default:
+        break;
+    }
+}
+
+// Lowers the functions of one resolved program one at a time, in any order.
+// Lowering a function writes only that function's arrays and reads only the
+// names and parameter counts of the others, so several functions can be
+// lowered at once on different threads, each with its own arena.
+class IrLowering {
+  public:
+    IrLowering(std::span<FunctionDecl* const> fns, const Interner& interner);
+
+    // Every function's name and parameter count, with empty bodies.
+    [[nodiscard]] IrModule declare(Arena& arena) const;
+
+    // Fills in the body of function `index`, allocating from `arena`. Throws
+    // CompileError for the same programs compile_bytecode() rejects.
+    void lower(IrModule& module, uint32_t index, Arena& arena) const;
+
+  private:
+    std::span<FunctionDecl* const> fns;
+    const Interner& interner;
+    std::unordered_map<const FunctionDecl*, uint32_t> ids;
+};
+
+// Lowers resolved functions into `arena`, in order.
+IrModule lower_ir(std::span<FunctionDecl* const> fns, const Interner& interner, Arena& arena);
+
+// Prints the module as text, one block label per line and one instruction
+// per indented line, e.g. `%4: i64 = add %2, %3`.
+void write_ir(const IrModule& module, const Interner& interner, Emitter& out);
+
+// Prints function `index` the way write_ir() does. Reads only the names of
+// the other functions.
+void write_ir_function(const IrModule& module, const Interner& interner, uint32_t index, Emitter& out);
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "ir.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// A pass rewrites one function in place and returns how many rewrites it
+// made. Removed instructions become Nop and leave their block.
+using IrPass = uint32_t (*)(IrFunction& f);
+
+// Evaluates instructions whose operands are constants, simplifies the
+// identities x+0, x-0, x*1, x*0 and x/1, and forwards phis whose incoming
+// values agree. Division by a constant 0 is left to fail at run time.
+uint32_t fold_constants(IrFunction& f);
+
+// Turns branches on constants into jumps, deletes unreachable blocks,
+// merges a block into its only predecessor, bypasses blocks that only jump
+// on, and forwards phis left with a single incoming value. Repeats until
+// nothing changes.
+uint32_t simplify_cfg(IrFunction& f);
+
+// Replaces an instruction with an identical one that dominates it. Calls
+// are included: functions cannot have side effects, so a call that already
+// returned would return the same value again.
+uint32_t eliminate_common_subexpressions(IrFunction& f);
+
+// Deletes instructions whose values are never used. Calls are kept, as they
+// may fail or not return, and so is division unless the divisor is a
+// nonzero constant.
+uint32_t eliminate_dead_code(IrFunction& f);
+
+struct PassReport {
+    const char* name;
+    uint64_t changes = 0; // as counted by the pass
+    uint64_t removed = 0; // drop in instruction count across the pass
+    double seconds   = 0;
+};
+
+// Runs a fixed sequence of passes over every function of a module.
+class PassManager {
+  public:
+    void add(const char* name, IrPass pass) { passes.push_back({name, pass}); }
+
+    // fold, simplify-cfg, cse, dce, then simplify-cfg and dce again for
+    // the conditions of branches that simplify-cfg turned into jumps.
+    static PassManager standard();
+
+    // One report per added pass, in order, totalled over all functions.
+    std::vector<PassReport> run(IrModule& module) const;
+
+    // Runs every pass over one function, adding to `reports`, which gets one
+    // report per pass if it is empty. Functions can be optimized on separate
+    // threads this way, each thread with its own reports.
+    void run(IrFunction& f, std::vector<PassReport>& reports) const;
+
+  private:
+    struct Entry {
+        const char* name;
+        IrPass pass;
+    };
+
+    std::vector<Entry> passes;
+};
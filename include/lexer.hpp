@@ -1,6 +1,10 @@
 #pragma once
 
 #include "arena.hpp"
+#include "scan.hpp"
+#include "source.hpp"
+
+#include <cstdint>
 #include <iostream>
 
 enum class TokenType : int {
@@ -55,45 +59,66 @@ inline const char* type_to_string(TokenType t) {
 
 struct Token {
   public:
-    explicit Token(TokenType _type, std::string_view val, const int line) noexcept : type(_type), value(val), line(line) {}
+    explicit Token(TokenType _type, std::string_view val, uint32_t offset) noexcept
+        : type(_type), value(val), offset(offset) {}
 
     [[nodiscard]] bool is(TokenType t) const noexcept { return type == t; }
     [[nodiscard]] bool is_not(TokenType t) const noexcept { return type != t; }
 
     void set_value(std::string_view val) noexcept { value = std::move(val); }
 
-    void print() const noexcept { std::cout << line << "| " << type_to_string(type) << ": " << value << std::endl; }
+    void print() const noexcept { std::cout << offset << "| " << type_to_string(type) << ": " << value << std::endl; }
 
     TokenType type;
     std::string_view value;
-    int line;
+    uint32_t offset; // of the first byte in the source; see Source::locate()
 };
 
-class Lexer {
-  public:
-    Lexer(const char* file_path, Arena& arena) : arena(arena) {
-        position = open_file(file_path);
-        start    = position;
+// How token values are stored. `View` points straight into the Source,
+// which must then outlive every token and AST node. `Copy` duplicates each
+// value into the lexer arena so the Source can be released early.
+enum class TokenValues {
+    View,
+    Copy,
+};
 
-        if (!position) {
-            std::cerr << "error reading file " << file_path << std::endl;
-            std::exit(-1);
-        }
-    }
+// Whether `#` comments are returned as Comment tokens or skipped along
+// with whitespace.
+enum class Comments {
+    Skip,
+    Keep,
+};
 
-    ~Lexer() { delete[] start; }
+class Lexer {
+  public:
+    Lexer(const Source& source, Arena& arena, TokenValues values = TokenValues::View,
+          Comments comments = Comments::Skip)
+        : Lexer(source, 0, source.size(), arena, values, comments) {}
+
+    // Lexes bytes [begin, end) of `source`. Token offsets still count from
+    // the start of `source`. Scanners may still read past `end` into the
+    // rest of the buffer, but no token is produced from there.
+    Lexer(const Source& source, size_t begin, size_t end, Arena& arena, TokenValues values = TokenValues::View,
+          Comments comments = Comments::Skip)
+        : arena(arena), values(values), comments(comments), input(source), start(source.begin()),
+          position(source.begin() + begin), end(source.begin() + end) {}
 
     Token next() noexcept;
-    [[nodiscard]] int get_line() const noexcept { return curr_line; }
+
+    [[nodiscard]] const Source& source() const noexcept { return input; }
 
   private:
     Arena& arena;
+    TokenValues values;
+    Comments comments;
 
+    const Source& input;
     const char* start    = nullptr;
     const char* position = nullptr;
-    int curr_line        = 1;
+    const char* end      = nullptr;
 
-    char* open_file(const char* path);
+    std::string_view text(const char* begin, size_t len) noexcept;
+    Token token(TokenType t, const char* begin, size_t len) noexcept;
 
     Token get_identifier() noexcept;
     Token get_number() noexcept;
@@ -106,13 +131,13 @@ class Lexer {
 };
 
 inline bool is_whitespace(const char c) {
-    return std::isspace(static_cast<unsigned char>(c));
+    return scan::has(c, scan::Space);
 }
 
 inline bool is_digit(const char c) {
-    return std::isdigit(static_cast<unsigned char>(c));
+    return scan::has(c, scan::Digit);
 }
 
 inline bool is_ident_char(const char c) {
-    return (std::isalnum(static_cast<unsigned char>(c)) || c == '_');
+    return scan::has(c, scan::Ident);
 }
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// 1-based line and column of a byte offset. Columns count bytes.
+struct SourceLocation {
+    int line   = 1;
+    int column = 1;
+
+    // "line 3, column 7", as it appears in messages.
+    [[nodiscard]] std::string str() const;
+};
+
+// Offsets of the start of every line of a text, found in one vectorized
+// pass over it. Lookups are a binary search.
+class LineTable {
+  public:
+    LineTable() = default;
+    explicit LineTable(std::string_view text) { build(text); }
+
+    void build(std::string_view text);
+
+    [[nodiscard]] SourceLocation locate(uint32_t offset) const;
+
+  private:
+    std::vector<uint32_t> starts; // starts[0] is always 0
+};
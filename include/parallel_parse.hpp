@@ -0,0 +1,45 @@
+#pragma once
+
+#include "arena.hpp"
+#include "interner.hpp"
+#include "parser.hpp"
+#include "source.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// A run of whole top-level functions: bytes [begin, end) of the source.
+struct SourceChunk {
+    size_t begin;
+    size_t end;
+};
+
+// Cuts `source` into about `target` chunks of similar size. Cuts are only
+// made right after a `}` that brings brace depth back to zero, skipping
+// `#` comments, so each chunk holds whole functions. Unbalanced braces stop
+// further cuts and leave the rest of the file in the last chunk.
+std::vector<SourceChunk> split_functions(const Source& source, size_t target);
+
+// Lexes and parses one source on several threads, one chunk at a time, each
+// chunk with its own arena and interner. Chunk symbols are then merged into
+// `interner` in chunk order, which hands out exactly the ids a sequential
+// parse would; chunk types are merged into `types` the same way. The nodes
+// stay owned by this object.
+class ParallelParser {
+  public:
+    ParallelParser(const Source& source, Interner& interner, TypeTable& types, unsigned jobs,
+                   Trace* trace = nullptr);
+
+    // Throws the CompileError of the earliest failing chunk.
+    std::vector<FunctionDecl*> parse();
+
+  private:
+    const Source& source;
+    Interner& interner;
+    TypeTable& types;
+    unsigned jobs;
+    Trace* trace;
+
+    std::vector<std::unique_ptr<Arena>> arenas;
+};
@@ -1,8 +1,17 @@
 #pragma once
 
 #include "arena.hpp"
+#include "flat_ast.hpp"
+#include "interner.hpp"
 #include "lexer.hpp"
-
+#include "pipelined_lexer.hpp"
+#include "scratch_list.hpp"
+#include "token_array.hpp"
+#include "trace.hpp"
+#include "type_table.hpp"
+
+#include <span>
+#include <string>
 #include <string_view>
 #include <vector>
 
@@ -24,29 +33,51 @@ enum class StmtKind {
     If,
 };
 
-struct ASTNode {
-    virtual ~ASTNode() = default;
-};
+// Nodes live in an Arena and are never destroyed, so there is no virtual
+// destructor; `kind` tags are used to downcast.
+//
+// Expressions and statements record where they start, or where their
+// operator is, as bytes from the start of their function. That keeps them
+// valid when an IncrementalParser moves the function without reparsing it;
+// add FunctionDecl::span.begin for a source offset.
+struct ASTNode {};
 
 struct Expr : ASTNode {
     ExprKind kind;
+    uint32_t offset = 0;
 };
 struct Stmt : ASTNode {
     StmtKind kind;
+    uint32_t offset = 0;
 };
 
+// Types are hash-consed by a TypeTable and shared between every annotation
+// that spells them, so they are compared by pointer and never modified.
 struct TypeNode : ASTNode {
-    std::string_view name;
-    std::vector<TypeNode*> types;
+    Symbol name;
+    uint32_t id; // in the owning TypeTable
+    std::span<const TypeNode* const> types;
 };
 
 struct LiteralExpr : Expr {
-    std::string_view value;
+    Symbol value;
     LiteralExpr() { kind = ExprKind::Literal; }
 };
 
+// What an identifier was bound to by name resolution. `Builtin` names, such
+// as `null`, have no declaration node.
+enum class DeclKind : uint8_t {
+    Unresolved,
+    Let,
+    Param,
+    Function,
+    Builtin,
+};
+
 struct IdentifierExpr : Expr {
-    std::string_view name;
+    Symbol name;
+    DeclKind decl_kind = DeclKind::Unresolved;
+    ASTNode* decl      = nullptr; // LetStmt, Param or FunctionDecl
     IdentifierExpr() { kind = ExprKind::Identifier; }
 };
 
@@ -65,7 +96,7 @@ struct UnaryExpr : Expr {
 
 struct CallExpr : Expr {
     Expr* called;
-    std::vector<Expr*> args;
+    std::span<Expr*> args;
     CallExpr() { kind = ExprKind::Call; }
 };
 
@@ -75,8 +106,8 @@ struct ParenExpr : Expr {
 };
 
 struct LetStmt : Stmt {
-    std::string_view name;
-    TypeNode* type;
+    Symbol name;
+    const TypeNode* type;
     Expr* expr;
     LetStmt() { kind = StmtKind::Let; }
 };
@@ -92,7 +123,7 @@ struct ExprStmt : Stmt {
 };
 
 struct ScopeStmt : Stmt {
-    std::vector<Stmt*> statements;
+    std::span<Stmt*> statements;
     ScopeStmt() { kind = StmtKind::Scope; }
 };
 
@@ -103,15 +134,23 @@ struct IfStmt : Stmt {
     IfStmt() { kind = StmtKind::If; }
 };
 
-struct Param {
-    std::string_view name;
-    TypeNode* type;
+struct Param : ASTNode {
+    Symbol name;
+    uint32_t offset; // from the start of the function, like Expr::offset
+    const TypeNode* type;
+};
+
+// Byte offsets [begin, end) into the source a node was parsed from.
+struct SourceSpan {
+    uint32_t begin;
+    uint32_t end;
 };
 
 struct FunctionDecl : ASTNode {
-    std::string_view name;
-    std::vector<Param*> params;
-    TypeNode* return_type;
+    SourceSpan span; // from `function` through the closing `}`
+    Symbol name;
+    std::span<Param*> params;
+    const TypeNode* return_type;
     ScopeStmt* body;
 };
 
@@ -130,24 +169,62 @@ enum Precedence : int {
 
 class Parser {
   public:
-    Parser(Lexer& lexer, Arena& arena);
+    Parser(Lexer& lexer, Arena& arena, Interner& interner, TypeTable& types);
+
+    // Reads tokens by index from an array lexed up front instead of pulling
+    // them from a Lexer one at a time.
+    Parser(const TokenArray& tokens, Arena& arena, Interner& interner, TypeTable& types);
+
+    // Consumes tokens lexed concurrently on the PipelinedLexer's thread.
+    Parser(PipelinedLexer& stream, Arena& arena, Interner& interner, TypeTable& types);
 
     std::vector<FunctionDecl*> parse();
 
-    void print_program(const std::vector<FunctionDecl*>& fns);
+    // Builds the index-based representation instead of arena nodes.
+    FlatAst parse_flat();
+
+    // Records a span per parsed function into `trace`, or nothing if null.
+    void set_trace(Trace* t) { trace = t; }
+
+    // Lookahead and backtracking. Looking past the current token needs a
+    // TokenArray; when streaming tokens only peek(0) is allowed.
+    [[nodiscard]] TokenType peek(uint32_t n) const;
+    [[nodiscard]] uint32_t position() const noexcept { return index; }
+    void rewind(uint32_t to);
 
   private:
-    Lexer& lexer;
+    const Source& source;
+    Lexer* lexer             = nullptr;
+    PipelinedLexer* stream   = nullptr;
+    const TokenArray* tokens = nullptr;
+    uint32_t index           = 0; // of `curr` in `tokens`
     Arena& arena;
+    Interner& interner;
+    TypeTable& types;
 
     Token curr;
+    uint32_t scope_end = 0;
+    uint32_t fn_begin  = 0; // source offset of the function being parsed
+
+    ScratchList<Stmt*> stmt_lists;
+    ScratchList<Expr*> expr_lists;
+    ScratchList<Param*> param_lists;
+    ScratchList<const TypeNode*> type_lists;
+
+    Trace* trace = nullptr;
+
+    FlatAst* flat = nullptr;
+    ScratchList<uint32_t> flat_lists;
 
     void advance();
     Token expect(TokenType t);
+    Symbol expect_symbol(TokenType t);
+    uint32_t relative(uint32_t offset) const { return offset - fn_begin; }
+    [[nodiscard]] std::string curr_location() const;
 
     FunctionDecl* parse_function();
     Param* parse_param();
-    TypeNode* parse_type();
+    const TypeNode* parse_type();
 
     Stmt* parse_stmt();
     ScopeStmt* parse_scope();
@@ -163,12 +240,25 @@ class Parser {
     Expr* parse_call(Expr* from);
     Expr* parse_precedence(const int prec);
 
+    void flat_function();
+    uint32_t flat_params();
+    NodeIndex flat_type();
+
+    NodeIndex flat_stmt();
+    NodeIndex flat_scope();
+    NodeIndex flat_let();
+    NodeIndex flat_if();
+    NodeIndex flat_return();
+    NodeIndex flat_expr_stmt();
+
+    NodeIndex flat_expr();
+    NodeIndex flat_prefix();
+    NodeIndex flat_infix(NodeIndex left, const Token& op, const int prec);
+    NodeIndex flat_call(NodeIndex from);
+    NodeIndex flat_precedence(const int prec);
+    bool flat_callable(NodeIndex expr);
+
     bool is_callable(Expr* expr);
     int get_precedence(TokenType t);
 
-    void indent(const int n);
-    void print_expr(Expr* expr, const int indent_level = 0);
-    void print_stmt(Stmt* stmt, const int indent_level = 0);
-    void print_type(TypeNode* t, const int indent_level = 0);
-    void print_function(FunctionDecl* fn);
 };
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "source.hpp"
+#include "spsc_ring.hpp"
+#include "token_array.hpp"
+
+#include <cstdint>
+#include <thread>
+
+// Lexes a Source on a background thread while the caller consumes the
+// tokens, so lexing and parsing overlap. Tokens travel in batches through an
+// SpscRing; the batch holding FileEnd is the last one the producer writes.
+// Comments are skipped, as with the default Lexer.
+class PipelinedLexer {
+  public:
+    static constexpr uint32_t batch_size = 2048;
+    static constexpr size_t ring_size    = 16;
+
+    explicit PipelinedLexer(const Source& source);
+    ~PipelinedLexer();
+
+    PipelinedLexer(const PipelinedLexer&)            = delete;
+    PipelinedLexer& operator=(const PipelinedLexer&) = delete;
+
+    // Same contract as Lexer::next(). Once FileEnd is returned it keeps
+    // being returned. Throws CompileError for a
+    // token longer than TokenArray::max_length.
+    Token next() {
+        if (pos == count) [[unlikely]]
+            refill();
+
+        last = batch->tokens[pos];
+        if (last.type != static_cast<uint32_t>(TokenType::FileEnd)) [[likely]]
+            pos++;
+        else if (failed)
+            throw_too_long();
+
+        return Token(static_cast<TokenType>(last.type), {base + last.offset, last.length}, last.offset);
+    }
+
+    [[nodiscard]] const Source& source() const noexcept { return input; }
+
+  private:
+    struct Batch {
+        uint32_t count;
+        bool failed; // the batch ends early at a token that was too long
+        CompactToken tokens[batch_size];
+    };
+
+    const Source& input;
+    const char* base;
+    SpscRing<Batch, ring_size> ring;
+
+    // Consumer state.
+    const Batch* batch = nullptr;
+    uint32_t pos       = 0;
+    uint32_t count     = 0;
+    bool failed        = false;
+    CompactToken last{};
+
+    std::thread producer;
+
+    void produce();
+    void refill();
+    [[noreturn]] void throw_too_long() const;
+};
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "ir.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// x86-64 general purpose registers, in encoding order.
+enum class Register : uint8_t {
+    Rax,
+    Rcx,
+    Rdx,
+    Rbx,
+    Rsp,
+    Rbp,
+    Rsi,
+    Rdi,
+    R8,
+    R9,
+    R10,
+    R11,
+    R12,
+    R13,
+    R14,
+    R15,
+};
+
+// Integer argument registers of the System V ABI, in order.
+inline constexpr Register arg_registers[] = {Register::Rdi, Register::Rsi, Register::Rdx,
+                                             Register::Rcx, Register::R8,  Register::R9};
+
+// Where a value lives, for the whole of its lifetime.
+struct Location {
+    enum Kind : uint8_t {
+        None,  // never read, or a comparison fused into the branch after it
+        Reg,   // register `reg`
+        Stack, // spill slot `slot`
+        Imm,   // a constant that fits a 32-bit immediate, `imm`
+    };
+
+    Kind kind     = None;
+    Register reg  = Register::Rax;
+    uint32_t slot = 0;
+    int64_t imm   = 0;
+};
+
+struct Allocation {
+    std::vector<BlockId> order;   // code layout: reachable blocks in reverse postorder
+    std::vector<Location> values; // by ValueId
+    std::vector<uint8_t> fused;   // comparisons emitted by the branch that follows them
+    uint32_t slots = 0;           // spill slots needed
+    uint16_t saved = 0;           // callee-saved registers used, bit 1 << Register
+
+    uint32_t intervals = 0;
+    uint32_t spilled   = 0;
+    uint32_t coalesced = 0; // values that got the register of the value they are copied from or to
+};
+
+// Linear-scan allocation over one function, after Poletto and Sarkar.
+//
+// Blocks are laid out in reverse postorder. The language has no loops, so
+// that order is topological and every value is live over one contiguous
+// range, from its definition to its last use; a phi's operands are used at
+// the end of their predecessor. Intervals therefore come out sorted, and the
+// scan runs in time linear in the number of instructions.
+//
+// %rax, %r11 and the frame registers are left to the code generator as
+// scratch. A value live across a call only gets a callee-saved register,
+// and one live across a division never gets %rdx, which idiv overwrites.
+// When no register is free, the interval that ends last is spilled. Values
+// prefer the register of the operand they are computed from, and of the
+// argument register they are passed or received in, which removes most
+// moves.
+Allocation allocate_registers(const IrFunction& f);
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "arena.hpp"
+#include "interner.hpp"
+#include "parser.hpp"
+#include "source.hpp"
+
+#include <cstdint>
+#include <span>
+
+// Binds every IdentifierExpr to the LetStmt, Param or FunctionDecl it names,
+// filling in `decl` and `decl_kind`.
+//
+// Functions are visible everywhere in the file. Parameters are visible in
+// their function's body. A `let` is visible from the statement after it to
+// the end of its scope, including nested scopes, and may shadow any outer
+// name, but not another `let` of the same scope. Parameter names must be
+// distinct. `null` resolves as a builtin.
+//
+// Symbol tables are open-addressed and live in `arena`. Each function's
+// tables are rolled back once its body is done, so resolving a file costs
+// one global table plus the deepest function's scopes and makes no
+// per-scope heap allocations.
+class Resolver {
+  public:
+    // `source` is the text the functions were parsed from, for messages.
+    Resolver(const Source& source, Arena& arena, Interner& interner);
+
+    // Throws CompileError for a name used without a declaration in scope,
+    // or a function, parameter or `let` defined twice in one scope.
+    void resolve(std::span<FunctionDecl* const> fns);
+
+  private:
+    struct Entry {
+        Symbol name;
+        DeclKind kind;
+        ASTNode* decl;
+    };
+
+    struct Table {
+        Table* parent;
+        Entry* slots;
+        uint32_t mask;
+        uint32_t shift;
+    };
+
+    const Source& source;
+    Arena& arena;
+    Interner& interner;
+    Symbol null_symbol;
+
+    Table* scope                = nullptr; // innermost table
+    const FunctionDecl* current = nullptr; // for messages
+
+    void open(uint32_t expected);
+    void close() { scope = scope->parent; }
+
+    // Returns false if `name` already has an entry in the innermost table.
+    bool declare(Symbol name, DeclKind kind, ASTNode* decl);
+    const Entry* lookup(Symbol name) const;
+
+    // Throws for a second `what` called `name` in one scope, at `offset`
+    // into the current function.
+    [[noreturn]] void redefined(const char* what, Symbol name, uint32_t offset) const;
+
+    void function(FunctionDecl* fn);
+    void stmt(Stmt* s);
+    void block(ScopeStmt* s);
+    void expr(Expr* e);
+};
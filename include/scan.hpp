@@ -0,0 +1,225 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// Character classification and bulk scanning for the lexer.
+//
+// Every skip_* routine reads whole vectors past the current position, so the
+// input must be NUL terminated and padded (see Source::padding). NUL belongs
+// to no class, which is what stops each scan at the end of the buffer.
+namespace scan {
+
+enum : uint8_t {
+    Space      = 1 << 0,
+    Newline    = 1 << 1,
+    Digit      = 1 << 2,
+    IdentStart = 1 << 3,
+    Ident      = 1 << 4,
+};
+
+constexpr std::array<uint8_t, 256> make_char_class() {
+    std::array<uint8_t, 256> table{};
+
+    for (int c : {' ', '\t', '\n', '\v', '\f', '\r'})
+        table[c] |= Space;
+    table['\n'] |= Newline;
+
+    for (int c = '0'; c <= '9'; c++)
+        table[c] |= Digit | Ident;
+    for (int c = 'a'; c <= 'z'; c++)
+        table[c] |= IdentStart | Ident;
+    for (int c = 'A'; c <= 'Z'; c++)
+        table[c] |= IdentStart | Ident;
+    table['_'] |= IdentStart | Ident;
+
+    return table;
+}
+
+inline constexpr std::array<uint8_t, 256> char_class = make_char_class();
+
+inline bool has(char c, uint8_t cls) noexcept {
+    return char_class[static_cast<unsigned char>(c)] & cls;
+}
+
+#if defined(__AVX2__)
+
+inline constexpr size_t width    = 32;
+inline constexpr uint32_t all_of = 0xFFFFFFFFu;
+
+using Vec = __m256i;
+
+inline Vec load(const char* p) noexcept { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+inline Vec splat(char c) noexcept { return _mm256_set1_epi8(c); }
+inline Vec eq(Vec a, Vec b) noexcept { return _mm256_cmpeq_epi8(a, b); }
+inline Vec sub(Vec a, Vec b) noexcept { return _mm256_sub_epi8(a, b); }
+inline Vec either(Vec a, Vec b) noexcept { return _mm256_or_si256(a, b); }
+inline Vec at_most(Vec a, char n) noexcept { return eq(_mm256_min_epu8(a, splat(n)), a); }
+inline uint32_t bits(Vec v) noexcept { return static_cast<uint32_t>(_mm256_movemask_epi8(v)); }
+
+#elif defined(__SSE2__)
+
+inline constexpr size_t width    = 16;
+inline constexpr uint32_t all_of = 0xFFFFu;
+
+using Vec = __m128i;
+
+inline Vec load(const char* p) noexcept { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+inline Vec splat(char c) noexcept { return _mm_set1_epi8(c); }
+inline Vec eq(Vec a, Vec b) noexcept { return _mm_cmpeq_epi8(a, b); }
+inline Vec sub(Vec a, Vec b) noexcept { return _mm_sub_epi8(a, b); }
+inline Vec either(Vec a, Vec b) noexcept { return _mm_or_si128(a, b); }
+inline Vec at_most(Vec a, char n) noexcept { return eq(_mm_min_epu8(a, splat(n)), a); }
+inline uint32_t bits(Vec v) noexcept { return static_cast<uint32_t>(_mm_movemask_epi8(v)); }
+
+#endif
+
+#if defined(__AVX2__) || defined(__SSE2__)
+
+// Byte masks over one vector: bit i is set when p[i] is in the class.
+// Ranges are tested with an unsigned "c - lo <= hi - lo" compare.
+
+inline uint32_t space_bits(Vec v) noexcept {
+    return bits(either(eq(v, splat(' ')), at_most(sub(v, splat('\t')), '\r' - '\t')));
+}
+
+inline uint32_t digit_bits(Vec v) noexcept {
+    return bits(at_most(sub(v, splat('0')), 9));
+}
+
+inline uint32_t ident_bits(Vec v) noexcept {
+    Vec lower = either(v, splat(0x20));
+    Vec alpha = at_most(sub(lower, splat('a')), 'z' - 'a');
+    Vec digit = at_most(sub(v, splat('0')), 9);
+    return bits(either(either(alpha, digit), eq(v, splat('_'))));
+}
+
+// Most runs are a few bytes long, so each scan checks `short_run` bytes
+// through the table before switching to whole vectors.
+inline constexpr int short_run = 8;
+
+inline const char* skip_whitespace(const char* p) noexcept {
+    for (int i = 0; i < short_run; i++, p++) {
+        if (!has(*p, Space))
+            return p;
+    }
+
+    for (;; p += width) {
+        uint32_t m = space_bits(load(p));
+        if (m != all_of)
+            return p + std::countr_zero(~m);
+    }
+}
+
+inline const char* skip_digits(const char* p) noexcept {
+    for (int i = 0; i < short_run; i++, p++) {
+        if (!has(*p, Digit))
+            return p;
+    }
+
+    for (;; p += width) {
+        uint32_t m = digit_bits(load(p));
+        if (m != all_of)
+            return p + std::countr_zero(~m);
+    }
+}
+
+inline const char* skip_ident(const char* p) noexcept {
+    for (int i = 0; i < short_run; i++, p++) {
+        if (!has(*p, Ident))
+            return p;
+    }
+
+    for (;; p += width) {
+        uint32_t m = ident_bits(load(p));
+        if (m != all_of)
+            return p + std::countr_zero(~m);
+    }
+}
+
+// Stops at the next '\n' or at the NUL sentinel.
+inline const char* skip_line(const char* p) noexcept {
+    for (;; p += width) {
+        Vec v      = load(p);
+        uint32_t m = bits(either(eq(v, splat('\n')), eq(v, splat('\0'))));
+        if (m)
+            return p + std::countr_zero(m);
+    }
+}
+
+// Stops at the next '{', '}', '#' or the NUL sentinel.
+inline const char* find_structural(const char* p) noexcept {
+    for (;; p += width) {
+        Vec v      = load(p);
+        Vec braces = either(eq(v, splat('{')), eq(v, splat('}')));
+        Vec stops  = either(eq(v, splat('#')), eq(v, splat('\0')));
+        uint32_t m = bits(either(braces, stops));
+        if (m)
+            return p + std::countr_zero(m);
+    }
+}
+
+// Calls f(i) for the offset from `begin` of every '\n' in [begin, end), in
+// order.
+template <class F>
+inline void for_each_newline(const char* begin, const char* end, F f) {
+    const char* p = begin;
+    for (; p + width <= end; p += width) {
+        for (uint32_t m = bits(eq(load(p), splat('\n'))); m; m &= m - 1)
+            f(static_cast<size_t>(p - begin) + std::countr_zero(m));
+    }
+    for (; p < end; p++) {
+        if (*p == '\n')
+            f(static_cast<size_t>(p - begin));
+    }
+}
+
+#else
+
+inline const char* skip_whitespace(const char* p) noexcept {
+    while (has(*p, Space))
+        p++;
+    return p;
+}
+
+inline const char* skip_digits(const char* p) noexcept {
+    while (has(*p, Digit))
+        p++;
+    return p;
+}
+
+inline const char* skip_ident(const char* p) noexcept {
+    while (has(*p, Ident))
+        p++;
+    return p;
+}
+
+inline const char* skip_line(const char* p) noexcept {
+    while (*p != '\n' && *p != '\0')
+        p++;
+    return p;
+}
+
+inline const char* find_structural(const char* p) noexcept {
+    while (*p != '{' && *p != '}' && *p != '#' && *p != '\0')
+        p++;
+    return p;
+}
+
+template <class F>
+inline void for_each_newline(const char* begin, const char* end, F f) {
+    for (const char* p = begin; p < end; p++) {
+        if (*p == '\n')
+            f(static_cast<size_t>(p - begin));
+    }
+}
+
+#endif
+
+} // namespace scan
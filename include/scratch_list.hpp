@@ -0,0 +1,39 @@
+#pragma once
+
+#include "arena.hpp"
+
+#include <cstddef>
+#include <span>
+#include <vector>
+
+// Builds arena-resident lists whose length is not known up front.
+//
+// Nested lists share one stack: `open()` remembers where a list starts,
+// children are pushed on top, and `finish()` copies them into a single
+// contiguous span in the arena and pops them again. The stack is reused for
+// the whole parse, so it stops growing after the deepest nesting is seen.
+template<typename T>
+class ScratchList {
+  public:
+    explicit ScratchList(size_t reserve = 256) { items.reserve(reserve); }
+
+    [[nodiscard]] size_t open() const noexcept { return items.size(); }
+
+    void push(T item) { items.push_back(item); }
+
+    std::span<T> finish(size_t start, Arena& arena) {
+        std::span<T> out = arena.copy_span(items.data() + start, items.size() - start);
+        close(start);
+        return out;
+    }
+
+    // For callers that copy the items somewhere other than an arena.
+    [[nodiscard]] std::span<const T> view(size_t start) const noexcept {
+        return {items.data() + start, items.size() - start};
+    }
+
+    void close(size_t start) { items.resize(start); }
+
+  private:
+    std::vector<T> items;
+};
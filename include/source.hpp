@@ -0,0 +1,60 @@
+#pragma once
+
+#include "line_table.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+// Owns the text of one input file. Token values and anything else that
+// views the source must not outlive it.
+//
+// Regular files are mapped read-only; stdin ("-") and pipes are read into
+// a heap buffer. Either way at least `padding` zero bytes are readable past
+// end(), so the lexer can rely on a NUL sentinel and over-read safely.
+class Source {
+  public:
+    static constexpr size_t padding = 64;
+
+    explicit Source(const char* path);
+
+    // Wraps text that is not on disk, such as an editor buffer. `name` is
+    // only used in messages.
+    Source(const char* name, std::string_view text);
+    ~Source();
+
+    Source(const Source&)            = delete;
+    Source& operator=(const Source&) = delete;
+
+    [[nodiscard]] bool ok() const noexcept { return buffer != nullptr; }
+    [[nodiscard]] const std::string& error() const noexcept { return error_message; }
+
+    [[nodiscard]] const char* begin() const noexcept { return buffer; }
+    [[nodiscard]] const char* end() const noexcept { return buffer + length; }
+    [[nodiscard]] size_t size() const noexcept { return length; }
+    [[nodiscard]] std::string_view text() const noexcept { return {buffer, length}; }
+    [[nodiscard]] const char* path() const noexcept { return file_path; }
+
+    // Line and column of a byte offset. The line table is built by the
+    // first call, so sources that never report a position never pay for
+    // it; calls from several threads are safe.
+    [[nodiscard]] SourceLocation locate(uint32_t offset) const {
+        std::call_once(lines_built, [this] { lines.build(text()); });
+        return lines.locate(offset);
+    }
+
+  private:
+    const char* file_path;
+    const char* buffer = nullptr;
+    size_t length      = 0;
+    size_t mapped      = 0;
+    std::string error_message;
+
+    mutable std::once_flag lines_built;
+    mutable LineTable lines;
+
+    bool map_file(int fd, size_t size);
+    bool read_stream(int fd);
+};
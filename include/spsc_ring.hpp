@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Fixed-capacity ring shared by exactly one producer and one consumer
+// thread. Slots are filled and read in place, so large items such as token
+// batches are never copied. Each side blocks with atomic wait/notify only
+// when the ring is full or empty, which is also the backpressure on a
+// producer that runs ahead.
+template<typename T, size_t Capacity>
+class SpscRing {
+  public:
+    static_assert(Capacity > 0);
+
+    SpscRing() : slots(std::make_unique<T[]>(Capacity)) {}
+
+    SpscRing(const SpscRing&)            = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    // Producer: the next free slot, waiting while the ring is full. Returns
+    // null once the consumer has closed the ring.
+    T* begin_write() {
+        uint64_t t = tail.load(std::memory_order_acquire);
+        while (write_pos - t == Capacity && !closed.load(std::memory_order_acquire)) {
+            tail.wait(t, std::memory_order_acquire);
+            t = tail.load(std::memory_order_acquire);
+        }
+
+        if (closed.load(std::memory_order_acquire))
+            return nullptr;
+        return &slots[write_pos % Capacity];
+    }
+
+    // Producer: hands the slot from begin_write() to the consumer.
+    void publish() {
+        head.store(++write_pos, std::memory_order_release);
+        head.notify_one();
+    }
+
+    // Consumer: the oldest published slot, waiting while the ring is empty.
+    T* begin_read() {
+        uint64_t h = head.load(std::memory_order_acquire);
+        while (h == read_pos) {
+            head.wait(h, std::memory_order_acquire);
+            h = head.load(std::memory_order_acquire);
+        }
+        return &slots[read_pos % Capacity];
+    }
+
+    // Consumer: returns the slot from begin_read() to the producer.
+    void release() {
+        tail.store(++read_pos, std::memory_order_release);
+        tail.notify_one();
+    }
+
+    // Consumer: stops the producer, waking it if it is waiting for space.
+    void close() {
+        closed.store(true, std::memory_order_release);
+        tail.fetch_add(1, std::memory_order_release);
+        tail.notify_one();
+    }
+
+  private:
+    static constexpr size_t line = 64;
+
+    std::unique_ptr<T[]> slots;
+
+    // Each index is written by one side only; keeping them on separate cache
+    // lines stops the two threads from invalidating each other's state.
+    alignas(line) std::atomic<uint64_t> head{0}; // slots published
+    uint64_t write_pos = 0;                      // producer's copy of head
+
+    alignas(line) std::atomic<uint64_t> tail{0}; // slots released
+    uint64_t read_pos = 0;                       // consumer's copy of tail
+
+    alignas(line) std::atomic<bool> closed{false};
+};
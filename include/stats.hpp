@@ -0,0 +1,111 @@
+#pragma once
+
+#include "flat_ast.hpp"
+#include "ir_passes.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+#include "source.hpp"
+#include "token_array.hpp"
+#include "trace.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <span>
+#include <vector>
+
+// Counters gathered by `--stats`. Nothing here is touched unless the driver
+// was asked for statistics: tokens are counted by a separate lexing pass
+// and nodes by walking the finished tree, so the lexer and parser carry no
+// counting code of their own.
+struct Stats {
+    enum Phase {
+        Load,
+        Lex,
+        Parse,
+        Resolve,
+        Codegen,
+        Optimize,
+        Run,
+        Emit,
+        PhaseCount,
+    };
+
+    static constexpr size_t token_kinds = static_cast<size_t>(TokenType::Unknown) + 1;
+    static constexpr size_t expr_kinds  = static_cast<size_t>(ExprKind::Call) + 1;
+    static constexpr size_t stmt_kinds  = static_cast<size_t>(StmtKind::If) + 1;
+
+    uint64_t files = 0;
+    uint64_t bytes = 0;
+    std::array<double, PhaseCount> seconds{};
+
+    std::array<uint64_t, token_kinds> tokens{};
+    std::array<uint64_t, expr_kinds> exprs{};
+    std::array<uint64_t, stmt_kinds> stmts{};
+    uint64_t types        = 0; // annotations, counting each use of a shared type
+    uint64_t unique_types = 0; // nodes in the TypeTable
+    uint64_t functions    = 0;
+
+    uint64_t ir_lowered = 0;         // IR instructions before any pass
+    std::vector<PassReport> passes; // the pass pipeline, totalled over files
+
+    uint64_t tasks  = 0; // per-function code generation tasks run
+    uint64_t steals = 0; // of which taken from another worker's deque
+
+    uint64_t cache_hits   = 0; // functions whose output came from the code cache
+    uint64_t cache_misses = 0;
+
+    size_t lexer_arena_peak  = 0;
+    size_t parser_arena_peak = 0;
+
+    // Lexes all of `source` once, counting tokens by type.
+    void count_tokens(const Source& source, Arena& arena);
+    void count_tokens(const TokenArray& tokens);
+
+    void count_nodes(std::span<FunctionDecl* const> fns);
+    void count_nodes(const FlatView& ast);
+
+    [[nodiscard]] uint64_t node_count() const;
+
+    // Adds one run of the pass pipeline to `passes`, pass by pass.
+    void add_passes(std::span<const PassReport> reports);
+
+    // Sums counters and times, keeps the larger arena peaks.
+    void merge(const Stats& other);
+
+    void print(std::ostream& out) const;
+};
+
+// Times one phase into Stats and/or Trace. With both null it does nothing,
+// not even read the clock.
+class PhaseTimer {
+  public:
+    PhaseTimer(Stats* stats, Trace* trace, Stats::Phase phase, const char* name)
+        : stats(stats), trace(trace), phase(phase), name(name) {
+        if (stats || trace)
+            start = Trace::Clock::now();
+    }
+
+    ~PhaseTimer() { stop(); }
+
+    // Ends the phase before the end of the enclosing scope.
+    void stop() {
+        if (stats)
+            stats->seconds[phase] += std::chrono::duration<double>(Trace::Clock::now() - start).count();
+        if (trace)
+            trace->complete(name, "phase", start);
+        stats = nullptr;
+        trace = nullptr;
+    }
+
+    PhaseTimer(const PhaseTimer&)            = delete;
+    PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+  private:
+    Stats* stats;
+    Trace* trace;
+    Stats::Phase phase;
+    const char* name;
+    Trace::Clock::time_point start;
+};
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+// Deque of task ids owned by one worker, after Chase and Lev, with the
+// memory orders of Lê et al. The owner pushes and pops at the bottom without
+// locking; other workers steal the oldest task from the top and only race
+// with each other, and with the owner over the last task, through a
+// compare-and-swap on `top`. The ring doubles when full. Outgrown rings are
+// kept until the deque is destroyed, since a thief may still be reading one.
+class WorkDeque {
+  public:
+    explicit WorkDeque(size_t capacity = 64);
+
+    WorkDeque(const WorkDeque&)            = delete;
+    WorkDeque& operator=(const WorkDeque&) = delete;
+
+    // Owner only.
+    void push(uint64_t task);
+    bool pop(uint64_t& task);
+
+    // Any thread. Also fails when another thread took the task first.
+    bool steal(uint64_t& task);
+
+  private:
+    struct Ring {
+        explicit Ring(size_t capacity)
+            : mask(capacity - 1), slots(std::make_unique<std::atomic<uint64_t>[]>(capacity)) {}
+
+        std::atomic<uint64_t>& operator[](int64_t i) { return slots[static_cast<size_t>(i) & mask]; }
+        size_t capacity() const { return mask + 1; }
+
+        size_t mask;
+        std::unique_ptr<std::atomic<uint64_t>[]> slots;
+    };
+
+    alignas(64) std::atomic<int64_t> top{0};
+    alignas(64) std::atomic<int64_t> bottom{0};
+    std::atomic<Ring*> ring;
+    std::vector<std::unique_ptr<Ring>> rings; // owner only; the current ring is last
+};
+
+// Runs tasks on a fixed number of workers, each with its own WorkDeque.
+//
+// A worker runs its own newest task first, so a task it spawns as a
+// follow-up runs next, on the core that has the data in cache. Once its
+// deque is empty it steals the oldest task of another worker, trying them
+// from a random one onwards. A few large tasks then never hold up the rest:
+// whoever is free takes the remaining work.
+//
+// Tasks are 64-bit ids that mean whatever the body makes of them.
+class TaskScheduler {
+  public:
+    explicit TaskScheduler(unsigned workers);
+
+    TaskScheduler(const TaskScheduler&)            = delete;
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+    [[nodiscard]] unsigned workers() const { return static_cast<unsigned>(deques.size()); }
+
+    // Calls `body(task, worker)` for each of `tasks` and for every task
+    // spawned meanwhile, on the calling thread (worker 0) and workers() - 1
+    // new ones, and returns when all have run. Tasks are dealt to the
+    // workers in turn and each worker starts from the last it was dealt, so
+    // passing them in increasing order of size starts the largest first.
+    //
+    // If a task throws, tasks that have not started yet are dropped and the
+    // first exception is rethrown here.
+    template<typename F>
+    void run(std::span<const uint64_t> tasks, F&& body);
+
+    // Queues `task` on the deque of `worker`, which must be the worker
+    // running the calling task.
+    void spawn(unsigned worker, uint64_t task);
+
+    // Tasks a worker took from another worker's deque, over all runs.
+    [[nodiscard]] uint64_t steals() const { return stolen.load(std::memory_order_relaxed); }
+
+  private:
+    std::vector<std::unique_ptr<WorkDeque>> deques;
+    std::atomic<uint64_t> pending{0}; // dealt or spawned and not yet finished
+    std::atomic<uint64_t> stolen{0};
+
+    std::atomic<bool> failed{false};
+    std::mutex error_mutex;
+    std::exception_ptr error;
+
+    // The next task for `worker`: its own newest, or one stolen from
+    // another worker.
+    bool next(unsigned worker, uint32_t& random, uint64_t& task);
+
+    void fail(std::exception_ptr e);
+};
+
+template<typename F>
+void TaskScheduler::run(std::span<const uint64_t> tasks, F&& body) {
+    if (tasks.empty())
+        return;
+
+    failed.store(false, std::memory_order_relaxed);
+    error = nullptr;
+
+    // The threads are not started yet, so this thread may push as every
+    // owner.
+    pending.store(tasks.size(), std::memory_order_relaxed);
+    for (size_t i = 0; i < tasks.size(); i++)
+        deques[i % deques.size()]->push(tasks[i]);
+
+    auto loop = [&](unsigned worker) {
+        uint32_t random = worker * 2654435761u + 1;
+        uint64_t task;
+
+        while (pending.load(std::memory_order_acquire) > 0) {
+            if (!next(worker, random, task)) {
+                std::this_thread::yield();
+                continue;
+            }
+
+            if (!failed.load(std::memory_order_relaxed)) {
+                try {
+                    body(task, worker);
+                } catch (...) {
+                    fail(std::current_exception());
+                }
+            }
+            pending.fetch_sub(1, std::memory_order_acq_rel);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(deques.size() - 1);
+    for (unsigned t = 1; t < deques.size(); t++)
+        threads.emplace_back(loop, t);
+    loop(0);
+
+    for (auto& thread : threads)
+        thread.join();
+
+    if (error)
+        std::rethrow_exception(error);
+}
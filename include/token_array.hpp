@@ -0,0 +1,61 @@
+#pragma once
+
+#include "lexer.hpp"
+#include "source.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// One token in 8 bytes: where it starts, how long it is and what it is.
+// The text is the slice of the source it came from; the line and column
+// are looked up only when a message needs them.
+struct CompactToken {
+    uint32_t offset;
+    uint32_t type : 8;
+    uint32_t length : 24;
+};
+
+static_assert(sizeof(CompactToken) == 8);
+
+// The whole input lexed up front into a contiguous array, for parsing by
+// index. Comments are dropped and the last token is always FileEnd; reading
+// past it keeps returning FileEnd, as the lexer does.
+class TokenArray {
+  public:
+    static constexpr uint32_t max_length = (1u << 24) - 1;
+
+    // Throws CompileError for a token longer than max_length.
+    explicit TokenArray(const Source& source);
+
+    TokenArray(const TokenArray&)            = delete;
+    TokenArray& operator=(const TokenArray&) = delete;
+
+    [[nodiscard]] uint32_t size() const noexcept { return static_cast<uint32_t>(tokens.size()); }
+
+    [[nodiscard]] TokenType type(uint32_t i) const noexcept { return static_cast<TokenType>(at(i).type); }
+    [[nodiscard]] uint32_t offset(uint32_t i) const noexcept { return at(i).offset; }
+
+    [[nodiscard]] std::string_view text(uint32_t i) const noexcept {
+        const CompactToken& t = at(i);
+        return {base + t.offset, t.length};
+    }
+
+    // The token as the lexer would have returned it.
+    [[nodiscard]] Token token(uint32_t i) const noexcept {
+        const CompactToken& t = at(i);
+        return Token(static_cast<TokenType>(t.type), {base + t.offset, t.length}, t.offset);
+    }
+
+    [[nodiscard]] const Source& source() const noexcept { return input; }
+
+    [[nodiscard]] size_t bytes() const noexcept { return tokens.capacity() * sizeof(CompactToken); }
+
+  private:
+    const Source& input;
+    const char* base;
+    std::vector<CompactToken> tokens;
+
+    const CompactToken& at(uint32_t i) const noexcept { return tokens[std::min<size_t>(i, tokens.size() - 1)]; }
+};
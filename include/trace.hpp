@@ -0,0 +1,40 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Collects complete ("X") events and writes them in the Chrome trace-event
+// format, viewable in chrome://tracing or Perfetto. Safe to record into
+// from several threads; each thread shows up as its own track.
+class Trace {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    Trace() : origin(Clock::now()) {}
+
+    Trace(const Trace&)            = delete;
+    Trace& operator=(const Trace&) = delete;
+
+    // Records `name` as running from `start` until now.
+    void complete(std::string_view name, const char* category, Clock::time_point start);
+
+    // Returns false if the file could not be written.
+    bool write(const char* path) const;
+
+  private:
+    struct Event {
+        std::string name;
+        const char* category;
+        int64_t start_ns;
+        int64_t duration_ns;
+        uint32_t thread;
+    };
+
+    Clock::time_point origin;
+    mutable std::mutex mutex;
+    std::vector<Event> events;
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "arena.hpp"
+#include "interner.hpp"
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+struct TypeNode;
+
+// Hash-conses type annotations: each distinct `name<args...>` gets exactly
+// one node, so two types are equal iff their pointers are. Nodes are
+// immutable and owned by the table, which keeps them alive after the parser
+// that asked for them is gone.
+class TypeTable {
+  public:
+    TypeTable();
+
+    TypeTable(const TypeTable&)            = delete;
+    TypeTable& operator=(const TypeTable&) = delete;
+
+    // The node for `name<args...>`, created on first use. `args` must be
+    // nodes of this table.
+    const TypeNode* intern(Symbol name, std::span<const TypeNode* const> args);
+
+    // Nodes by id, in order of creation; arguments come before the types
+    // that use them.
+    [[nodiscard]] const TypeNode* node(uint32_t id) const noexcept { return nodes[id]; }
+    [[nodiscard]] size_t size() const noexcept { return nodes.size(); }
+
+    // Memory held by the nodes and the index.
+    [[nodiscard]] size_t bytes() const noexcept {
+        return storage.used() + slots.size() * sizeof(Slot) + nodes.capacity() * sizeof(nodes[0]);
+    }
+
+  private:
+    struct Slot {
+        uint32_t hash;
+        uint32_t id;
+    };
+
+    static constexpr uint32_t empty = UINT32_MAX;
+
+    Arena storage;
+    std::vector<Slot> slots;
+    std::vector<const TypeNode*> nodes;
+    uint32_t mask;
+
+    static uint32_t hash(Symbol name, std::span<const TypeNode* const> args) noexcept;
+    void grow();
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "bytecode.hpp"
+#include "interner.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+// Runs Bytecode with threaded dispatch: each handler jumps straight to the
+// next one through a table of label addresses, where the compiler supports
+// it, instead of returning to a central switch.
+//
+// All frames are windows onto one register stack. A call's arguments are
+// already in the first registers of the callee's window, so calls copy
+// nothing and the result is left where the first argument was.
+class Vm {
+  public:
+    // `stack_registers` bounds the total frame size of all active calls.
+    Vm(const Bytecode& code, const Interner& interner, size_t stack_registers = 1 << 20);
+
+    // Calls `function` with `args`. Throws CompileError on division by zero
+    // or when the register stack runs out.
+    int64_t run(uint32_t function, std::span<const int64_t> args);
+
+    // Calls made so far, counting the entry call of each run().
+    [[nodiscard]] uint64_t calls() const noexcept { return call_count; }
+
+  private:
+    struct Frame {
+        const Instr* return_pc;
+        int64_t* base;
+    };
+
+    const Bytecode& code;
+    const Interner& interner;
+    std::unique_ptr<int64_t[]> stack;
+    size_t stack_size;
+    std::vector<Frame> frames;
+    uint64_t call_count = 0;
+
+    [[noreturn]] void fail(const char* what, const Instr* pc) const;
+};
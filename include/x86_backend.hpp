@@ -0,0 +1,43 @@
+#pragma once
+
+#include "emitter.hpp"
+#include "interner.hpp"
+#include "ir.hpp"
+
+#include <span>
+#include <string>
+
+// Writes an IR module as x86-64 System V assembly in GNU as syntax, with
+// registers assigned by allocate_registers(). The result assembles and
+// links with the system compiler:
+//
+//     main --emit=asm prog.txt > prog.s && cc prog.s -o prog
+//
+// Values are 64-bit integers with the same meaning as in the bytecode VM.
+// Functions are emitted as `fn.<name>`, which no C symbol can collide with,
+// and a C `main` calls `fn.main` with every parameter 0 and prints what it
+// returns, so a native run prints what `--run` does. Division by zero
+// prints the VM's message and exits with status 1.
+//
+// There is no stack guard: recursion too deep for the native stack dies
+// with SIGSEGV where the VM reports "runtime error: stack overflow".
+// tests/native.sh checks the rest of this against `--run`.
+//
+// Throws CompileError if there is no `main`.
+void write_x86(const IrModule& module, const Interner& interner, Emitter& out);
+
+// The assembly of one function, generated apart from the others so that
+// functions can be generated in parallel.
+struct X86Function {
+    std::string text;   // the function, for .text
+    std::string rodata; // the messages it refers to, for .rodata
+};
+
+// Generates function `index`. Reads only the names of the other functions.
+X86Function write_x86_function(const IrModule& module, const Interner& interner, uint32_t index);
+
+// Writes the program around already generated `functions`, one per function
+// of `module` and in the same order. Throws CompileError if there is no
+// `main`.
+void write_x86(const IrModule& module, const Interner& interner, std::span<const X86Function> functions,
+               Emitter& out);
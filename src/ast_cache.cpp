@@ -0,0 +1,362 @@
+#include "ast_cache.hpp"
+#include "hash.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char magic[8] = {'A', 'S', 'T', 'C', 'A', 'C', 'H', 'E'};
+
+// Numbers the temporary files of this process, so that threads writing the
+// same cache never share one.
+std::atomic<uint32_t> temp_count{0};
+
+enum Section : int {
+    Kinds = 0,
+    Ops,
+    Lhs,
+    Rhs,
+    Extra,
+    Functions,
+    StringOffsets,
+    StringData,
+    SectionCount,
+};
+
+size_t align8(size_t n) {
+    return (n + 7) & ~size_t(7);
+}
+
+int64_t mtime_ns(const struct stat& st) {
+    return int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+}
+
+// What may sit at each child position, so that a node is only ever read
+// as the kind of thing it is.
+enum class Sort {
+    Expr,
+    Stmt,
+    Scope,
+    Else, // Scope or If
+    Type,
+};
+
+bool is(NodeKind kind, Sort sort) {
+    switch (sort) {
+    case Sort::Expr:
+        return kind <= NodeKind::Call;
+    case Sort::Stmt:
+        return kind >= NodeKind::Let && kind <= NodeKind::If;
+    case Sort::Scope:
+        return kind == NodeKind::Scope;
+    case Sort::Else:
+        return kind == NodeKind::Scope || kind == NodeKind::If;
+    case Sort::Type:
+        return kind == NodeKind::Type;
+    }
+    return false;
+}
+
+// Checks the tree the way its readers rely on it. Children are always
+// added before their parents, so requiring child < parent also rules out
+// cycles.
+bool valid_tree(const FlatView& ast, uint32_t symbols) {
+    auto child = [&](uint32_t c, NodeIndex parent, Sort sort) {
+        return c < parent && is(ast.kinds[c], sort);
+    };
+    auto list = [&](uint32_t at, NodeIndex parent, Sort sort) {
+        if (at >= ast.extra_count || ast.extra[at] > ast.extra_count - at - 1)
+            return false;
+        for (uint32_t c : ast.list(at)) {
+            if (!child(c, parent, sort))
+                return false;
+        }
+        return true;
+    };
+    auto pair = [&](uint32_t at) { return at < ast.extra_count && ast.extra_count - at >= 2; };
+    auto op   = [&](NodeIndex n) { return ast.ops[n] < static_cast<uint8_t>(TokenType::Unknown); };
+
+    if (ast.extra_count == 0 || ast.extra[0] != 0)
+        return false;
+
+    for (NodeIndex n = 0; n < ast.node_count; n++) {
+        uint32_t lhs = ast.lhs[n];
+        uint32_t rhs = ast.rhs[n];
+
+        bool ok = false;
+        switch (ast.kinds[n]) {
+        case NodeKind::Identifier:
+        case NodeKind::Literal:
+            ok = lhs < symbols;
+            break;
+        case NodeKind::Binary:
+            ok = op(n) && child(lhs, n, Sort::Expr) && child(rhs, n, Sort::Expr);
+            break;
+        case NodeKind::Unary:
+            ok = op(n) && child(lhs, n, Sort::Expr);
+            break;
+        case NodeKind::Paren:
+        case NodeKind::Return:
+        case NodeKind::Expr:
+            ok = child(lhs, n, Sort::Expr);
+            break;
+        case NodeKind::Call:
+            ok = child(lhs, n, Sort::Expr) && list(rhs, n, Sort::Expr);
+            break;
+        case NodeKind::Let:
+            ok = lhs < symbols && pair(rhs) && child(ast.extra[rhs], n, Sort::Type) &&
+                 child(ast.extra[rhs + 1], n, Sort::Expr);
+            break;
+        case NodeKind::Scope:
+            ok = list(rhs, n, Sort::Stmt);
+            break;
+        case NodeKind::If:
+            ok = child(lhs, n, Sort::Expr) && pair(rhs) && child(ast.extra[rhs], n, Sort::Scope) &&
+                 (ast.extra[rhs + 1] == NoNode || child(ast.extra[rhs + 1], n, Sort::Else));
+            break;
+        case NodeKind::Type:
+            ok = lhs < symbols && list(rhs, n, Sort::Type);
+            break;
+        }
+        if (!ok)
+            return false;
+    }
+
+    for (const FlatFunction& fn : ast.funcs()) {
+        uint32_t at = fn.params;
+        if (fn.name >= symbols || at >= ast.extra_count || ast.extra[at] > ast.extra_count - at - 1 ||
+            ast.extra[at] % 2 != 0)
+            return false;
+
+        std::span<const uint32_t> params = ast.list(at);
+        for (size_t i = 0; i < params.size(); i += 2) {
+            if (params[i] >= symbols || !child(params[i + 1], ast.node_count, Sort::Type))
+                return false;
+        }
+
+        if (!child(fn.return_type, ast.node_count, Sort::Type) || !child(fn.body, ast.node_count, Sort::Scope))
+            return false;
+    }
+
+    return true;
+}
+
+bool write_all(int fd, const void* data, size_t len) {
+    const char* p = static_cast<const char*>(data);
+    while (len) {
+        ssize_t n = ::write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+} // namespace
+
+struct AstCache::Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t string_count;
+
+    uint64_t source_size;
+    int64_t source_mtime;
+    uint64_t source_hash;
+    uint64_t body_hash; // hash_bytes of the rest of the file
+
+    uint32_t node_count;
+    uint32_t extra_count;
+    uint32_t function_count;
+    uint32_t reserved;
+
+    uint64_t offsets[SectionCount];
+    uint64_t sizes[SectionCount];
+};
+
+std::string AstCache::path_for(const char* source_path) {
+    return std::string(source_path) + ".astc";
+}
+
+bool AstCache::write(const char* cache_path, const Source& source, const FlatView& ast, const Interner& names) {
+    struct stat st;
+    if (stat(source.path(), &st) != 0)
+        return false;
+
+    std::vector<uint32_t> string_offsets;
+    std::string string_data;
+    string_offsets.reserve(names.size() + 1);
+    for (Symbol s = 0; s < names.size(); s++) {
+        string_offsets.push_back(static_cast<uint32_t>(string_data.size()));
+        string_data += names.view(s);
+    }
+    string_offsets.push_back(static_cast<uint32_t>(string_data.size()));
+
+    const void* sections[SectionCount] = {
+        ast.kinds, ast.ops, ast.lhs, ast.rhs, ast.extra, ast.functions, string_offsets.data(), string_data.data(),
+    };
+
+    Header header{};
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.version        = version;
+    header.string_count   = static_cast<uint32_t>(names.size());
+    header.source_size    = source.size();
+    header.source_mtime   = mtime_ns(st);
+    header.source_hash    = hash_bytes(source.begin(), source.size());
+    header.node_count     = ast.node_count;
+    header.extra_count    = ast.extra_count;
+    header.function_count = ast.function_count;
+
+    header.sizes[Kinds]         = ast.node_count * sizeof(NodeKind);
+    header.sizes[Ops]           = ast.node_count * sizeof(uint8_t);
+    header.sizes[Lhs]           = ast.node_count * sizeof(uint32_t);
+    header.sizes[Rhs]           = ast.node_count * sizeof(uint32_t);
+    header.sizes[Extra]         = ast.extra_count * sizeof(uint32_t);
+    header.sizes[Functions]     = ast.function_count * sizeof(FlatFunction);
+    header.sizes[StringOffsets] = string_offsets.size() * sizeof(uint32_t);
+    header.sizes[StringData]    = string_data.size();
+
+    uint64_t offset = align8(sizeof(Header));
+    for (int i = 0; i < SectionCount; i++) {
+        header.offsets[i] = offset;
+        offset            = align8(offset + header.sizes[i]);
+    }
+
+    // Laid out in memory first, since the header carries its hash.
+    std::string body(offset - header.offsets[0], '\0');
+    for (int i = 0; i < SectionCount; i++) {
+        if (header.sizes[i])
+            std::memcpy(body.data() + (header.offsets[i] - header.offsets[0]), sections[i], header.sizes[i]);
+    }
+    uint64_t body_end = header.offsets[SectionCount - 1] + header.sizes[SectionCount - 1];
+    header.body_hash  = hash_bytes(body.data(), body_end - header.offsets[0]);
+
+    std::string tmp = std::string(cache_path) + ".tmp." + std::to_string(getpid()) + '.' +
+                      std::to_string(temp_count.fetch_add(1, std::memory_order_relaxed));
+    int fd          = open(tmp.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return false;
+
+    static const char zeros[8] = {};
+    bool ok = write_all(fd, &header, sizeof(Header)) && write_all(fd, zeros, header.offsets[0] - sizeof(Header)) &&
+              write_all(fd, body.data(), body_end - header.offsets[0]);
+
+    ok = close(fd) == 0 && ok;
+    if (!ok || rename(tmp.c_str(), cache_path) != 0) {
+        unlink(tmp.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+AstCache::AstCache(const char* cache_path) {
+    int fd = open(cache_path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return;
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && size_t(st.st_size) >= sizeof(Header)) {
+        void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            data   = static_cast<const char*>(map);
+            length = st.st_size;
+            header = reinterpret_cast<const Header*>(data);
+        }
+    }
+    close(fd);
+
+    if (header && !validate()) {
+        munmap(const_cast<char*>(data), length);
+        data   = nullptr;
+        length = 0;
+        header = nullptr;
+    }
+}
+
+AstCache::~AstCache() {
+    if (data)
+        munmap(const_cast<char*>(data), length);
+}
+
+bool AstCache::validate() const {
+    if (std::memcmp(header->magic, magic, sizeof(magic)) != 0 || header->version != version)
+        return false;
+
+    for (int i = 0; i < SectionCount; i++) {
+        if (header->offsets[i] % 8 != 0 || header->offsets[i] > length ||
+            header->sizes[i] > length - header->offsets[i])
+            return false;
+    }
+
+    bool sized = header->sizes[Kinds] == header->node_count * sizeof(NodeKind) &&
+                 header->sizes[Ops] == header->node_count * sizeof(uint8_t) &&
+                 header->sizes[Lhs] == header->node_count * sizeof(uint32_t) &&
+                 header->sizes[Rhs] == header->node_count * sizeof(uint32_t) &&
+                 header->sizes[Extra] == header->extra_count * sizeof(uint32_t) &&
+                 header->sizes[Functions] == header->function_count * sizeof(FlatFunction) &&
+                 header->sizes[StringOffsets] == (uint64_t(header->string_count) + 1) * sizeof(uint32_t);
+    if (!sized)
+        return false;
+
+    uint64_t body_end = header->offsets[SectionCount - 1] + header->sizes[SectionCount - 1];
+    if (header->offsets[0] > body_end ||
+        hash_bytes(data + header->offsets[0], body_end - header->offsets[0]) != header->body_hash)
+        return false;
+
+    const uint32_t* string_offsets = reinterpret_cast<const uint32_t*>(data + header->offsets[StringOffsets]);
+    for (uint32_t s = 0; s < header->string_count; s++) {
+        if (string_offsets[s] > string_offsets[s + 1])
+            return false;
+    }
+    if (string_offsets[0] != 0 || string_offsets[header->string_count] != header->sizes[StringData])
+        return false;
+
+    return valid_tree(view(), header->string_count);
+}
+
+bool AstCache::fresh_for(const char* source_path) const {
+    struct stat st;
+    if (!ok() || stat(source_path, &st) != 0 || uint64_t(st.st_size) != header->source_size)
+        return false;
+
+    if (mtime_ns(st) == header->source_mtime)
+        return true;
+
+    Source source(source_path);
+    return source.ok() && hash_bytes(source.begin(), source.size()) == header->source_hash;
+}
+
+FlatView AstCache::load(Interner& names) const {
+    const uint32_t* string_offsets = reinterpret_cast<const uint32_t*>(data + header->offsets[StringOffsets]);
+    const char* string_data        = data + header->offsets[StringData];
+
+    for (uint32_t s = 0; s < header->string_count; s++)
+        names.intern(std::string_view(string_data + string_offsets[s], string_offsets[s + 1] - string_offsets[s]));
+
+    return view();
+}
+
+FlatView AstCache::view() const {
+    return FlatView{reinterpret_cast<const NodeKind*>(data + header->offsets[Kinds]),
+                    reinterpret_cast<const uint8_t*>(data + header->offsets[Ops]),
+                    reinterpret_cast<const uint32_t*>(data + header->offsets[Lhs]),
+                    reinterpret_cast<const uint32_t*>(data + header->offsets[Rhs]),
+                    reinterpret_cast<const uint32_t*>(data + header->offsets[Extra]),
+                    reinterpret_cast<const FlatFunction*>(data + header->offsets[Functions]),
+                    header->node_count,
+                    header->extra_count,
+                    header->function_count};
+}
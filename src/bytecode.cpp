@@ -0,0 +1,306 @@
+#include "bytecode.hpp"
+#include "error.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+int64_t Bytecode::find(Symbol name) const noexcept {
+    for (size_t i = 0; i < functions.size(); i++) {
+        if (functions[i].name == name)
+            return static_cast<int64_t>(i);
+    }
+    return -1;
+}
+
+namespace {
+
+constexpr uint32_t max_registers = UINT16_MAX;
+
+// Registers are handed out like a stack: parameters first, then each `let`
+// in order, then temporaries above them, which are released as soon as the
+// expression using them is done. A call's arguments go in the registers at
+// the top, which become the bottom of the callee's frame.
+class FunctionCompiler {
+  public:
+    FunctionCompiler(Bytecode& out, const Interner& names,
+                     const std::unordered_map<const FunctionDecl*, uint32_t>& ids)
+        : out(out), names(names), ids(ids) {}
+
+    void function(const FunctionDecl* fn) {
+        current = fn;
+        locals.clear();
+        top   = 0;
+        frame = 0;
+
+        BytecodeFunction info{fn->name, static_cast<uint32_t>(out.code.size()), 0, 0};
+        for (const Param* p : fn->params)
+            locals.push_back({p, alloc()});
+        info.params = static_cast<uint16_t>(fn->params.size());
+
+        block(fn->body);
+
+        // Falling off the end returns null.
+        uint16_t r = alloc();
+        emit({Op::LoadInt, 0, r});
+        emit({Op::Return, 0, r});
+
+        info.registers = static_cast<uint16_t>(frame);
+        out.functions.push_back(info);
+    }
+
+  private:
+    struct Local {
+        const ASTNode* decl;
+        uint16_t reg;
+    };
+
+    Bytecode& out;
+    const Interner& names;
+    const std::unordered_map<const FunctionDecl*, uint32_t>& ids;
+
+    const FunctionDecl* current = nullptr;
+    std::vector<Local> locals; // in scope, innermost last
+    uint32_t top   = 0;        // first free register
+    uint32_t frame = 0;        // registers used so far
+
+    std::string quoted(Symbol name) const {
+        std::string out = "`";
+        out += names.view(name);
+        out += '`';
+        return out;
+    }
+
+    [[noreturn]] void fail(const std::string& what) const {
+        throw CompileError("error: " + what + " in function " + quoted(current->name));
+    }
+
+    uint16_t alloc() {
+        if (top == max_registers)
+            fail("too many registers");
+        frame = std::max(frame, top + 1);
+        return static_cast<uint16_t>(top++);
+    }
+
+    size_t emit(Instr instr) {
+        out.code.push_back(instr);
+        return out.code.size() - 1;
+    }
+
+    // Points the jump at `at` to the next instruction.
+    void patch(size_t at) {
+        uint32_t target = static_cast<uint32_t>(out.code.size());
+        out.code[at].b  = static_cast<uint16_t>(target);
+        out.code[at].c  = static_cast<uint16_t>(target >> 16);
+    }
+
+    uint16_t local(const ASTNode* decl) const {
+        for (auto it = locals.rbegin(); it != locals.rend(); ++it) {
+            if (it->decl == decl)
+                return it->reg;
+        }
+        throw std::logic_error("bytecode: identifier bound outside its scope");
+    }
+
+    void stmt(const Stmt* s) {
+        uint32_t saved = top;
+
+        switch (s->kind) {
+        case StmtKind::Let: {
+            auto* let  = static_cast<const LetStmt*>(s);
+            uint16_t r = alloc();
+            expr(let->expr, r);
+            locals.push_back({let, r});
+            return; // keeps its register until the end of the scope
+        }
+        case StmtKind::Return:
+            emit({Op::Return, 0, operand(static_cast<const ReturnStmt*>(s)->value)});
+            break;
+        case StmtKind::Expr:
+            expr(static_cast<const ExprStmt*>(s)->expr, alloc());
+            break;
+        case StmtKind::Scope:
+            block(static_cast<const ScopeStmt*>(s));
+            break;
+        case StmtKind::If: {
+            auto* iff        = static_cast<const IfStmt*>(s);
+            size_t skip_then = emit({Op::JumpIfFalse, 0, operand(iff->condition)});
+            top              = saved;
+
+            stmt(iff->then_branch);
+            if (!iff->else_branch) {
+                patch(skip_then);
+                break;
+            }
+
+            size_t skip_else = emit({Op::Jump});
+            patch(skip_then);
+            stmt(iff->else_branch);
+            patch(skip_else);
+            break;
+        }
+        }
+
+        top = saved;
+    }
+
+    void block(const ScopeStmt* s) {
+        size_t scope_locals = locals.size();
+        uint32_t saved      = top;
+
+        for (const Stmt* st : s->statements)
+            stmt(st);
+
+        locals.resize(scope_locals);
+        top = saved;
+    }
+
+    // The register holding `e`: a local's own register, or a temporary that
+    // stays allocated until the caller resets `top`.
+    uint16_t operand(const Expr* e) {
+        if (e->kind == ExprKind::Identifier) {
+            auto* id = static_cast<const IdentifierExpr*>(e);
+            if (id->decl_kind == DeclKind::Let || id->decl_kind == DeclKind::Param)
+                return local(id->decl);
+        }
+
+        uint16_t r = alloc();
+        expr(e, r);
+        return r;
+    }
+
+    // Evaluates `e` into `dst`.
+    void expr(const Expr* e, uint16_t dst) {
+        uint32_t saved = top;
+
+        switch (e->kind) {
+        case ExprKind::Identifier: {
+            auto* id = static_cast<const IdentifierExpr*>(e);
+            switch (id->decl_kind) {
+            case DeclKind::Let:
+            case DeclKind::Param:
+                emit({Op::Move, 0, dst, local(id->decl)});
+                break;
+            case DeclKind::Builtin:
+                emit({Op::LoadInt, 0, dst});
+                break;
+            case DeclKind::Function:
+                fail(quoted(id->name) + " is a function and cannot be used as a value");
+            case DeclKind::Unresolved:
+                throw std::logic_error("bytecode: identifiers must be resolved first");
+            }
+            break;
+        }
+        case ExprKind::Literal:
+            literal(static_cast<const LiteralExpr*>(e)->value, dst);
+            break;
+        case ExprKind::Binary: {
+            auto* bin  = static_cast<const BinaryExpr*>(e);
+            uint16_t l = operand(bin->left);
+            uint16_t r = operand(bin->right);
+            emit({binary_op(bin->op), 0, dst, l, r});
+            break;
+        }
+        case ExprKind::Unary: {
+            auto* unary = static_cast<const UnaryExpr*>(e);
+            uint16_t r  = operand(unary->expr);
+            emit({unary->op == TokenType::Exclamation ? Op::Not : Op::Neg, 0, dst, r});
+            break;
+        }
+        case ExprKind::Paren:
+            expr(static_cast<const ParenExpr*>(e)->expr, dst);
+            break;
+        case ExprKind::Call:
+            call(static_cast<const CallExpr*>(e), dst);
+            break;
+        }
+
+        top = saved;
+    }
+
+    void call(const CallExpr* call, uint16_t dst) {
+        const Expr* callee = call->called;
+        while (callee->kind == ExprKind::Paren)
+            callee = static_cast<const ParenExpr*>(callee)->expr;
+
+        auto* id = static_cast<const IdentifierExpr*>(callee);
+        if (id->decl_kind != DeclKind::Function)
+            fail(quoted(id->name) + " is not a function");
+
+        auto* fn = static_cast<const FunctionDecl*>(id->decl);
+        if (call->args.size() != fn->params.size()) {
+            fail(quoted(fn->name) + " takes " + std::to_string(fn->params.size()) + " arguments but is called with " +
+                 std::to_string(call->args.size()));
+        }
+
+        // The result lands in the first argument register, so a call with
+        // no arguments still needs one. A `dst` on top of the stack can be
+        // that register itself, which saves a move.
+        uint16_t base = dst + 1u == top ? dst : alloc();
+        for (size_t i = 0; i < call->args.size(); i++)
+            expr(call->args[i], i ? alloc() : base);
+
+        uint32_t target = ids.at(fn);
+        emit({Op::Call, 0, base, static_cast<uint16_t>(target), static_cast<uint16_t>(target >> 16)});
+        if (dst != base)
+            emit({Op::Move, 0, dst, base});
+    }
+
+    void literal(Symbol value, uint16_t dst) {
+        std::string_view digits = names.view(value);
+
+        int64_t n = 0;
+        if (std::from_chars(digits.data(), digits.data() + digits.size(), n).ec != std::errc())
+            fail(std::string(digits) + " does not fit in a 64-bit integer");
+
+        if (n <= std::numeric_limits<int32_t>::max()) {
+            uint32_t bits = static_cast<uint32_t>(n);
+            emit({Op::LoadInt, 0, dst, static_cast<uint16_t>(bits), static_cast<uint16_t>(bits >> 16)});
+            return;
+        }
+
+        uint32_t index = static_cast<uint32_t>(out.constants.size());
+        out.constants.push_back(n);
+        emit({Op::LoadConst, 0, dst, static_cast<uint16_t>(index), static_cast<uint16_t>(index >> 16)});
+    }
+
+    Op binary_op(TokenType op) const {
+        switch (op) {
+        case TokenType::Plus:
+            return Op::Add;
+        case TokenType::Minus:
+            return Op::Sub;
+        case TokenType::Asterisk:
+            return Op::Mul;
+        case TokenType::Slash:
+            return Op::Div;
+        case TokenType::LessThan:
+            return Op::Less;
+        case TokenType::GreaterThan:
+            return Op::Greater;
+        default:
+            fail(std::string("operator ") + type_to_string(op) + " is not supported");
+        }
+    }
+};
+
+} // namespace
+
+Bytecode compile_bytecode(std::span<FunctionDecl* const> fns, const Interner& interner) {
+    std::unordered_map<const FunctionDecl*, uint32_t> ids;
+    ids.reserve(fns.size());
+    for (size_t i = 0; i < fns.size(); i++)
+        ids.emplace(fns[i], static_cast<uint32_t>(i));
+
+    Bytecode out;
+    out.functions.reserve(fns.size());
+
+    FunctionCompiler compiler(out, interner, ids);
+    for (const FunctionDecl* fn : fns)
+        compiler.function(fn);
+
+    return out;
+}
@@ -0,0 +1,230 @@
+#include "code_cache.hpp"
+#include "emitter.hpp"
+#include "hash.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char magic[8] = {'C', 'O', 'D', 'E', 'C', 'A', 'C', 'H'};
+
+struct EntryHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t key_hi;
+    uint64_t key_lo;
+    uint64_t size;
+    uint64_t checksum; // hash_bytes of the value
+};
+
+int64_t mtime_ns(const struct stat& st) {
+    return int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+}
+
+bool read_all(int fd, void* data, size_t len) {
+    char* p = static_cast<char*>(data);
+    while (len) {
+        ssize_t n = ::read(fd, p, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+// Creates `path` and any missing parents.
+void make_dirs(const std::string& path) {
+    for (size_t i = 1; i <= path.size(); i++) {
+        if (i == path.size() || path[i] == '/')
+            mkdir(path.substr(0, i).c_str(), 0755);
+    }
+}
+
+// Temporary files younger than this may still be being written by another
+// build, so eviction leaves them alone. Older ones were left by a build
+// that died and are evicted like entries.
+constexpr int64_t temp_grace_ns = int64_t(3600) * 1000000000;
+
+// Deletes the least recently used files of a shard until at most `target`
+// bytes remain, and returns what remains.
+uint64_t evict(const std::string& dir, uint64_t target) {
+    struct File {
+        int64_t mtime;
+        uint64_t size;
+        std::string name;
+    };
+
+    DIR* d = opendir(dir.c_str());
+    if (!d)
+        return 0;
+
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    int64_t now_ns = int64_t(now.tv_sec) * 1000000000 + now.tv_nsec;
+
+    std::vector<File> files;
+    uint64_t total = 0;
+    while (dirent* e = readdir(d)) {
+        if (e->d_name[0] == '.' || std::strcmp(e->d_name, "size") == 0)
+            continue;
+
+        struct stat st;
+        if (fstatat(dirfd(d), e->d_name, &st, 0) != 0 || !S_ISREG(st.st_mode))
+            continue;
+        if (std::strstr(e->d_name, ".tmp.") && now_ns - mtime_ns(st) < temp_grace_ns)
+            continue;
+        files.push_back({mtime_ns(st), uint64_t(st.st_size), e->d_name});
+        total += st.st_size;
+    }
+
+    std::sort(files.begin(), files.end(), [](const File& a, const File& b) { return a.mtime < b.mtime; });
+    for (const File& f : files) {
+        if (total <= target)
+            break;
+        if (unlinkat(dirfd(d), f.name.c_str(), 0) == 0)
+            total -= f.size;
+    }
+
+    closedir(d);
+    return total;
+}
+
+} // namespace
+
+CacheKey CacheKey::of(std::string_view bytes) {
+    return {hash_bytes(bytes.data(), bytes.size(), 0x243f6a8885a308d3ull),
+            hash_bytes(bytes.data(), bytes.size(), 0x13198a2e03707344ull)};
+}
+
+std::string CacheKey::hex() const {
+    char buf[33];
+    std::snprintf(buf, sizeof buf, "%016llx%016llx", static_cast<unsigned long long>(hi),
+                  static_cast<unsigned long long>(lo));
+    return buf;
+}
+
+CodeCache::CodeCache(std::string dir, uint64_t limit) : dir(std::move(dir)), limit(limit) {}
+
+CodeCache::~CodeCache() {
+    for (size_t shard = 0; shard < shards; shard++) {
+        if (uint64_t bytes = added[shard].load(std::memory_order_relaxed))
+            account(shard, bytes);
+    }
+}
+
+std::string CodeCache::shard_dir(size_t shard) const {
+    std::string s = dir;
+    s += '/';
+    s += "0123456789abcdef"[shard];
+    return s;
+}
+
+std::string CodeCache::entry_path(const CacheKey& key) const {
+    std::string s = shard_dir(key.hi >> 60);
+    s += '/';
+    s += key.hex();
+    return s;
+}
+
+std::optional<std::string> CodeCache::load(const CacheKey& key) {
+    std::optional<std::string> value;
+
+    int fd = open(entry_path(key).c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        EntryHeader header;
+        if (read_all(fd, &header, sizeof header) && std::memcmp(header.magic, magic, sizeof magic) == 0 &&
+            header.version == version && header.key_hi == key.hi && header.key_lo == key.lo &&
+            header.size <= UINT32_MAX) {
+            std::string data(header.size, '\0');
+            if (read_all(fd, data.data(), data.size()) && hash_bytes(data.data(), data.size()) == header.checksum) {
+                // Touched so that eviction takes the least recently used.
+                futimens(fd, nullptr);
+                value = std::move(data);
+            }
+        }
+        close(fd);
+    }
+
+    (value ? hit_count : miss_count).fetch_add(1, std::memory_order_relaxed);
+    return value;
+}
+
+bool CodeCache::store(const CacheKey& key, std::string_view value) {
+    size_t shard     = key.hi >> 60;
+    std::string path = entry_path(key);
+
+    std::string tmp = path;
+    tmp += ".tmp.";
+    tmp += std::to_string(getpid());
+    tmp += '.';
+    tmp += std::to_string(temp_count.fetch_add(1, std::memory_order_relaxed));
+
+    int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0 && errno == ENOENT) {
+        make_dirs(shard_dir(shard));
+        fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    }
+    if (fd < 0)
+        return false;
+
+    EntryHeader header{};
+    std::memcpy(header.magic, magic, sizeof magic);
+    header.version  = version;
+    header.key_hi   = key.hi;
+    header.key_lo   = key.lo;
+    header.size     = value.size();
+    header.checksum = hash_bytes(value.data(), value.size());
+
+    bool ok = write_all(fd, std::string_view(reinterpret_cast<const char*>(&header), sizeof header)) &&
+              write_all(fd, value);
+    ok = close(fd) == 0 && ok;
+    if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+        unlink(tmp.c_str());
+        return false;
+    }
+
+    added[shard].fetch_add(sizeof header + value.size(), std::memory_order_relaxed);
+    return true;
+}
+
+void CodeCache::account(size_t shard, uint64_t bytes) {
+    std::string dir_path  = shard_dir(shard);
+    std::string size_path = dir_path + "/size";
+
+    int fd = open(size_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return;
+
+    // Closing the descriptor releases the lock.
+    if (flock(fd, LOCK_EX) == 0) {
+        char buf[32]   = {};
+        ssize_t n      = pread(fd, buf, sizeof buf - 1, 0);
+        uint64_t total = (n > 0 ? std::strtoull(buf, nullptr, 10) : 0) + bytes;
+
+        uint64_t shard_limit = limit / shards;
+        if (total > shard_limit)
+            total = evict(dir_path, shard_limit / 5 * 4);
+
+        std::string text = std::to_string(total);
+        text += '\n';
+        if (ftruncate(fd, 0) == 0 && lseek(fd, 0, SEEK_SET) == 0)
+            write_all(fd, text);
+    }
+    close(fd);
+}
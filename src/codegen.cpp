@@ -0,0 +1,427 @@
+#include "codegen.hpp"
+#include "error.hpp"
+#include "ir.hpp"
+#include "ir_passes.hpp"
+#include "x86_backend.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Part of every cache key. Changes whenever the same input would produce
+// different output.
+constexpr std::string_view codegen_version = "codegen 1";
+
+enum Stage : uint64_t {
+    Fetch,
+    Lower,
+    Optimize,
+    Write,
+};
+
+constexpr const char* stage_names[]   = {"fetch", "lower", "optimize", "write"};
+constexpr Stats::Phase stage_phases[] = {Stats::Load, Stats::Codegen, Stats::Optimize, Stats::Emit};
+
+// Task ids pack the function index above the stage.
+uint64_t task(uint32_t fn, Stage stage) {
+    return uint64_t(fn) << 2 | stage;
+}
+
+// Appends the name and parameter count of every function a body refers
+// to, which is all that lowering reads of other functions.
+struct Signatures {
+    const Interner& interner;
+    std::string& out;
+
+    void stmt(const Stmt* s) {
+        switch (s->kind) {
+        case StmtKind::Let:
+            expr(static_cast<const LetStmt*>(s)->expr);
+            break;
+        case StmtKind::Return:
+            expr(static_cast<const ReturnStmt*>(s)->value);
+            break;
+        case StmtKind::Expr:
+            expr(static_cast<const ExprStmt*>(s)->expr);
+            break;
+        case StmtKind::Scope:
+            for (const Stmt* st : static_cast<const ScopeStmt*>(s)->statements)
+                stmt(st);
+            break;
+        case StmtKind::If: {
+            auto* if_stmt = static_cast<const IfStmt*>(s);
+            expr(if_stmt->condition);
+            stmt(if_stmt->then_branch);
+            if (if_stmt->else_branch)
+                stmt(if_stmt->else_branch);
+            break;
+        }
+        }
+    }
+
+    void expr(const Expr* e) {
+        switch (e->kind) {
+        case ExprKind::Identifier: {
+            auto* id = static_cast<const IdentifierExpr*>(e);
+            if (id->decl_kind == DeclKind::Function) {
+                auto* fn = static_cast<const FunctionDecl*>(id->decl);
+                out += '\0';
+                out += interner.view(fn->name);
+                out += '/';
+                out += std::to_string(fn->params.size());
+            }
+            break;
+        }
+        case ExprKind::Literal:
+            break;
+        case ExprKind::Binary:
+            expr(static_cast<const BinaryExpr*>(e)->left);
+            expr(static_cast<const BinaryExpr*>(e)->right);
+            break;
+        case ExprKind::Unary:
+            expr(static_cast<const UnaryExpr*>(e)->expr);
+            break;
+        case ExprKind::Paren:
+            expr(static_cast<const ParenExpr*>(e)->expr);
+            break;
+        case ExprKind::Call: {
+            auto* call = static_cast<const CallExpr*>(e);
+            expr(call->called);
+            for (const Expr* arg : call->args)
+                expr(arg);
+            break;
+        }
+        }
+    }
+};
+
+// The version and options, which start every key.
+std::string key_prefix(const CodegenOptions& options) {
+    std::string key(codegen_version);
+    key += options.format == EmitFormat::Asm ? " asm" : " ir";
+    key += options.optimize ? " opt\n" : "\n";
+    return key;
+}
+
+CacheKey function_key(const FunctionDecl* fn, const Interner& interner, const CodegenOptions& options) {
+    std::string key = key_prefix(options);
+    key += options.source.substr(fn->span.begin, fn->span.end - fn->span.begin);
+    Signatures{interner, key}.stmt(fn->body);
+    return CacheKey::of(key);
+}
+
+// The manifest is found by path rather than by content, so that an edited
+// file still finds its unchanged functions there.
+CacheKey manifest_key(const CodegenOptions& options) {
+    std::string key = key_prefix(options);
+    key += "manifest ";
+    key += options.path;
+    return CacheKey::of(key);
+}
+
+// A manifest is 64-bit words and byte strings, each string preceded by its
+// length:
+//
+//     source key (2 words), output, function count,
+//     then per function: key (2 words), output
+//
+// sorted by function key. The views point into the cache entry it was read
+// from.
+struct Manifest {
+    CacheKey source;
+    std::string_view output;
+    std::vector<std::pair<CacheKey, std::string_view>> functions;
+
+    std::optional<std::string_view> find(const CacheKey& key) const {
+        auto it = std::lower_bound(functions.begin(), functions.end(), key,
+                                   [](const auto& entry, const CacheKey& k) { return entry.first < k; });
+        if (it == functions.end() || it->first != key)
+            return std::nullopt;
+        return it->second;
+    }
+};
+
+void put_word(std::string& out, uint64_t word) {
+    out.append(reinterpret_cast<const char*>(&word), sizeof word);
+}
+
+void put_bytes(std::string& out, std::string_view bytes) {
+    put_word(out, bytes.size());
+    out += bytes;
+}
+
+std::string write_manifest(const Manifest& manifest) {
+    std::string out;
+    put_word(out, manifest.source.hi);
+    put_word(out, manifest.source.lo);
+    put_bytes(out, manifest.output);
+    put_word(out, manifest.functions.size());
+    for (const auto& [key, value] : manifest.functions) {
+        put_word(out, key.hi);
+        put_word(out, key.lo);
+        put_bytes(out, value);
+    }
+    return out;
+}
+
+std::optional<Manifest> read_manifest(std::string_view data) {
+    auto word = [&](uint64_t& w) {
+        if (data.size() < sizeof w)
+            return false;
+        std::memcpy(&w, data.data(), sizeof w);
+        data.remove_prefix(sizeof w);
+        return true;
+    };
+    auto bytes = [&](std::string_view& b) {
+        uint64_t size;
+        if (!word(size) || size > data.size())
+            return false;
+        b = data.substr(0, size);
+        data.remove_prefix(size);
+        return true;
+    };
+
+    Manifest manifest;
+    uint64_t count;
+    if (!word(manifest.source.hi) || !word(manifest.source.lo) || !bytes(manifest.output) || !word(count))
+        return std::nullopt;
+    for (uint64_t i = 0; i < count; i++) {
+        CacheKey key;
+        std::string_view value;
+        if (!word(key.hi) || !word(key.lo) || !bytes(value))
+            return std::nullopt;
+        manifest.functions.emplace_back(key, value);
+    }
+    if (!data.empty() || !std::is_sorted(manifest.functions.begin(), manifest.functions.end(),
+                                         [](const auto& a, const auto& b) { return a.first < b.first; }))
+        return std::nullopt;
+    return manifest;
+}
+
+// Cached assembly is the length of the text, then the text and the
+// read-only data back to back.
+std::string pack(const X86Function& f) {
+    uint64_t size = f.text.size();
+    std::string out(reinterpret_cast<const char*>(&size), sizeof size);
+    out += f.text;
+    out += f.rodata;
+    return out;
+}
+
+std::optional<X86Function> unpack(std::string_view data) {
+    uint64_t size;
+    if (data.size() < sizeof size)
+        return std::nullopt;
+
+    std::memcpy(&size, data.data(), sizeof size);
+    data.remove_prefix(sizeof size);
+    if (size > data.size())
+        return std::nullopt;
+
+    return X86Function{std::string(data.substr(0, size)), std::string(data.substr(size))};
+}
+
+} // namespace
+
+std::optional<std::string> cached_output(const CodegenOptions& options) {
+    if (!options.cache || options.path.empty())
+        return std::nullopt;
+
+    std::optional<std::string> data  = options.cache->load(manifest_key(options));
+    std::optional<Manifest> manifest = data ? read_manifest(*data) : std::nullopt;
+    if (!manifest || manifest->source != CacheKey::of(options.source))
+        return std::nullopt;
+    return std::string(manifest->output);
+}
+
+void generate_code(std::span<FunctionDecl* const> fns, const Interner& interner, const CodegenOptions& options,
+                   TaskScheduler& scheduler, Arena& arena, Emitter& out, Stats* stats, Trace* trace) {
+    auto n           = static_cast<uint32_t>(fns.size());
+    bool assembly    = options.format == EmitFormat::Asm;
+    CodeCache* cache = options.cache;
+    bool manifested  = cache && !options.path.empty();
+
+    IrLowering lowering(fns, interner);
+    IrModule module        = lowering.declare(arena);
+    PassManager passes     = PassManager::standard();
+    unsigned workers       = scheduler.workers();
+    uint64_t steals_before = scheduler.steals();
+
+    // Read before the counts are taken, as it is not a function.
+    std::optional<std::string> manifest_data;
+    std::optional<Manifest> manifest;
+    if (manifested && (manifest_data = cache->load(manifest_key(options))))
+        manifest = read_manifest(*manifest_data);
+    std::atomic<uint64_t> manifest_hits{0};
+
+    uint64_t hits_before   = cache ? cache->hits() : 0;
+    uint64_t misses_before = cache ? cache->misses() : 0;
+
+    std::vector<std::unique_ptr<Arena>> extra_arenas;
+    std::vector<Arena*> arenas{&arena};
+    for (unsigned w = 1; w < workers; w++) {
+        extra_arenas.push_back(std::make_unique<Arena>());
+        arenas.push_back(extra_arenas.back().get());
+    }
+
+    // Written by whichever worker finishes each function, read once all
+    // are done.
+    std::vector<std::string> ir(assembly ? 0 : n);
+    std::vector<X86Function> x86(assembly ? n : 0);
+    std::vector<CacheKey> keys(cache ? n : 0);
+    std::vector<std::optional<std::string>> errors(n);
+
+    std::vector<Stats> worker_stats(stats ? workers : 0);
+    std::vector<std::vector<PassReport>> reports(workers);
+
+    std::vector<uint32_t> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        return fns[a]->span.end - fns[a]->span.begin < fns[b]->span.end - fns[b]->span.begin;
+    });
+
+    std::vector<uint64_t> tasks;
+    tasks.reserve(n);
+    for (uint32_t i : order)
+        tasks.push_back(task(i, cache ? Fetch : Lower));
+
+    scheduler.run(tasks, [&](uint64_t t, unsigned worker) {
+        auto fn    = static_cast<uint32_t>(t >> 2);
+        auto stage = static_cast<Stage>(t & 3);
+        Stats* ws  = stats ? &worker_stats[worker] : nullptr;
+
+        Trace::Clock::time_point start;
+        if (ws || trace)
+            start = Trace::Clock::now();
+        if (ws)
+            ws->tasks++;
+
+        try {
+            IrFunction& f = module.functions[fn];
+            switch (stage) {
+            case Fetch: {
+                keys[fn] = function_key(fns[fn], interner, options);
+
+                std::optional<std::string> value;
+                std::optional<std::string_view> kept = manifest ? manifest->find(keys[fn]) : std::nullopt;
+                if (kept) {
+                    value = std::string(*kept);
+                    manifest_hits.fetch_add(1, std::memory_order_relaxed);
+                }
+                else
+                    value = cache->load(keys[fn]);
+                std::optional<X86Function> code = value && assembly ? unpack(*value) : std::nullopt;
+
+                if (value && !assembly)
+                    ir[fn] = std::move(*value);
+                else if (code)
+                    x86[fn] = std::move(*code);
+                else
+                    scheduler.spawn(worker, task(fn, Lower));
+                break;
+            }
+            case Lower:
+                lowering.lower(module, fn, *arenas[worker]);
+                if (ws)
+                    ws->ir_lowered += f.instruction_count();
+                scheduler.spawn(worker, task(fn, options.optimize ? Optimize : Write));
+                break;
+            case Optimize:
+                // Passes grow the function's vectors, and this task may have
+                // been stolen from the worker whose arena they live in.
+                f.rehome(*arenas[worker]);
+                passes.run(f, reports[worker]);
+                scheduler.spawn(worker, task(fn, Write));
+                break;
+            case Write:
+                if (assembly) {
+                    x86[fn] = write_x86_function(module, interner, fn);
+                    if (cache)
+                        cache->store(keys[fn], pack(x86[fn]));
+                }
+                else {
+                    Emitter text(interner);
+                    write_ir_function(module, interner, fn, text);
+                    ir[fn] = text.take();
+                    if (cache)
+                        cache->store(keys[fn], ir[fn]);
+                }
+                break;
+            }
+        } catch (const CompileError& e) {
+            errors[fn] = e.what();
+        }
+
+        if (ws)
+            ws->seconds[stage_phases[stage]] += std::chrono::duration<double>(Trace::Clock::now() - start).count();
+        if (trace)
+            trace->complete(interner.view(fns[fn]->name), stage_names[stage], start);
+    });
+
+    if (stats) {
+        for (unsigned w = 0; w < workers; w++) {
+            stats->merge(worker_stats[w]);
+            stats->add_passes(reports[w]);
+        }
+        stats->steals += scheduler.steals() - steals_before;
+        if (cache) {
+            stats->cache_hits += cache->hits() - hits_before + manifest_hits.load();
+            stats->cache_misses += cache->misses() - misses_before;
+        }
+    }
+
+    for (const std::optional<std::string>& error : errors) {
+        if (error)
+            throw CompileError(*error);
+    }
+
+    PhaseTimer emit(stats, trace, Stats::Emit, "emit");
+    if (!manifested) {
+        if (assembly)
+            write_x86(module, interner, x86, out);
+        else {
+            for (const std::string& text : ir)
+                out.put(text);
+        }
+        return;
+    }
+
+    Emitter program(interner);
+    if (assembly)
+        write_x86(module, interner, x86, program);
+    else {
+        for (const std::string& text : ir)
+            program.put(text);
+    }
+    std::string text = program.take();
+
+    CacheKey source = CacheKey::of(options.source);
+    if (!manifest || manifest->source != source) {
+        std::vector<std::string> values;
+        if (assembly) {
+            values.reserve(n);
+            for (const X86Function& f : x86)
+                values.push_back(pack(f));
+        }
+        const std::vector<std::string>& outputs = assembly ? values : ir;
+
+        Manifest updated{source, text, {}};
+        updated.functions.reserve(n);
+        for (uint32_t i = 0; i < n; i++)
+            updated.functions.emplace_back(keys[i], outputs[i]);
+        std::sort(updated.functions.begin(), updated.functions.end(),
+                  [](const auto& a, const auto& b) { return a.first < b.first; });
+        updated.functions.erase(std::unique(updated.functions.begin(), updated.functions.end(),
+                                            [](const auto& a, const auto& b) { return a.first == b.first; }),
+                                updated.functions.end());
+        cache->store(manifest_key(options), write_manifest(updated));
+    }
+    out.put(text);
+}
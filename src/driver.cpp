@@ -0,0 +1,362 @@
+#include "driver.hpp"
+#include "ast_cache.hpp"
+#include "bytecode.hpp"
+#include "code_cache.hpp"
+#include "codegen.hpp"
+#include "emitter.hpp"
+#include "error.hpp"
+#include "flat_ast.hpp"
+#include "interner.hpp"
+#include "lexer.hpp"
+#include "parallel_parse.hpp"
+#include "parser.hpp"
+#include "pipelined_lexer.hpp"
+#include "resolver.hpp"
+#include "source.hpp"
+#include "task_scheduler.hpp"
+#include "token_array.hpp"
+#include "vm.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <thread>
+
+#include <unistd.h>
+
+// Files smaller than this are not worth splitting across threads.
+static constexpr size_t split_threshold = 256 * 1024;
+
+// Code generation costs more per byte than parsing, so it is worth threads
+// on smaller files.
+static constexpr size_t codegen_threshold = 32 * 1024;
+
+namespace {
+
+void run_main(std::span<FunctionDecl* const> fns, Interner& interner, Emitter& out, Stats* stats, Trace* trace) {
+    PhaseTimer codegen(stats, trace, Stats::Codegen, "codegen");
+    Bytecode code = compile_bytecode(fns, interner);
+    codegen.stop();
+
+    int64_t main = code.find(interner.intern("main"));
+    if (main < 0)
+        throw CompileError("error: no `main` function to run");
+
+    PhaseTimer run(stats, trace, Stats::Run, "run");
+    std::vector<int64_t> args(code.functions[main].params, 0);
+    int64_t value = Vm(code, interner).run(static_cast<uint32_t>(main), args);
+    run.stop();
+
+    out.put(std::to_string(value));
+    out.put('\n');
+}
+
+CompileResult compile(const char* path, const DriverOptions& options, Worker& worker, int out_fd, Trace* trace) {
+    CompileResult result;
+    Stats* stats = options.stats ? &result.stats : nullptr;
+    Interner interner;
+    TypeTable types;
+    Emitter out(interner, options.format, out_fd);
+
+    // Output streamed to `out_fd` that could not be written fails the file.
+    auto finish = [&] {
+        if (!out.flush()) {
+            result.diagnostics += "error writing output\n";
+            result.ok = false;
+        }
+        result.output = out.take();
+    };
+
+    worker.lexer_arena.reset();
+    worker.parser_arena.reset();
+    worker.resolver_arena.reset();
+    worker.ir_arena.reset();
+
+    std::string cache_path = AstCache::path_for(path);
+
+    if (options.cache) {
+        PhaseTimer load(stats, trace, Stats::Load, "load cache");
+        AstCache cached(cache_path.c_str());
+        if (cached.fresh_for(path)) {
+            FlatView ast = cached.load(interner);
+            load.stop();
+
+            if (stats)
+                stats->count_nodes(ast);
+
+            PhaseTimer emit(stats, trace, Stats::Emit, "emit");
+            out.program(ast);
+            finish();
+            return result;
+        }
+    }
+
+    PhaseTimer load(stats, trace, Stats::Load, "load");
+    Source source(path);
+    load.stop();
+
+    if (!source.ok()) {
+        result.diagnostics = source.error() + "\n";
+        result.ok          = false;
+        return result;
+    }
+
+    if (stats)
+        stats->bytes = source.size();
+
+    // With a code cache an unchanged file is not even parsed. Its manifest
+    // is found by absolute path, so that any working directory finds it.
+    std::optional<CodeCache> cache;
+    std::string absolute;
+    if (options.code_cache && !options.run && (options.format == EmitFormat::Ir || options.format == EmitFormat::Asm)) {
+        cache.emplace(options.code_cache, options.code_cache_limit);
+
+        std::error_code error;
+        if (std::string_view(path) != "-")
+            absolute = std::filesystem::absolute(path, error).string();
+    }
+
+    CodegenOptions codegen{
+        .format   = options.format,
+        .optimize = options.optimize,
+        .cache    = cache ? &*cache : nullptr,
+        .source   = source.text(),
+        .path     = absolute,
+    };
+    if (cache) {
+        PhaseTimer load(stats, trace, Stats::Load, "load code cache");
+        if (std::optional<std::string> text = cached_output(codegen)) {
+            load.stop();
+            out.put(*text);
+            finish();
+            return result;
+        }
+    }
+
+    try {
+        // With a token array the lexing cost shows up as its own phase;
+        // otherwise --stats times a separate counting pass.
+        std::optional<TokenArray> tokens;
+        if (options.token_array) {
+            PhaseTimer lex(stats, trace, Stats::Lex, "lex");
+            tokens.emplace(source);
+            lex.stop();
+
+            if (stats)
+                stats->count_tokens(*tokens);
+        }
+        else if (stats) {
+            PhaseTimer lex(stats, trace, Stats::Lex, "lex");
+            stats->count_tokens(source, worker.lexer_arena);
+        }
+
+        // Started after the --stats counting pass, so that pass is timed
+        // on its own.
+        std::optional<PipelinedLexer> stream;
+        if (options.pipeline && !tokens)
+            stream.emplace(source);
+
+        Lexer lexer(source, worker.lexer_arena);
+        Parser parser = tokens   ? Parser(*tokens, worker.parser_arena, interner, types)
+                        : stream ? Parser(*stream, worker.parser_arena, interner, types)
+                                 : Parser(lexer, worker.parser_arena, interner, types);
+        parser.set_trace(trace);
+
+        if (options.flat) {
+            PhaseTimer parse(stats, trace, Stats::Parse, "parse");
+            FlatAst ast = parser.parse_flat();
+            parse.stop();
+
+            if (options.cache && std::string_view(path) != "-" &&
+                !AstCache::write(cache_path.c_str(), source, ast.view(), interner))
+                result.diagnostics += "error writing cache " + cache_path + "\n";
+
+            if (stats)
+                stats->count_nodes(ast.view());
+
+            PhaseTimer emit(stats, trace, Stats::Emit, "emit");
+            out.program(ast.view());
+            out.flush();
+        }
+        else {
+            // Chunk nodes are owned by the ParallelParser, which must outlive
+            // the emitter's use of them.
+            std::optional<ParallelParser> chunks;
+            std::vector<FunctionDecl*> fns;
+
+            PhaseTimer parse(stats, trace, Stats::Parse, "parse");
+            if (!tokens && !stream && options.file_jobs > 1 && source.size() >= split_threshold) {
+                chunks.emplace(source, interner, types, options.file_jobs, trace);
+                fns = chunks->parse();
+            }
+            else {
+                fns = parser.parse();
+            }
+            parse.stop();
+
+            if (options.resolve) {
+                PhaseTimer resolve(stats, trace, Stats::Resolve, "resolve");
+                Resolver(source, worker.resolver_arena, interner).resolve(fns);
+            }
+
+            if (stats) {
+                stats->count_nodes(fns);
+                stats->unique_types = types.size();
+            }
+
+            if (options.run) {
+                run_main(fns, interner, out, stats, trace);
+            }
+            else if (options.format == EmitFormat::Ir || options.format == EmitFormat::Asm) {
+                unsigned jobs = source.size() >= codegen_threshold ? options.file_jobs : 1;
+                TaskScheduler scheduler(std::min<unsigned>(jobs, std::max<size_t>(fns.size(), 1)));
+                generate_code(fns, interner, codegen, scheduler, worker.ir_arena, out, stats, trace);
+            }
+            else {
+                PhaseTimer emit(stats, trace, Stats::Emit, "emit");
+                out.program(fns);
+            }
+            out.flush();
+        }
+    } catch (const CompileError& e) {
+        result.diagnostics += std::string(e.what()) + "\n";
+        result.ok = false;
+    }
+
+    finish();
+    return result;
+}
+
+} // namespace
+
+CompileResult compile_file(const char* path, const DriverOptions& options, Worker& worker, int out_fd, Trace* trace) {
+    Trace::Clock::time_point start;
+    if (trace)
+        start = Trace::Clock::now();
+
+    CompileResult result = compile(path, options, worker, out_fd, trace);
+
+    if (options.stats) {
+        result.stats.files             = 1;
+        result.stats.lexer_arena_peak  = worker.lexer_arena.peak();
+        result.stats.parser_arena_peak = worker.parser_arena.peak();
+    }
+    if (trace)
+        trace->complete(path, "file", start);
+
+    return result;
+}
+
+namespace {
+
+// Fails `result` if its output cannot be written.
+void report(const char* path, CompileResult& result, bool name_files, Stats& totals) {
+    if (!write_all(STDOUT_FILENO, result.output)) {
+        result.diagnostics += "error writing output\n";
+        result.ok = false;
+    }
+    totals.merge(result.stats);
+
+    if (!result.diagnostics.empty()) {
+        if (name_files)
+            std::cerr << path << ":\n";
+        std::cerr << result.diagnostics;
+    }
+}
+
+bool compile_all(const std::vector<const char*>& inputs, const DriverOptions& options, Trace* trace, Stats& totals) {
+    unsigned jobs = options.jobs ? options.jobs : std::max(1u, std::thread::hardware_concurrency());
+    jobs          = std::min<unsigned>(jobs, inputs.size());
+
+    bool name_files = inputs.size() > 1;
+    bool ok         = true;
+
+    if (inputs.size() == 1) {
+        DriverOptions single = options;
+        single.file_jobs     = options.jobs ? options.jobs : std::max(1u, std::thread::hardware_concurrency());
+
+        Worker worker;
+        CompileResult result = compile_file(inputs[0], single, worker, STDOUT_FILENO, trace);
+        report(inputs[0], result, name_files, totals);
+        return result.ok;
+    }
+
+    if (jobs <= 1) {
+        Worker worker;
+        for (const char* path : inputs) {
+            CompileResult result = compile_file(path, options, worker, -1, trace);
+            report(path, result, name_files, totals);
+            ok = ok && result.ok;
+        }
+        return ok;
+    }
+
+    // Workers claim inputs through a shared counter. The main thread prints
+    // each result as soon as it and everything before it are done, so output
+    // order never depends on scheduling.
+    std::vector<CompileResult> results(inputs.size());
+    std::unique_ptr<bool[]> done(new bool[inputs.size()]());
+    std::atomic<size_t> next{0};
+    std::mutex mutex;
+    std::condition_variable finished;
+
+    std::vector<std::thread> threads;
+    threads.reserve(jobs);
+    for (unsigned t = 0; t < jobs; t++) {
+        threads.emplace_back([&] {
+            Worker worker;
+            for (size_t i = next++; i < inputs.size(); i = next++) {
+                CompileResult result = compile_file(inputs[i], options, worker, -1, trace);
+
+                std::lock_guard lock(mutex);
+                results[i] = std::move(result);
+                done[i]    = true;
+                finished.notify_one();
+            }
+        });
+    }
+
+    for (size_t i = 0; i < inputs.size(); i++) {
+        CompileResult result;
+        {
+            std::unique_lock lock(mutex);
+            finished.wait(lock, [&] { return done[i]; });
+            result = std::move(results[i]);
+        }
+
+        report(inputs[i], result, name_files, totals);
+        ok = ok && result.ok;
+    }
+
+    for (auto& thread : threads)
+        thread.join();
+
+    return ok;
+}
+
+} // namespace
+
+int run_driver(const std::vector<const char*>& inputs, const DriverOptions& options) {
+    std::unique_ptr<Trace> trace;
+    if (options.trace_path)
+        trace = std::make_unique<Trace>();
+
+    Stats totals;
+    bool ok = compile_all(inputs, options, trace.get(), totals);
+
+    if (options.stats)
+        totals.print(std::cerr);
+
+    if (trace && !trace->write(options.trace_path)) {
+        std::cerr << "error writing trace " << options.trace_path << std::endl;
+        ok = false;
+    }
+
+    return ok ? 0 : -1;
+}
@@ -0,0 +1,703 @@
+#include "emitter.hpp"
+
+#include <cerrno>
+#include <stdexcept>
+
+#include <unistd.h>
+
+namespace {
+
+// The writers below are shared by both AST representations: each adapter
+// exposes the same accessors over its own node handles.
+
+struct PointerTree {
+    using Func    = FunctionDecl*;
+    using ExprRef = const Expr*;
+    using StmtRef = const Stmt*;
+    using TypeRef = const TypeNode*;
+
+    std::span<FunctionDecl* const> fns;
+
+    std::span<FunctionDecl* const> functions() const { return fns; }
+
+    Symbol fn_name(const Func& f) const { return f->name; }
+    size_t param_count(const Func& f) const { return f->params.size(); }
+    Symbol param_name(const Func& f, size_t i) const { return f->params[i]->name; }
+    TypeRef param_type(const Func& f, size_t i) const { return f->params[i]->type; }
+    TypeRef return_type(const Func& f) const { return f->return_type; }
+    StmtRef body(const Func& f) const { return f->body; }
+
+    ExprKind expr_kind(ExprRef e) const { return e->kind; }
+    StmtKind stmt_kind(StmtRef s) const { return s->kind; }
+
+    Symbol name(ExprRef e) const { return static_cast<const IdentifierExpr*>(e)->name; }
+    Symbol value(ExprRef e) const { return static_cast<const LiteralExpr*>(e)->value; }
+
+    TokenType op(ExprRef e) const {
+        if (e->kind == ExprKind::Unary)
+            return static_cast<const UnaryExpr*>(e)->op;
+        return static_cast<const BinaryExpr*>(e)->op;
+    }
+
+    ExprRef left(ExprRef e) const { return static_cast<const BinaryExpr*>(e)->left; }
+    ExprRef right(ExprRef e) const { return static_cast<const BinaryExpr*>(e)->right; }
+
+    ExprRef operand(ExprRef e) const {
+        if (e->kind == ExprKind::Unary)
+            return static_cast<const UnaryExpr*>(e)->expr;
+        return static_cast<const ParenExpr*>(e)->expr;
+    }
+
+    ExprRef callee(ExprRef e) const { return static_cast<const CallExpr*>(e)->called; }
+    std::span<Expr* const> args(ExprRef e) const { return static_cast<const CallExpr*>(e)->args; }
+
+    Symbol let_name(StmtRef s) const { return static_cast<const LetStmt*>(s)->name; }
+    TypeRef let_type(StmtRef s) const { return static_cast<const LetStmt*>(s)->type; }
+    ExprRef let_value(StmtRef s) const { return static_cast<const LetStmt*>(s)->expr; }
+
+    ExprRef stmt_expr(StmtRef s) const {
+        if (s->kind == StmtKind::Return)
+            return static_cast<const ReturnStmt*>(s)->value;
+        return static_cast<const ExprStmt*>(s)->expr;
+    }
+
+    std::span<Stmt* const> statements(StmtRef s) const { return static_cast<const ScopeStmt*>(s)->statements; }
+
+    ExprRef condition(StmtRef s) const { return static_cast<const IfStmt*>(s)->condition; }
+    StmtRef then_branch(StmtRef s) const { return static_cast<const IfStmt*>(s)->then_branch; }
+    StmtRef else_branch(StmtRef s) const { return static_cast<const IfStmt*>(s)->else_branch; }
+    bool has(StmtRef s) const { return s != nullptr; }
+
+    Symbol type_name(TypeRef t) const { return t->name; }
+    std::span<const TypeNode* const> type_args(TypeRef t) const { return t->types; }
+};
+
+struct FlatTree {
+    using Func    = FlatFunction;
+    using ExprRef = NodeIndex;
+    using StmtRef = NodeIndex;
+    using TypeRef = NodeIndex;
+
+    const FlatView& ast;
+
+    std::span<const FlatFunction> functions() const { return ast.funcs(); }
+
+    // Parameters are stored as (name, type) pairs.
+    Symbol fn_name(const Func& f) const { return f.name; }
+    size_t param_count(const Func& f) const { return ast.list(f.params).size() / 2; }
+    Symbol param_name(const Func& f, size_t i) const { return ast.list(f.params)[2 * i]; }
+    TypeRef param_type(const Func& f, size_t i) const { return ast.list(f.params)[2 * i + 1]; }
+    TypeRef return_type(const Func& f) const { return f.return_type; }
+    StmtRef body(const Func& f) const { return f.body; }
+
+    ExprKind expr_kind(ExprRef e) const {
+        switch (ast.kind(e)) {
+        case NodeKind::Identifier:
+            return ExprKind::Identifier;
+        case NodeKind::Literal:
+            return ExprKind::Literal;
+        case NodeKind::Binary:
+            return ExprKind::Binary;
+        case NodeKind::Unary:
+            return ExprKind::Unary;
+        case NodeKind::Paren:
+            return ExprKind::Paren;
+        default:
+            return ExprKind::Call;
+        }
+    }
+
+    StmtKind stmt_kind(StmtRef s) const {
+        switch (ast.kind(s)) {
+        case NodeKind::Let:
+            return StmtKind::Let;
+        case NodeKind::Return:
+            return StmtKind::Return;
+        case NodeKind::Expr:
+            return StmtKind::Expr;
+        case NodeKind::Scope:
+            return StmtKind::Scope;
+        default:
+            return StmtKind::If;
+        }
+    }
+
+    Symbol name(ExprRef e) const { return ast.lhs[e]; }
+    Symbol value(ExprRef e) const { return ast.lhs[e]; }
+    TokenType op(ExprRef e) const { return ast.op(e); }
+    ExprRef left(ExprRef e) const { return ast.lhs[e]; }
+    ExprRef right(ExprRef e) const { return ast.rhs[e]; }
+    ExprRef operand(ExprRef e) const { return ast.lhs[e]; }
+    ExprRef callee(ExprRef e) const { return ast.lhs[e]; }
+    std::span<const uint32_t> args(ExprRef e) const { return ast.list(ast.rhs[e]); }
+
+    Symbol let_name(StmtRef s) const { return ast.lhs[s]; }
+    TypeRef let_type(StmtRef s) const { return ast.extra[ast.rhs[s]]; }
+    ExprRef let_value(StmtRef s) const { return ast.extra[ast.rhs[s] + 1]; }
+    ExprRef stmt_expr(StmtRef s) const { return ast.lhs[s]; }
+    std::span<const uint32_t> statements(StmtRef s) const { return ast.list(ast.rhs[s]); }
+
+    ExprRef condition(StmtRef s) const { return ast.lhs[s]; }
+    StmtRef then_branch(StmtRef s) const { return ast.extra[ast.rhs[s]]; }
+    StmtRef else_branch(StmtRef s) const { return ast.extra[ast.rhs[s] + 1]; }
+    bool has(StmtRef s) const { return s != NoNode; }
+
+    Symbol type_name(TypeRef t) const { return ast.lhs[t]; }
+    std::span<const uint32_t> type_args(TypeRef t) const { return ast.list(ast.rhs[t]); }
+};
+
+const char* op_symbol(TokenType t) {
+    switch (t) {
+    case TokenType::Plus:
+        return "+";
+    case TokenType::Minus:
+        return "-";
+    case TokenType::Asterisk:
+        return "*";
+    case TokenType::Slash:
+        return "/";
+    case TokenType::LessThan:
+        return "<";
+    case TokenType::GreaterThan:
+        return ">";
+    case TokenType::Exclamation:
+        return "!";
+    default:
+        return type_to_string(t);
+    }
+}
+
+template<typename Tree>
+struct TreeWriter {
+    Emitter& out;
+    const Tree& tree;
+
+    void expr(typename Tree::ExprRef e, const int indent_level) {
+        out.put_indent(indent_level);
+
+        switch (tree.expr_kind(e)) {
+
+        case ExprKind::Identifier:
+            out.put("Identifier (");
+            out.put_symbol(tree.name(e));
+            out.put(")\n");
+            break;
+
+        case ExprKind::Literal:
+            out.put("Literal (");
+            out.put_symbol(tree.value(e));
+            out.put(")\n");
+            break;
+
+        case ExprKind::Unary:
+            out.put("Unary (");
+            out.put(type_to_string(tree.op(e)));
+            out.put(")\n");
+            expr(tree.operand(e), indent_level + 1);
+            break;
+
+        case ExprKind::Binary:
+            out.put("Binary (");
+            out.put(type_to_string(tree.op(e)));
+            out.put(")\n");
+
+            out.put_indent(indent_level);
+            out.put("left:\n");
+            expr(tree.left(e), indent_level + 1);
+
+            out.put_indent(indent_level);
+            out.put("right:\n");
+            expr(tree.right(e), indent_level + 1);
+            break;
+
+        case ExprKind::Call:
+            out.put("Call \n");
+
+            out.put_indent(indent_level + 1);
+            out.put("callee:\n");
+            expr(tree.callee(e), indent_level + 2);
+
+            out.put_indent(indent_level + 1);
+            out.put("args:\n");
+            for (auto arg : tree.args(e))
+                expr(arg, indent_level + 2);
+            break;
+
+        case ExprKind::Paren:
+            out.put("Paren\n");
+            expr(tree.operand(e), indent_level + 1);
+            break;
+        }
+    }
+
+    void stmt(typename Tree::StmtRef s, const int indent_level) {
+        out.put_indent(indent_level);
+
+        switch (tree.stmt_kind(s)) {
+
+        case StmtKind::Let:
+            out.put("Let ");
+            out.put_symbol(tree.let_name(s));
+            out.put(" : ");
+            out.put_symbol(tree.type_name(tree.let_type(s)));
+            out.put('\n');
+            expr(tree.let_value(s), indent_level + 1);
+            break;
+
+        case StmtKind::Return:
+            out.put("Return\n");
+            expr(tree.stmt_expr(s), indent_level + 1);
+            break;
+
+        case StmtKind::Expr:
+            out.put("ExprStmt\n");
+            expr(tree.stmt_expr(s), indent_level + 1);
+            break;
+
+        case StmtKind::Scope:
+            out.put("Scope\n");
+            for (auto st : tree.statements(s))
+                stmt(st, indent_level + 1);
+            break;
+
+        case StmtKind::If:
+            out.put("If\n");
+
+            out.put_indent(indent_level + 1);
+            out.put("condition:\n");
+            expr(tree.condition(s), indent_level + 2);
+
+            out.put_indent(indent_level + 1);
+            out.put("then:\n");
+            stmt(tree.then_branch(s), indent_level + 2);
+
+            if (tree.has(tree.else_branch(s))) {
+                out.put_indent(indent_level + 1);
+                out.put("else:\n");
+                stmt(tree.else_branch(s), indent_level + 2);
+            }
+            break;
+        }
+    }
+
+    void type(typename Tree::TypeRef t, const int indent_level = 0) {
+        out.put_indent(indent_level);
+        out.put_symbol(tree.type_name(t));
+
+        auto args = tree.type_args(t);
+        if (!args.empty()) {
+            out.put('<');
+            for (size_t i = 0; i < args.size(); i++) {
+                type(args[i]);
+                if (i + 1 < args.size())
+                    out.put(", ");
+            }
+            out.put('>');
+        }
+    }
+
+    void function(const typename Tree::Func& fn) {
+        out.put("Function ");
+        out.put_symbol(tree.fn_name(fn));
+        out.put("\n  params:\n");
+
+        for (size_t i = 0; i < tree.param_count(fn); i++) {
+            out.put("    ");
+            out.put_symbol(tree.param_name(fn, i));
+            out.put(" : ");
+            type(tree.param_type(fn, i));
+            out.put('\n');
+        }
+
+        out.put("  return: ");
+        type(tree.return_type(fn), 1);
+        out.put("\n  body:\n");
+        stmt(tree.body(fn), 2);
+        out.put('\n');
+    }
+
+    void begin() {}
+    void end() {}
+};
+
+template<typename Tree>
+struct JsonWriter {
+    Emitter& out;
+    const Tree& tree;
+    bool first = true;
+
+    void string(Symbol s) {
+        out.put('"');
+        out.put_symbol(s);
+        out.put('"');
+    }
+
+    void string(const char* s) {
+        out.put('"');
+        out.put(s);
+        out.put('"');
+    }
+
+    void expr(typename Tree::ExprRef e) {
+        switch (tree.expr_kind(e)) {
+
+        case ExprKind::Identifier:
+            out.put("{\"kind\":\"Identifier\",\"name\":");
+            string(tree.name(e));
+            break;
+
+        case ExprKind::Literal:
+            out.put("{\"kind\":\"Literal\",\"value\":");
+            string(tree.value(e));
+            break;
+
+        case ExprKind::Unary:
+            out.put("{\"kind\":\"Unary\",\"op\":");
+            string(op_symbol(tree.op(e)));
+            out.put(",\"expr\":");
+            expr(tree.operand(e));
+            break;
+
+        case ExprKind::Binary:
+            out.put("{\"kind\":\"Binary\",\"op\":");
+            string(op_symbol(tree.op(e)));
+            out.put(",\"left\":");
+            expr(tree.left(e));
+            out.put(",\"right\":");
+            expr(tree.right(e));
+            break;
+
+        case ExprKind::Call: {
+            out.put("{\"kind\":\"Call\",\"callee\":");
+            expr(tree.callee(e));
+            out.put(",\"args\":[");
+            bool sep = false;
+            for (auto arg : tree.args(e)) {
+                if (sep)
+                    out.put(',');
+                expr(arg);
+                sep = true;
+            }
+            out.put(']');
+            break;
+        }
+
+        case ExprKind::Paren:
+            out.put("{\"kind\":\"Paren\",\"expr\":");
+            expr(tree.operand(e));
+            break;
+        }
+        out.put('}');
+    }
+
+    void stmt(typename Tree::StmtRef s) {
+        switch (tree.stmt_kind(s)) {
+
+        case StmtKind::Let:
+            out.put("{\"kind\":\"Let\",\"name\":");
+            string(tree.let_name(s));
+            out.put(",\"type\":");
+            type(tree.let_type(s));
+            out.put(",\"value\":");
+            expr(tree.let_value(s));
+            break;
+
+        case StmtKind::Return:
+            out.put("{\"kind\":\"Return\",\"value\":");
+            expr(tree.stmt_expr(s));
+            break;
+
+        case StmtKind::Expr:
+            out.put("{\"kind\":\"Expr\",\"expr\":");
+            expr(tree.stmt_expr(s));
+            break;
+
+        case StmtKind::Scope: {
+            out.put("{\"kind\":\"Scope\",\"body\":[");
+            bool sep = false;
+            for (auto st : tree.statements(s)) {
+                if (sep)
+                    out.put(',');
+                stmt(st);
+                sep = true;
+            }
+            out.put(']');
+            break;
+        }
+
+        case StmtKind::If:
+            out.put("{\"kind\":\"If\",\"condition\":");
+            expr(tree.condition(s));
+            out.put(",\"then\":");
+            stmt(tree.then_branch(s));
+            out.put(",\"else\":");
+            if (tree.has(tree.else_branch(s)))
+                stmt(tree.else_branch(s));
+            else
+                out.put("null");
+            break;
+        }
+        out.put('}');
+    }
+
+    void type(typename Tree::TypeRef t) {
+        out.put("{\"name\":");
+        string(tree.type_name(t));
+        out.put(",\"args\":[");
+        bool sep = false;
+        for (auto arg : tree.type_args(t)) {
+            if (sep)
+                out.put(',');
+            type(arg);
+            sep = true;
+        }
+        out.put("]}");
+    }
+
+    void function(const typename Tree::Func& fn) {
+        out.put(first ? "\n" : ",\n");
+        first = false;
+
+        out.put("{\"name\":");
+        string(tree.fn_name(fn));
+        out.put(",\"params\":[");
+        for (size_t i = 0; i < tree.param_count(fn); i++) {
+            if (i)
+                out.put(',');
+            out.put("{\"name\":");
+            string(tree.param_name(fn, i));
+            out.put(",\"type\":");
+            type(tree.param_type(fn, i));
+            out.put('}');
+        }
+        out.put("],\"return\":");
+        type(tree.return_type(fn));
+        out.put(",\"body\":");
+        stmt(tree.body(fn));
+        out.put('}');
+    }
+
+    void begin() { out.put('['); }
+    void end() { out.put("\n]\n"); }
+};
+
+template<typename Tree>
+struct SexprWriter {
+    Emitter& out;
+    const Tree& tree;
+
+    void expr(typename Tree::ExprRef e) {
+        switch (tree.expr_kind(e)) {
+
+        case ExprKind::Identifier:
+            out.put_symbol(tree.name(e));
+            return;
+
+        case ExprKind::Literal:
+            out.put_symbol(tree.value(e));
+            return;
+
+        case ExprKind::Unary:
+            out.put('(');
+            out.put(op_symbol(tree.op(e)));
+            out.put(' ');
+            expr(tree.operand(e));
+            break;
+
+        case ExprKind::Binary:
+            out.put('(');
+            out.put(op_symbol(tree.op(e)));
+            out.put(' ');
+            expr(tree.left(e));
+            out.put(' ');
+            expr(tree.right(e));
+            break;
+
+        case ExprKind::Call:
+            out.put("(call ");
+            expr(tree.callee(e));
+            for (auto arg : tree.args(e)) {
+                out.put(' ');
+                expr(arg);
+            }
+            break;
+
+        case ExprKind::Paren:
+            out.put("(paren ");
+            expr(tree.operand(e));
+            break;
+        }
+        out.put(')');
+    }
+
+    void stmt(typename Tree::StmtRef s) {
+        switch (tree.stmt_kind(s)) {
+
+        case StmtKind::Let:
+            out.put("(let ");
+            out.put_symbol(tree.let_name(s));
+            out.put(' ');
+            type(tree.let_type(s));
+            out.put(' ');
+            expr(tree.let_value(s));
+            break;
+
+        case StmtKind::Return:
+            out.put("(return ");
+            expr(tree.stmt_expr(s));
+            break;
+
+        case StmtKind::Expr:
+            out.put("(expr ");
+            expr(tree.stmt_expr(s));
+            break;
+
+        case StmtKind::Scope:
+            out.put("(scope");
+            for (auto st : tree.statements(s)) {
+                out.put(' ');
+                stmt(st);
+            }
+            break;
+
+        case StmtKind::If:
+            out.put("(if ");
+            expr(tree.condition(s));
+            out.put(' ');
+            stmt(tree.then_branch(s));
+            if (tree.has(tree.else_branch(s))) {
+                out.put(' ');
+                stmt(tree.else_branch(s));
+            }
+            break;
+        }
+        out.put(')');
+    }
+
+    void type(typename Tree::TypeRef t) {
+        auto args = tree.type_args(t);
+        if (args.empty()) {
+            out.put_symbol(tree.type_name(t));
+            return;
+        }
+
+        out.put('(');
+        out.put_symbol(tree.type_name(t));
+        for (auto arg : args) {
+            out.put(' ');
+            type(arg);
+        }
+        out.put(')');
+    }
+
+    void function(const typename Tree::Func& fn) {
+        out.put("(function ");
+        out.put_symbol(tree.fn_name(fn));
+        out.put(" (");
+        for (size_t i = 0; i < tree.param_count(fn); i++) {
+            if (i)
+                out.put(' ');
+            out.put('(');
+            out.put_symbol(tree.param_name(fn, i));
+            out.put(' ');
+            type(tree.param_type(fn, i));
+            out.put(')');
+        }
+        out.put(") ");
+        type(tree.return_type(fn));
+        out.put(' ');
+        stmt(tree.body(fn));
+        out.put(")\n");
+    }
+
+    void begin() {}
+    void end() {}
+};
+
+template<template<typename> class Writer, typename Tree>
+void write_program(Emitter& out, const Tree& tree) {
+    Writer<Tree> writer{out, tree};
+
+    writer.begin();
+    for (const auto& fn : tree.functions())
+        writer.function(fn);
+    writer.end();
+}
+
+template<typename Tree>
+void write_format(Emitter& out, EmitFormat format, const Tree& tree) {
+    switch (format) {
+    case EmitFormat::Tree:
+        write_program<TreeWriter>(out, tree);
+        break;
+    case EmitFormat::Json:
+        write_program<JsonWriter>(out, tree);
+        break;
+    case EmitFormat::Sexpr:
+        write_program<SexprWriter>(out, tree);
+        break;
+    case EmitFormat::Asm:
+    case EmitFormat::Ir:
+        throw std::logic_error("assembly and IR are written by the driver, which owns the IR arena");
+    }
+}
+
+} // namespace
+
+bool write_all(int fd, std::string_view data) {
+    while (!data.empty()) {
+        ssize_t n = ::write(fd, data.data(), data.size());
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        data.remove_prefix(n);
+    }
+    return true;
+}
+
+Emitter::Emitter(const Interner& names, EmitFormat format, int fd) : names(names), format(format), fd(fd) {
+    if (fd >= 0)
+        buffer.reserve(block_size + block_size / 4);
+}
+
+Emitter::~Emitter() {
+    flush();
+}
+
+void Emitter::program(std::span<FunctionDecl* const> fns) {
+    write_format(*this, format, PointerTree{fns});
+}
+
+void Emitter::program(const FlatView& ast) {
+    write_format(*this, format, FlatTree{ast});
+}
+
+bool Emitter::flush() {
+    if (fd < 0)
+        return true;
+
+    if (!write_failed && !write_all(fd, buffer))
+        write_failed = true;
+    buffer.clear();
+    return !write_failed;
+}
+
+std::string Emitter::take() {
+    flush();
+    std::string out = std::move(buffer);
+    buffer.clear();
+    return out;
+}
+
+void Emitter::put_indent(int n) {
+    static constexpr std::string_view spaces = "                                                                ";
+    size_t width                             = size_t(n) * 2;
+
+    while (width > spaces.size()) {
+        put(spaces);
+        width -= spaces.size();
+    }
+    put(spaces.substr(0, width));
+}
@@ -0,0 +1,259 @@
+#include "error.hpp"
+#include "flat_ast.hpp"
+#include "parser.hpp"
+
+#include <string>
+
+// Same grammar as parser.cpp, but each production appends to the FlatAst
+// tables and returns a node index instead of allocating arena nodes.
+
+FlatAst Parser::parse_flat() {
+    FlatAst ast;
+    flat = &ast;
+
+    while (curr.type != TokenType::FileEnd) {
+        if (!trace) {
+            flat_function();
+            continue;
+        }
+
+        auto start = Trace::Clock::now();
+        flat_function();
+        trace->complete(interner.view(ast.view().funcs().back().name), "function", start);
+    }
+
+    flat = nullptr;
+    return ast;
+}
+
+void Parser::flat_function() {
+    FlatFunction fn;
+
+    expect(TokenType::Function);
+    fn.name = expect_symbol(TokenType::Identifier);
+    expect(TokenType::LeftParen);
+
+    fn.params = flat_params();
+    expect(TokenType::RightParen);
+    expect(TokenType::Arrow);
+
+    fn.return_type = flat_type();
+    fn.body        = flat_scope();
+
+    flat->add_function(fn);
+}
+
+uint32_t Parser::flat_params() {
+    size_t params = flat_lists.open();
+
+    auto param = [&] {
+        flat_lists.push(expect_symbol(TokenType::Identifier));
+        expect(TokenType::Colon);
+        flat_lists.push(flat_type());
+    };
+
+    if (curr.type != TokenType::RightParen) {
+        param();
+        while (curr.type == TokenType::Comma) {
+            advance();
+            param();
+        }
+    }
+
+    uint32_t list = flat->add_list(flat_lists.view(params));
+    flat_lists.close(params);
+    return list;
+}
+
+NodeIndex Parser::flat_type() {
+    Symbol name  = expect_symbol(TokenType::Identifier);
+    size_t types = flat_lists.open();
+
+    if (curr.type == TokenType::LessThan) {
+        advance();
+        flat_lists.push(flat_type());
+
+        while (curr.type == TokenType::Comma) {
+            advance();
+            flat_lists.push(flat_type());
+        }
+        expect(TokenType::GreaterThan);
+    }
+
+    uint32_t list = flat->add_list(flat_lists.view(types));
+    flat_lists.close(types);
+    return flat->add(NodeKind::Type, name, list);
+}
+
+NodeIndex Parser::flat_scope() {
+    expect(TokenType::LeftCurly);
+    size_t statements = flat_lists.open();
+    while (curr.type != TokenType::RightCurly) {
+        if (curr.type == TokenType::FileEnd) {
+            throw CompileError("error: expected `}` on " + curr_location());
+        }
+        flat_lists.push(flat_stmt());
+    }
+    expect(TokenType::RightCurly);
+
+    uint32_t list = flat->add_list(flat_lists.view(statements));
+    flat_lists.close(statements);
+    return flat->add(NodeKind::Scope, 0, list);
+}
+
+NodeIndex Parser::flat_let() {
+    expect(TokenType::Let);
+    Symbol name = expect_symbol(TokenType::Identifier);
+    expect(TokenType::Colon);
+    NodeIndex type = flat_type();
+    expect(TokenType::Equal);
+    NodeIndex value = flat_expr();
+    expect(TokenType::SemiColon);
+
+    uint32_t operands[] = {type, value};
+    return flat->add(NodeKind::Let, name, flat->add_extra(operands));
+}
+
+NodeIndex Parser::flat_if() {
+    expect(TokenType::If);
+
+    NodeIndex condition = flat_expr();
+    NodeIndex then      = flat_scope();
+    NodeIndex otherwise = NoNode;
+
+    if (curr.type == TokenType::Else) {
+        advance();
+
+        if (curr.type == TokenType::If) {
+            otherwise = flat_if();
+        }
+        else {
+            otherwise = flat_scope();
+        }
+    }
+
+    uint32_t branches[] = {then, otherwise};
+    return flat->add(NodeKind::If, condition, flat->add_extra(branches));
+}
+
+NodeIndex Parser::flat_return() {
+    expect(TokenType::Return);
+    NodeIndex value = flat_expr();
+    expect(TokenType::SemiColon);
+
+    return flat->add(NodeKind::Return, value);
+}
+
+NodeIndex Parser::flat_expr_stmt() {
+    NodeIndex expr = flat_expr();
+    expect(TokenType::SemiColon);
+
+    return flat->add(NodeKind::Expr, expr);
+}
+
+NodeIndex Parser::flat_stmt() {
+    switch (curr.type) {
+    case TokenType::Let:
+        return flat_let();
+    case TokenType::Return:
+        return flat_return();
+    case TokenType::If:
+        return flat_if();
+
+    default:
+        return flat_expr_stmt();
+    }
+}
+
+NodeIndex Parser::flat_expr() {
+    return flat_precedence(Precedence::ASSIGN);
+}
+
+NodeIndex Parser::flat_precedence(const int min_prec) {
+    NodeIndex left = flat_prefix();
+
+    while (true) {
+        int prec = get_precedence(curr.type);
+        if (prec < min_prec)
+            break;
+
+        Token op = curr;
+        advance();
+
+        left = flat_infix(left, op, prec + 1);
+    }
+
+    return left;
+}
+
+NodeIndex Parser::flat_prefix() {
+    switch (curr.type) {
+    case TokenType::Identifier:
+        return flat->add(NodeKind::Identifier, expect_symbol(TokenType::Identifier));
+
+    case TokenType::Number:
+        return flat->add(NodeKind::Literal, expect_symbol(TokenType::Number));
+
+    case TokenType::LeftParen: {
+        advance();
+        NodeIndex inner = flat_expr();
+        expect(TokenType::RightParen);
+        return flat->add(NodeKind::Paren, inner);
+    }
+
+    case TokenType::Exclamation:
+    case TokenType::Minus: {
+        Token op        = expect(curr.type);
+        NodeIndex right = flat_precedence(Precedence::UNARY);
+        return flat->add(NodeKind::Unary, right, 0, op.type);
+    }
+
+    default:
+        throw CompileError("Unexpected token on " + curr_location() + ": " + type_to_string(curr.type));
+    }
+}
+
+NodeIndex Parser::flat_infix(NodeIndex left, const Token& op, const int prec) {
+    if (op.type == TokenType::LeftParen) {
+        if (!flat_callable(left)) {
+            throw CompileError("cannot call non callable expression");
+        }
+        return flat_call(left);
+    }
+
+    NodeIndex right = flat_precedence(prec);
+    return flat->add(NodeKind::Binary, left, right, op.type);
+}
+
+NodeIndex Parser::flat_call(NodeIndex from) {
+    size_t args = flat_lists.open();
+
+    if (curr.type != TokenType::RightParen) {
+        flat_lists.push(flat_expr());
+        while (curr.type == TokenType::Comma) {
+            advance();
+            flat_lists.push(flat_expr());
+        }
+    }
+    expect(TokenType::RightParen);
+
+    uint32_t list = flat->add_list(flat_lists.view(args));
+    flat_lists.close(args);
+    return flat->add(NodeKind::Call, from, list);
+}
+
+bool Parser::flat_callable(NodeIndex expr) {
+    FlatView ast = flat->view();
+
+    switch (ast.kind(expr)) {
+
+    case NodeKind::Identifier:
+        return true;
+
+    case NodeKind::Paren:
+        return flat_callable(ast.lhs[expr]);
+
+    default:
+        return false;
+    }
+}
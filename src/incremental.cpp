@@ -0,0 +1,96 @@
+#include "incremental.hpp"
+#include "lexer.hpp"
+
+#include <algorithm>
+
+std::vector<FunctionDecl*> IncrementalParser::parse_range(const Source& source, size_t begin, size_t end) {
+    lexer_arena.reset();
+    Lexer lexer(source, begin, end, lexer_arena);
+    Parser parser(lexer, arena, interner, types);
+    return parser.parse();
+}
+
+const std::vector<FunctionDecl*>& IncrementalParser::parse(const Source& source) {
+    arena.reset();
+    fns         = parse_range(source, 0, source.size());
+    source_size = source.size();
+    rebuilt     = fns.size();
+    full_bytes  = arena.used();
+    return fns;
+}
+
+const std::vector<FunctionDecl*>& IncrementalParser::reparse(const Source& source, std::span<const TextEdit> edits) {
+    // Offset in the new text of an old offset that no edit covers.
+    auto shift = [&](uint32_t old_offset) {
+        int64_t delta = 0;
+        for (const TextEdit& e : edits) {
+            if (e.end > old_offset)
+                break;
+            delta += int64_t(e.length) - int64_t(e.end - e.begin);
+        }
+        return static_cast<uint32_t>(old_offset + delta);
+    };
+
+    // An edit touching [begin, end], boundaries included, dirties it.
+    auto touched = [&](uint32_t begin, uint32_t end) {
+        auto it = std::lower_bound(edits.begin(), edits.end(), begin,
+                                   [](const TextEdit& e, uint32_t at) { return e.end < at; });
+        return it != edits.end() && it->begin <= end;
+    };
+
+    // Spans of kept functions are only updated once everything has parsed.
+    std::vector<FunctionDecl*> result;
+    std::vector<SourceSpan> spans;
+    size_t rebuilt_now = 0;
+
+    // Walk the old file as alternating gaps and functions. A dirty run grows
+    // until the next clean function and is then reparsed as a whole.
+    uint32_t run_begin = 0;
+    bool dirty         = false;
+    uint32_t gap_begin = 0;
+
+    auto flush = [&](uint32_t run_end) {
+        if (!dirty)
+            return;
+        std::vector<FunctionDecl*> parsed = parse_range(source, shift(run_begin), shift(run_end));
+        for (FunctionDecl* fn : parsed) {
+            result.push_back(fn);
+            spans.push_back(fn->span);
+        }
+        rebuilt_now += parsed.size();
+        dirty = false;
+    };
+
+    for (FunctionDecl* fn : fns) {
+        if (touched(gap_begin, fn->span.begin) || touched(fn->span.begin, fn->span.end)) {
+            if (!dirty)
+                run_begin = gap_begin;
+            dirty = true;
+        }
+        else {
+            flush(fn->span.begin);
+            result.push_back(fn);
+            spans.push_back({shift(fn->span.begin), shift(fn->span.end)});
+        }
+        gap_begin = fn->span.end;
+    }
+
+    uint32_t old_end = static_cast<uint32_t>(source_size);
+    if (touched(gap_begin, old_end)) {
+        if (!dirty)
+            run_begin = gap_begin;
+        dirty = true;
+    }
+    flush(old_end);
+
+    for (size_t i = 0; i < result.size(); i++)
+        result[i]->span = spans[i];
+
+    fns         = std::move(result);
+    source_size = source.size();
+    rebuilt     = rebuilt_now;
+
+    if (arena.used() > 2 * full_bytes)
+        return parse(source);
+    return fns;
+}
@@ -0,0 +1,48 @@
+#include "interner.hpp"
+
+Interner::Interner() : storage(16 * 1024), slots(1024, Slot{0, NoSymbol}), mask(1024 - 1) {}
+
+uint32_t Interner::hash(std::string_view s) noexcept {
+    uint32_t h = 2166136261u;
+    for (char c : s) {
+        h ^= static_cast<unsigned char>(c);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+Symbol Interner::intern(std::string_view s) {
+    uint32_t h = hash(s);
+    uint32_t i = h & mask;
+
+    while (slots[i].symbol != NoSymbol) {
+        if (slots[i].hash == h && strings[slots[i].symbol] == s)
+            return slots[i].symbol;
+        i = (i + 1) & mask;
+    }
+
+    Symbol sym = static_cast<Symbol>(strings.size());
+    strings.push_back(storage.copy(s.data(), s.size()));
+    slots[i] = Slot{h, sym};
+
+    if (strings.size() * 2 > slots.size())
+        grow();
+
+    return sym;
+}
+
+void Interner::grow() {
+    std::vector<Slot> old = std::move(slots);
+    slots.assign(old.size() * 2, Slot{0, NoSymbol});
+    mask = static_cast<uint32_t>(slots.size() - 1);
+
+    for (const Slot& slot : old) {
+        if (slot.symbol == NoSymbol)
+            continue;
+
+        uint32_t i = slot.hash & mask;
+        while (slots[i].symbol != NoSymbol)
+            i = (i + 1) & mask;
+        slots[i] = slot;
+    }
+}
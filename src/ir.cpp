@@ -0,0 +1,500 @@
+#include "ir.hpp"
+#include "error.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+void IrFunction::successors(BlockId b, BlockId (&out)[2]) const {
+    const IrInst& term = terminator(b);
+    out[0] = out[1] = NoId;
+
+    if (term.op == IrOp::Jump) {
+        out[0] = term.a;
+    }
+    else if (term.op == IrOp::Branch) {
+        out[0] = term.b;
+        out[1] = term.c;
+    }
+}
+
+void IrFunction::compute_preds() {
+    for (IrBlock& block : blocks)
+        block.preds.clear();
+
+    for (BlockId b = 0; b < blocks.size(); b++) {
+        if (!blocks[b].live)
+            continue;
+
+        BlockId succ[2];
+        successors(b, succ);
+        for (BlockId s : succ) {
+            if (s != NoId)
+                blocks[s].preds.push_back(b);
+        }
+    }
+}
+
+void IrFunction::rehome(Arena& arena) {
+    insts.rehome(arena);
+    operands.rehome(arena);
+    blocks.rehome(arena);
+    for (IrBlock& block : blocks) {
+        block.insts.rehome(arena);
+        block.preds.rehome(arena);
+    }
+}
+
+std::vector<BlockId> IrFunction::reverse_postorder() const {
+    std::vector<BlockId> order;
+    std::vector<uint8_t> seen(blocks.size());
+    std::vector<std::pair<BlockId, int>> stack{{0, 0}};
+    seen[0] = 1;
+
+    while (!stack.empty()) {
+        auto& [b, next] = stack.back();
+
+        BlockId succ[2];
+        successors(b, succ);
+        if (next < 2) {
+            BlockId s = succ[next++];
+            if (s != NoId && !seen[s]) {
+                seen[s] = 1;
+                stack.push_back({s, 0});
+            }
+            continue;
+        }
+
+        order.push_back(b);
+        stack.pop_back();
+    }
+
+    std::reverse(order.begin(), order.end());
+    return order;
+}
+
+size_t IrFunction::instruction_count() const {
+    size_t n = 0;
+    for (const IrBlock& block : blocks) {
+        if (block.live)
+            n += block.insts.size();
+    }
+    return n;
+}
+
+namespace {
+
+// Lowers one function at a time. Statements after a `return` still get
+// lowered, into a block with no predecessors that CFG simplification
+// deletes.
+class Lowerer {
+  public:
+    Lowerer(const Interner& names, Arena& arena, const std::unordered_map<const FunctionDecl*, uint32_t>& ids)
+        : names(names), arena(arena), ids(ids) {}
+
+    // Fills in the body of `out`, leaving its name and parameter count.
+    void function(const FunctionDecl* fn, IrFunction& out) {
+        out.insts    = ArenaVector<IrInst>(arena);
+        out.operands = ArenaVector<uint32_t>(arena);
+        out.blocks   = ArenaVector<IrBlock>(arena);
+
+        f       = &out;
+        current = fn;
+        locals.clear();
+        returns.clear();
+        exits.clear();
+
+        block = new_block();
+        open  = true;
+        for (uint32_t i = 0; i < fn->params.size(); i++)
+            locals.push_back({fn->params[i], emit({.op = IrOp::Param, .type = IrType::I64, .a = i})});
+
+        scope(fn->body);
+
+        // Falling off the end returns null.
+        if (open)
+            ret(constant(0));
+
+        BlockId exit = new_block();
+        for (ValueId jump : exits)
+            out.insts[jump].a = exit;
+
+        block = exit;
+        open  = true;
+        IrInst phi{.op = IrOp::Phi, .type = IrType::I64, .count = static_cast<uint32_t>(returns.size())};
+        phi.args = static_cast<uint32_t>(out.operands.size());
+        for (auto [from, value] : returns) {
+            out.operands.push_back(from);
+            out.operands.push_back(value);
+        }
+        emit({.op = IrOp::Ret, .a = emit(phi)});
+    }
+
+  private:
+    struct Local {
+        const ASTNode* decl;
+        ValueId value;
+    };
+
+    const Interner& names;
+    Arena& arena;
+    const std::unordered_map<const FunctionDecl*, uint32_t>& ids;
+
+    IrFunction* f               = nullptr;
+    const FunctionDecl* current = nullptr;
+    BlockId block               = 0;
+    bool open                   = false; // `block` has no terminator yet
+
+    std::vector<Local> locals; // in scope, innermost last
+    std::vector<std::pair<BlockId, ValueId>> returns;
+    std::vector<ValueId> exits; // jumps to the exit block, which comes last
+
+    std::string quoted(Symbol name) const {
+        std::string s = "`";
+        s += names.view(name);
+        s += '`';
+        return s;
+    }
+
+    [[noreturn]] void fail(const std::string& what) const {
+        throw CompileError("error: " + what + " in function " + quoted(current->name));
+    }
+
+    BlockId new_block() {
+        f->blocks.push_back(IrBlock{ArenaVector<ValueId>(arena), ArenaVector<BlockId>(arena)});
+        return static_cast<BlockId>(f->blocks.size() - 1);
+    }
+
+    ValueId emit(IrInst inst) {
+        if (!open) {
+            block = new_block();
+            open  = true;
+        }
+
+        auto id = static_cast<ValueId>(f->insts.size());
+        f->insts.push_back(inst);
+        f->blocks[block].insts.push_back(id);
+
+        if (inst.op == IrOp::Jump || inst.op == IrOp::Branch || inst.op == IrOp::Ret)
+            open = false;
+        return id;
+    }
+
+    ValueId constant(int64_t n) { return emit({.op = IrOp::Const, .type = IrType::I64, .imm = n}); }
+
+    IrType type(ValueId v) const { return f->insts[v].type; }
+
+    ValueId as_i64(ValueId v) {
+        if (type(v) == IrType::I1)
+            return emit({.op = IrOp::ZExt, .type = IrType::I64, .a = v});
+        return v;
+    }
+
+    ValueId as_i1(ValueId v) {
+        if (type(v) == IrType::I64)
+            return emit({.op = IrOp::Nez, .type = IrType::I1, .a = v});
+        return v;
+    }
+
+    void jump(BlockId to) { emit({.op = IrOp::Jump, .a = to}); }
+
+    // The jump goes first: after a terminator it opens the block that the
+    // value is returned from.
+    void ret(ValueId value) {
+        exits.push_back(emit({.op = IrOp::Jump}));
+        returns.push_back({block, value});
+    }
+
+    ValueId local(const ASTNode* decl) const {
+        for (auto it = locals.rbegin(); it != locals.rend(); ++it) {
+            if (it->decl == decl)
+                return it->value;
+        }
+        throw std::logic_error("ir: identifier bound outside its scope");
+    }
+
+    void stmt(const Stmt* s) {
+        switch (s->kind) {
+        case StmtKind::Let: {
+            auto* let = static_cast<const LetStmt*>(s);
+            locals.push_back({let, as_i64(expr(let->expr))});
+            break;
+        }
+        case StmtKind::Return:
+            ret(as_i64(expr(static_cast<const ReturnStmt*>(s)->value)));
+            break;
+        case StmtKind::Expr:
+            expr(static_cast<const ExprStmt*>(s)->expr);
+            break;
+        case StmtKind::Scope:
+            scope(static_cast<const ScopeStmt*>(s));
+            break;
+        case StmtKind::If: {
+            auto* iff       = static_cast<const IfStmt*>(s);
+            ValueId cond    = as_i1(expr(iff->condition));
+            BlockId then_to = new_block();
+            BlockId else_to = iff->else_branch ? new_block() : NoId;
+            BlockId join    = new_block();
+            emit({.op = IrOp::Branch, .a = cond, .b = then_to, .c = iff->else_branch ? else_to : join});
+
+            branch(then_to, iff->then_branch, join);
+            if (iff->else_branch)
+                branch(else_to, iff->else_branch, join);
+
+            block = join;
+            open  = true;
+            break;
+        }
+        }
+    }
+
+    // Lowers `body` starting in block `at`, then continues to `join`.
+    void branch(BlockId at, const Stmt* body, BlockId join) {
+        block = at;
+        open  = true;
+        stmt(body);
+        if (open)
+            jump(join);
+    }
+
+    void scope(const ScopeStmt* s) {
+        size_t scope_locals = locals.size();
+        for (const Stmt* st : s->statements)
+            stmt(st);
+        locals.resize(scope_locals);
+    }
+
+    ValueId expr(const Expr* e) {
+        switch (e->kind) {
+        case ExprKind::Identifier: {
+            auto* id = static_cast<const IdentifierExpr*>(e);
+            switch (id->decl_kind) {
+            case DeclKind::Let:
+            case DeclKind::Param:
+                return local(id->decl);
+            case DeclKind::Builtin:
+                return constant(0);
+            case DeclKind::Function:
+                fail(quoted(id->name) + " is a function and cannot be used as a value");
+            case DeclKind::Unresolved:
+                break;
+            }
+            throw std::logic_error("ir: identifiers must be resolved first");
+        }
+        case ExprKind::Literal: {
+            std::string_view digits = names.view(static_cast<const LiteralExpr*>(e)->value);
+
+            int64_t n = 0;
+            if (std::from_chars(digits.data(), digits.data() + digits.size(), n).ec != std::errc())
+                fail(std::string(digits) + " does not fit in a 64-bit integer");
+            return constant(n);
+        }
+        case ExprKind::Binary: {
+            auto* bin = static_cast<const BinaryExpr*>(e);
+            ValueId l = as_i64(expr(bin->left));
+            ValueId r = as_i64(expr(bin->right));
+            return binary(bin->op, l, r);
+        }
+        case ExprKind::Unary: {
+            auto* unary = static_cast<const UnaryExpr*>(e);
+            ValueId v   = expr(unary->expr);
+            if (unary->op == TokenType::Exclamation)
+                return emit({.op = IrOp::Eqz, .type = IrType::I1, .a = v});
+            return emit({.op = IrOp::Neg, .type = IrType::I64, .a = as_i64(v)});
+        }
+        case ExprKind::Paren:
+            return expr(static_cast<const ParenExpr*>(e)->expr);
+        case ExprKind::Call:
+            return call(static_cast<const CallExpr*>(e));
+        }
+        throw std::logic_error("ir: unknown expression kind");
+    }
+
+    ValueId binary(TokenType op, ValueId l, ValueId r) {
+        switch (op) {
+        case TokenType::Plus:
+            return emit({.op = IrOp::Add, .type = IrType::I64, .a = l, .b = r});
+        case TokenType::Minus:
+            return emit({.op = IrOp::Sub, .type = IrType::I64, .a = l, .b = r});
+        case TokenType::Asterisk:
+            return emit({.op = IrOp::Mul, .type = IrType::I64, .a = l, .b = r});
+        case TokenType::Slash:
+            return emit({.op = IrOp::Div, .type = IrType::I64, .a = l, .b = r});
+        case TokenType::LessThan:
+            return emit({.op = IrOp::Lt, .type = IrType::I1, .a = l, .b = r});
+        case TokenType::GreaterThan:
+            return emit({.op = IrOp::Gt, .type = IrType::I1, .a = l, .b = r});
+        default:
+            fail(std::string("operator ") + type_to_string(op) + " is not supported");
+        }
+    }
+
+    ValueId call(const CallExpr* call) {
+        const Expr* callee = call->called;
+        while (callee->kind == ExprKind::Paren)
+            callee = static_cast<const ParenExpr*>(callee)->expr;
+
+        auto* id = static_cast<const IdentifierExpr*>(callee);
+        if (id->decl_kind != DeclKind::Function)
+            fail(quoted(id->name) + " is not a function");
+
+        auto* fn = static_cast<const FunctionDecl*>(id->decl);
+        if (call->args.size() != fn->params.size()) {
+            fail(quoted(fn->name) + " takes " + std::to_string(fn->params.size()) + " arguments but is called with " +
+                 std::to_string(call->args.size()));
+        }
+
+        // Arguments are evaluated before any of them is stored, since
+        // lowering an argument may add operands of its own.
+        std::vector<ValueId> args;
+        args.reserve(call->args.size());
+        for (const Expr* arg : call->args)
+            args.push_back(as_i64(expr(arg)));
+
+        IrInst inst{.op    = IrOp::Call,
+                    .type  = IrType::I64,
+                    .count = static_cast<uint32_t>(args.size()),
+                    .a     = ids.at(fn),
+                    .args  = static_cast<uint32_t>(f->operands.size())};
+        for (ValueId arg : args)
+            f->operands.push_back(arg);
+        return emit(inst);
+    }
+};
+
+const char* op_names[] = {"nop", "const", "param", "add", "sub", "mul", "div", "lt", "gt",
+                          "eqz", "nez",   "zext",  "neg", "call", "phi", "jump", "branch", "ret"};
+const char* type_names[] = {"void", "i1", "i64"};
+
+void put_value(Emitter& out, ValueId v) {
+    out.put('%');
+    out.put(std::to_string(v));
+}
+
+void put_block(Emitter& out, BlockId b) {
+    out.put('b');
+    out.put(std::to_string(b));
+}
+
+} // namespace
+
+IrLowering::IrLowering(std::span<FunctionDecl* const> fns, const Interner& interner)
+    : fns(fns), interner(interner) {
+    ids.reserve(fns.size());
+    for (size_t i = 0; i < fns.size(); i++)
+        ids.emplace(fns[i], static_cast<uint32_t>(i));
+}
+
+IrModule IrLowering::declare(Arena& arena) const {
+    IrModule module(arena);
+    for (const FunctionDecl* fn : fns) {
+        IrFunction f(arena);
+        f.name   = fn->name;
+        f.params = static_cast<uint32_t>(fn->params.size());
+        module.functions.push_back(f);
+    }
+    return module;
+}
+
+void IrLowering::lower(IrModule& module, uint32_t index, Arena& arena) const {
+    Lowerer(interner, arena, ids).function(fns[index], module.functions[index]);
+}
+
+IrModule lower_ir(std::span<FunctionDecl* const> fns, const Interner& interner, Arena& arena) {
+    IrLowering lowering(fns, interner);
+    IrModule module = lowering.declare(arena);
+    for (uint32_t i = 0; i < fns.size(); i++)
+        lowering.lower(module, i, arena);
+
+    return module;
+}
+
+void write_ir(const IrModule& module, const Interner& interner, Emitter& out) {
+    for (uint32_t i = 0; i < module.functions.size(); i++)
+        write_ir_function(module, interner, i, out);
+}
+
+void write_ir_function(const IrModule& module, const Interner& interner, uint32_t index, Emitter& out) {
+    const IrFunction& f = module.functions[index];
+    out.put("function ");
+    out.put(interner.view(f.name));
+    out.put('\n');
+
+    for (BlockId b = 0; b < f.blocks.size(); b++) {
+        if (!f.blocks[b].live)
+            continue;
+
+        put_block(out, b);
+        out.put(":\n");
+
+        for (ValueId v : f.blocks[b].insts) {
+            const IrInst& inst = f.insts[v];
+            out.put("    ");
+            if (inst.type != IrType::Void) {
+                put_value(out, v);
+                out.put(": ");
+                out.put(type_names[static_cast<size_t>(inst.type)]);
+                out.put(" = ");
+            }
+            out.put(op_names[static_cast<size_t>(inst.op)]);
+
+            switch (inst.op) {
+            case IrOp::Const:
+                out.put(' ');
+                out.put(std::to_string(inst.imm));
+                break;
+            case IrOp::Param:
+                out.put(' ');
+                out.put(std::to_string(inst.a));
+                break;
+            case IrOp::Call:
+                out.put(' ');
+                out.put(interner.view(module.functions[inst.a].name));
+                out.put('(');
+                for (uint32_t i = 0; i < inst.count; i++) {
+                    if (i)
+                        out.put(", ");
+                    put_value(out, f.operands[inst.args + i]);
+                }
+                out.put(')');
+                break;
+            case IrOp::Phi:
+                for (uint32_t i = 0; i < inst.count; i++) {
+                    out.put(i ? ", [" : " [");
+                    put_block(out, f.operands[inst.args + 2 * i]);
+                    out.put(' ');
+                    put_value(out, f.operands[inst.args + 2 * i + 1]);
+                    out.put(']');
+                }
+                break;
+            case IrOp::Jump:
+                out.put(' ');
+                put_block(out, inst.a);
+                break;
+            case IrOp::Branch:
+                out.put(' ');
+                put_value(out, inst.a);
+                out.put(", ");
+                put_block(out, inst.b);
+                out.put(", ");
+                put_block(out, inst.c);
+                break;
+            default: {
+                // Plain value operands.
+                bool first = true;
+                for_each_operand(f, inst, [&](ValueId operand) {
+                    out.put(first ? " " : ", ");
+                    put_value(out, operand);
+                    first = false;
+                });
+                break;
+            }
+            }
+            out.put('\n');
+        }
+    }
+    out.put('\n');
+}
@@ -0,0 +1,827 @@
+#include "ir_passes.hpp"
+#include "hash.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace {
+
+// Values replaced by other values. Passes record replacements while they
+// walk a function and apply them all at the end.
+class Forwarding {
+  public:
+    explicit Forwarding(const IrFunction& f) : forward(f.insts.size(), NoId) {}
+
+    // Instructions added after construction are never replaced.
+    [[nodiscard]] bool replaced(ValueId v) const { return v < forward.size() && forward[v] != NoId; }
+
+    [[nodiscard]] ValueId find(ValueId v) const {
+        while (replaced(v))
+            v = forward[v];
+        return v;
+    }
+
+    void replace(ValueId v, ValueId with) {
+        forward[v] = with;
+        any        = true;
+    }
+
+    // Rewrites every use of a replaced value and removes the replaced
+    // instructions from their blocks.
+    void apply(IrFunction& f) const {
+        if (!any)
+            return;
+
+        for (IrBlock& block : f.blocks) {
+            if (!block.live)
+                continue;
+            for (ValueId v : block.insts)
+                for_each_operand(f, f.insts[v], [&](uint32_t& x) { x = find(x); });
+        }
+
+        for (IrBlock& block : f.blocks) {
+            if (!block.live)
+                continue;
+            block.insts.erase_if([&](ValueId v) {
+                if (!replaced(v))
+                    return false;
+                f.insts[v].op = IrOp::Nop;
+                return true;
+            });
+        }
+    }
+
+  private:
+    std::vector<ValueId> forward;
+    bool any = false;
+};
+
+void resolve_operands(IrFunction& f, IrInst& inst, const Forwarding& fwd) {
+    for_each_operand(f, inst, [&](uint32_t& x) { x = fwd.find(x); });
+}
+
+// Wrapping arithmetic, as in the VM and the native code.
+int64_t wrap_add(int64_t x, int64_t y) { return static_cast<int64_t>(uint64_t(x) + uint64_t(y)); }
+int64_t wrap_sub(int64_t x, int64_t y) { return static_cast<int64_t>(uint64_t(x) - uint64_t(y)); }
+int64_t wrap_mul(int64_t x, int64_t y) { return static_cast<int64_t>(uint64_t(x) * uint64_t(y)); }
+
+// The phis of block `b`, which come before its other instructions.
+template<typename F>
+void for_each_phi(IrFunction& f, BlockId b, F&& fn) {
+    for (ValueId v : f.blocks[b].insts) {
+        if (f.insts[v].op != IrOp::Phi)
+            break;
+        fn(f.insts[v]);
+    }
+}
+
+bool has_phis(const IrFunction& f, BlockId b) { return f.insts[f.blocks[b].insts[0]].op == IrOp::Phi; }
+
+// Incoming entries to drop from phis, gathered over a pass and removed
+// once per block, as a block can lose thousands of predecessors in one
+// pass.
+class PhiRemovals {
+  public:
+    // Drops the entries of the phis of `b` for the former predecessor
+    // `from`.
+    void remove_incoming(BlockId b, BlockId from) { dropped.push_back({b, from}); }
+
+    void apply(IrFunction& f) {
+        std::sort(dropped.begin(), dropped.end());
+        for (size_t begin = 0, end = 0; begin < dropped.size(); begin = end) {
+            BlockId b = dropped[begin].first;
+            while (end < dropped.size() && dropped[end].first == b)
+                end++;
+
+            for_each_phi(f, b, [&](IrInst& phi) {
+                uint32_t* pairs = &f.operands[phi.args];
+                uint32_t kept   = 0;
+                for (uint32_t i = 0; i < phi.count; i++) {
+                    if (std::binary_search(dropped.begin() + begin, dropped.begin() + end,
+                                           std::pair<BlockId, BlockId>{b, pairs[2 * i]}))
+                        continue;
+                    pairs[2 * kept]     = pairs[2 * i];
+                    pairs[2 * kept + 1] = pairs[2 * i + 1];
+                    kept++;
+                }
+                phi.count = kept;
+            });
+        }
+        dropped.clear();
+    }
+
+  private:
+    std::vector<std::pair<BlockId, BlockId>> dropped; // (block, from)
+};
+
+void rename_incoming(IrFunction& f, BlockId b, BlockId from, BlockId to) {
+    for_each_phi(f, b, [&](IrInst& phi) {
+        for (uint32_t i = 0; i < phi.count; i++) {
+            if (f.operands[phi.args + 2 * i] == from)
+                f.operands[phi.args + 2 * i] = to;
+        }
+    });
+}
+
+// New incoming entries for phis, gathered over a whole pass and written
+// back once. Rewriting a phi for every new edge would copy its operands
+// each time, which is quadratic in a long if/else chain.
+class PhiGrowth {
+  public:
+    // Gives every phi of `b` an entry for the new predecessor `from`,
+    // carrying the value it has for `via`, which may itself be an entry
+    // added earlier in the pass.
+    void add_incoming(const IrFunction& f, BlockId b, BlockId via, BlockId from) {
+        for (ValueId v : f.blocks[b].insts) {
+            const IrInst& phi = f.insts[v];
+            if (phi.op != IrOp::Phi)
+                break;
+
+            auto [it, added] = phis.try_emplace(v);
+            Entries& entries = it->second;
+            if (added) {
+                for (uint32_t i = 0; i < phi.count; i++) {
+                    uint32_t block = f.operands[phi.args + 2 * i];
+                    uint32_t value = f.operands[phi.args + 2 * i + 1];
+                    entries.pairs.push_back(block);
+                    entries.pairs.push_back(value);
+                    entries.values.try_emplace(block, value);
+                }
+            }
+
+            auto found    = entries.values.find(via);
+            ValueId value = found == entries.values.end() ? NoId : found->second;
+            entries.pairs.push_back(from);
+            entries.pairs.push_back(value);
+            entries.values.try_emplace(from, value);
+        }
+    }
+
+    // Copies each grown phi's entries to the end of the operand array once.
+    void apply(IrFunction& f) {
+        for (auto& [v, entries] : phis) {
+            IrInst& phi = f.insts[v];
+            phi.args    = static_cast<uint32_t>(f.operands.size());
+            phi.count   = static_cast<uint32_t>(entries.pairs.size() / 2);
+            for (uint32_t x : entries.pairs)
+                f.operands.push_back(x);
+        }
+        phis.clear();
+    }
+
+  private:
+    struct Entries {
+        std::vector<uint32_t> pairs;                 // (block, value)
+        std::unordered_map<BlockId, ValueId> values; // by block
+    };
+
+    std::unordered_map<ValueId, Entries> phis;
+};
+
+// The value every incoming edge of `phi` carries, other than the phi
+// itself, or NoId if they differ.
+ValueId same_incoming(const IrFunction& f, const IrInst& phi, ValueId self) {
+    ValueId same = NoId;
+    for (uint32_t i = 0; i < phi.count; i++) {
+        ValueId v = f.operands[phi.args + 2 * i + 1];
+        if (v == self || v == same)
+            continue;
+        if (same != NoId)
+            return NoId;
+        same = v;
+    }
+    return same;
+}
+
+// A new constant at the end of the entry block, which dominates every use.
+ValueId entry_constant(IrFunction& f, IrType type, int64_t n) {
+    auto v = static_cast<ValueId>(f.insts.size());
+    f.insts.push_back({.op = IrOp::Const, .type = type, .imm = n});
+
+    ArenaVector<ValueId>& entry = f.blocks[0].insts;
+    entry.push_back(entry.back());
+    entry[entry.size() - 2] = v;
+    return v;
+}
+
+void retarget(IrInst& term, BlockId from, BlockId to) {
+    if (term.op == IrOp::Jump) {
+        term.a = to;
+        return;
+    }
+    if (term.b == from)
+        term.b = to;
+    if (term.c == from)
+        term.c = to;
+}
+
+// Rewrites one instruction whose operands are already resolved. Returns
+// whether it changed anything.
+bool fold(IrFunction& f, ValueId v, Forwarding& fwd) {
+    IrInst& inst = f.insts[v];
+
+    auto constant = [&](ValueId x) -> const IrInst* {
+        const IrInst& def = f.insts[x];
+        return def.op == IrOp::Const ? &def : nullptr;
+    };
+    auto becomes = [&](int64_t n) {
+        inst.op    = IrOp::Const;
+        inst.a     = 0;
+        inst.b     = 0;
+        inst.count = 0;
+        inst.imm   = n;
+        return true;
+    };
+    auto forward = [&](ValueId x) {
+        fwd.replace(v, x);
+        return true;
+    };
+
+    switch (inst.op) {
+    case IrOp::Add:
+    case IrOp::Sub:
+    case IrOp::Mul:
+    case IrOp::Div:
+    case IrOp::Lt:
+    case IrOp::Gt: {
+        const IrInst* l = constant(inst.a);
+        const IrInst* r = constant(inst.b);
+
+        if (l && r) {
+            int64_t x = l->imm;
+            int64_t y = r->imm;
+            switch (inst.op) {
+            case IrOp::Add:
+                return becomes(wrap_add(x, y));
+            case IrOp::Sub:
+                return becomes(wrap_sub(x, y));
+            case IrOp::Mul:
+                return becomes(wrap_mul(x, y));
+            case IrOp::Div:
+                if (y == 0)
+                    return false;
+                return becomes(y == -1 ? wrap_sub(0, x) : x / y);
+            case IrOp::Lt:
+                return becomes(x < y);
+            default:
+                return becomes(x > y);
+            }
+        }
+
+        bool l0 = l && l->imm == 0;
+        bool l1 = l && l->imm == 1;
+        bool r0 = r && r->imm == 0;
+        bool r1 = r && r->imm == 1;
+        switch (inst.op) {
+        case IrOp::Add:
+            if (r0)
+                return forward(inst.a);
+            if (l0)
+                return forward(inst.b);
+            break;
+        case IrOp::Sub:
+            if (r0)
+                return forward(inst.a);
+            if (inst.a == inst.b)
+                return becomes(0);
+            break;
+        case IrOp::Mul:
+            if (r1)
+                return forward(inst.a);
+            if (l1)
+                return forward(inst.b);
+            if (l0 || r0)
+                return becomes(0);
+            break;
+        case IrOp::Div:
+            if (r1)
+                return forward(inst.a);
+            break;
+        default:
+            if (inst.a == inst.b)
+                return becomes(0);
+            break;
+        }
+        return false;
+    }
+    case IrOp::Eqz:
+    case IrOp::Nez: {
+        const IrInst& def = f.insts[inst.a];
+        if (def.op == IrOp::Const)
+            return becomes((def.imm == 0) == (inst.op == IrOp::Eqz));
+        if (inst.op == IrOp::Nez && def.type == IrType::I1)
+            return forward(inst.a);
+        if (def.op == IrOp::ZExt) {
+            // Testing a widened comparison tests the comparison.
+            if (inst.op == IrOp::Nez)
+                return forward(def.a);
+            inst.a = def.a;
+            return true;
+        }
+        return false;
+    }
+    case IrOp::ZExt:
+    case IrOp::Neg:
+        if (const IrInst* x = constant(inst.a))
+            return becomes(inst.op == IrOp::Neg ? wrap_sub(0, x->imm) : x->imm);
+        return false;
+    case IrOp::Phi: {
+        if (ValueId same = same_incoming(f, inst, v); same != NoId)
+            return forward(same);
+
+        // Different constants with the same value. None of them need
+        // dominate the phi, so the replacement is a new one.
+        const IrInst* first = inst.count ? constant(f.operands[inst.args + 1]) : nullptr;
+        if (!first)
+            return false;
+        for (uint32_t i = 1; i < inst.count; i++) {
+            const IrInst* x = constant(f.operands[inst.args + 2 * i + 1]);
+            if (!x || x->imm != first->imm || x->type != first->type)
+                return false;
+        }
+        return forward(entry_constant(f, first->type, first->imm));
+    }
+    default:
+        return false;
+    }
+}
+
+// Branches on a constant become jumps, and so do branches with both
+// targets the same.
+uint32_t fold_branches(IrFunction& f) {
+    PhiRemovals removals;
+    uint32_t changes = 0;
+    for (BlockId b = 0; b < f.blocks.size(); b++) {
+        if (!f.blocks[b].live)
+            continue;
+
+        IrInst& term = f.insts[f.blocks[b].insts.back()];
+        if (term.op != IrOp::Branch)
+            continue;
+
+        const IrInst& cond = f.insts[term.a];
+        if (cond.op != IrOp::Const && term.b != term.c)
+            continue;
+
+        BlockId taken   = cond.op != IrOp::Const || cond.imm ? term.b : term.c;
+        BlockId dropped = taken == term.b ? term.c : term.b;
+        if (dropped != taken)
+            removals.remove_incoming(dropped, b);
+
+        term = IrInst{.op = IrOp::Jump, .a = taken};
+        changes++;
+    }
+    removals.apply(f);
+    return changes;
+}
+
+uint32_t remove_unreachable(IrFunction& f) {
+    std::vector<uint8_t> reachable(f.blocks.size());
+    for (BlockId b : f.reverse_postorder())
+        reachable[b] = 1;
+
+    PhiRemovals removals;
+    uint32_t changes = 0;
+    for (BlockId b = 0; b < f.blocks.size(); b++) {
+        IrBlock& block = f.blocks[b];
+        if (!block.live || reachable[b])
+            continue;
+
+        BlockId succ[2];
+        f.successors(b, succ);
+        for (BlockId s : succ) {
+            if (s != NoId && f.blocks[s].live)
+                removals.remove_incoming(s, b);
+        }
+
+        for (ValueId v : block.insts)
+            f.insts[v].op = IrOp::Nop;
+        block.insts.clear();
+        block.live = false;
+        changes++;
+    }
+    removals.apply(f);
+    return changes;
+}
+
+uint32_t forward_trivial_phis(IrFunction& f) {
+    Forwarding fwd(f);
+    uint32_t changes = 0;
+    for (BlockId b = 0; b < f.blocks.size(); b++) {
+        if (!f.blocks[b].live)
+            continue;
+        for_each_phi(f, b, [&](IrInst& phi) {
+            auto v = static_cast<ValueId>(&phi - &f.insts[0]);
+            if (ValueId same = same_incoming(f, phi, v); same != NoId) {
+                fwd.replace(v, same);
+                changes++;
+            }
+        });
+    }
+    fwd.apply(f);
+    return changes;
+}
+
+// Appends a block to its only predecessor when that ends in a jump to it.
+// Keeps `preds` up to date, so chains merge in one call.
+uint32_t merge_blocks(IrFunction& f) {
+    uint32_t changes = 0;
+    for (BlockId b = 1; b < f.blocks.size(); b++) {
+        IrBlock& block = f.blocks[b];
+        if (!block.live || block.preds.size() != 1 || has_phis(f, b))
+            continue;
+
+        BlockId p = block.preds[0];
+        if (p == b || f.terminator(p).op != IrOp::Jump)
+            continue;
+
+        IrBlock& pred = f.blocks[p];
+        f.insts[pred.insts.back()].op = IrOp::Nop;
+        pred.insts.pop_back();
+        for (ValueId v : block.insts)
+            pred.insts.push_back(v);
+
+        BlockId succ[2];
+        f.successors(p, succ);
+        for (BlockId s : succ) {
+            if (s == NoId)
+                continue;
+            for (BlockId& from : f.blocks[s].preds) {
+                if (from == b)
+                    from = p;
+            }
+            rename_incoming(f, s, b, p);
+        }
+
+        block.insts.clear();
+        block.preds.clear();
+        block.live = false;
+        changes++;
+    }
+    return changes;
+}
+
+// Sends the predecessors of a block that only jumps on straight to its
+// target. A predecessor that already reaches the target is left alone when
+// the target has phis, as a phi takes one value per predecessor.
+uint32_t thread_jumps(IrFunction& f) {
+    PhiGrowth growth;
+    uint32_t changes = 0;
+
+    // Edges into blocks with phis, taken from `preds` the first time a
+    // block is a target, as searching `preds` for every edge is quadratic.
+    // A block with phis is never threaded, so its `preds` only grow.
+    std::unordered_set<uint64_t> edges;
+    std::vector<uint8_t> known(f.blocks.size());
+    auto edge = [](BlockId from, BlockId to) { return uint64_t(from) << 32 | to; };
+
+    for (BlockId b = 1; b < f.blocks.size(); b++) {
+        IrBlock& block = f.blocks[b];
+        if (!block.live || block.insts.size() != 1 || f.terminator(b).op != IrOp::Jump)
+            continue;
+
+        BlockId to = f.terminator(b).a;
+        if (to == b)
+            continue;
+
+        IrBlock& target = f.blocks[to];
+        bool phis       = has_phis(f, to);
+        if (phis && !known[to]) {
+            for (BlockId p : target.preds)
+                edges.insert(edge(p, to));
+            known[to] = 1;
+        }
+
+        block.preds.erase_if([&](BlockId p) {
+            if (phis && edges.contains(edge(p, to)))
+                return false;
+
+            retarget(f.insts[f.blocks[p].insts.back()], b, to);
+            if (phis) {
+                growth.add_incoming(f, to, b, p);
+                edges.insert(edge(p, to));
+            }
+            target.preds.push_back(p);
+            changes++;
+            return true;
+        });
+    }
+    growth.apply(f);
+    return changes;
+}
+
+// Dominator tree by Lengauer and Tarjan's algorithm with path compression,
+// O(E log V). The simpler iterative algorithm walks idom chains from every
+// predecessor, which is quadratic when a block at the end of a long if/else
+// chain has a predecessor at every depth. Expects fresh `preds`.
+struct Dominators {
+    std::vector<std::vector<BlockId>> kids; // by block
+
+    explicit Dominators(const IrFunction& f) : kids(f.blocks.size()) {
+        // Depth-first preorder numbers. Everything below works on numbers,
+        // so that comparing semidominators compares numbers.
+        std::vector<uint32_t> number(f.blocks.size(), NoId);
+        std::vector<BlockId> vertex;
+        std::vector<uint32_t> parent;
+        std::vector<std::pair<BlockId, uint32_t>> stack{{0, NoId}};
+        while (!stack.empty()) {
+            auto [b, from] = stack.back();
+            stack.pop_back();
+            if (number[b] != NoId)
+                continue;
+
+            number[b] = static_cast<uint32_t>(vertex.size());
+            vertex.push_back(b);
+            parent.push_back(from);
+
+            BlockId succ[2];
+            f.successors(b, succ);
+            for (int i = 1; i >= 0; i--) {
+                if (succ[i] != NoId && number[succ[i]] == NoId)
+                    stack.push_back({succ[i], number[b]});
+            }
+        }
+
+        auto n = static_cast<uint32_t>(vertex.size());
+        std::vector<uint32_t> semi(n);
+        std::vector<uint32_t> label(n);
+        std::vector<uint32_t> ancestor(n, NoId);
+        std::vector<uint32_t> idom(n);
+        std::vector<std::vector<uint32_t>> bucket(n);
+        for (uint32_t i = 0; i < n; i++)
+            semi[i] = label[i] = i;
+
+        // The vertex of least semidominator on the path to v's forest root.
+        // The path is compressed without recursion, as it can be as long as
+        // the function.
+        std::vector<uint32_t> path;
+        auto eval = [&](uint32_t v) {
+            if (ancestor[v] == NoId)
+                return v;
+            for (uint32_t x = v; ancestor[ancestor[x]] != NoId; x = ancestor[x])
+                path.push_back(x);
+            for (size_t i = path.size(); i > 0; i--) {
+                uint32_t x = path[i - 1];
+                if (semi[label[ancestor[x]]] < semi[label[x]])
+                    label[x] = label[ancestor[x]];
+                ancestor[x] = ancestor[ancestor[x]];
+            }
+            path.clear();
+            return label[v];
+        };
+
+        for (uint32_t w = n - 1; w > 0; w--) {
+            for (BlockId p : f.blocks[vertex[w]].preds) {
+                if (number[p] == NoId)
+                    continue;
+                semi[w] = std::min(semi[w], semi[eval(number[p])]);
+            }
+            bucket[semi[w]].push_back(w);
+            ancestor[w] = parent[w];
+
+            for (uint32_t v : bucket[parent[w]]) {
+                uint32_t u = eval(v);
+                idom[v]    = semi[u] < semi[v] ? u : parent[w];
+            }
+            bucket[parent[w]].clear();
+        }
+
+        for (uint32_t w = 1; w < n; w++) {
+            if (idom[w] != semi[w])
+                idom[w] = idom[idom[w]];
+            kids[vertex[idom[w]]].push_back(vertex[w]);
+        }
+    }
+};
+
+// What makes two instructions compute the same value.
+struct Expression {
+    const IrFunction* f;
+    ValueId v;
+
+    bool operator==(const Expression& other) const {
+        const IrInst& x = f->insts[v];
+        const IrInst& y = f->insts[other.v];
+        if (x.op != y.op || x.type != y.type || x.a != y.a || x.b != y.b || x.imm != y.imm || x.count != y.count)
+            return false;
+        if (x.op != IrOp::Call)
+            return true;
+        return std::equal(&f->operands[x.args], &f->operands[x.args] + x.count, &f->operands[y.args]);
+    }
+};
+
+struct ExpressionHash {
+    size_t operator()(const Expression& e) const noexcept {
+        const IrInst& inst = e.f->insts[e.v];
+        uint64_t h         = hash_mix(uint64_t(inst.op) | uint64_t(inst.type) << 8 | uint64_t(inst.a) << 32);
+        h                  = hash_mix(h ^ inst.b ^ uint64_t(inst.imm) * 0x9e3779b97f4a7c15ull);
+        if (inst.op == IrOp::Call)
+            h = hash_bytes(&e.f->operands[inst.args], inst.count * sizeof(uint32_t), h);
+        return h;
+    }
+};
+
+bool is_expression(IrOp op) {
+    switch (op) {
+    case IrOp::Nop:
+    case IrOp::Phi:
+    case IrOp::Jump:
+    case IrOp::Branch:
+    case IrOp::Ret:
+        return false;
+    default:
+        return true;
+    }
+}
+
+} // namespace
+
+uint32_t fold_constants(IrFunction& f) {
+    Forwarding fwd(f);
+    uint32_t changes = 0;
+    for (BlockId b : f.reverse_postorder()) {
+        for (ValueId v : f.blocks[b].insts) {
+            resolve_operands(f, f.insts[v], fwd);
+            changes += fold(f, v, fwd);
+        }
+    }
+    fwd.apply(f);
+    return changes;
+}
+
+uint32_t simplify_cfg(IrFunction& f) {
+    uint32_t changes = 0;
+    for (;;) {
+        f.compute_preds();
+
+        uint32_t n = fold_branches(f);
+        if (!n)
+            n = remove_unreachable(f);
+        if (!n)
+            n = forward_trivial_phis(f);
+        if (!n) {
+            // Separate statements: both change the CFG, and the operands of
+            // `+` may be evaluated in either order.
+            n = merge_blocks(f);
+            n += thread_jumps(f);
+        }
+        if (!n)
+            return changes;
+        changes += n;
+    }
+}
+
+uint32_t eliminate_common_subexpressions(IrFunction& f) {
+    f.compute_preds();
+    Dominators dom(f);
+    Forwarding fwd(f);
+
+    // Walks the dominator tree keeping the expressions available in the
+    // current block. `added` records what the open blocks made available,
+    // and an entry with block NoId closes a block back to its mark.
+    std::unordered_map<Expression, ValueId, ExpressionHash> available;
+    std::vector<Expression> added;
+    std::vector<std::pair<BlockId, size_t>> stack{{0, 0}};
+    uint32_t changes = 0;
+
+    while (!stack.empty()) {
+        auto [b, mark] = stack.back();
+        stack.pop_back();
+
+        if (b == NoId) {
+            // Leaving a block: drop what it added.
+            for (size_t i = added.size(); i > mark; i--)
+                available.erase(added[i - 1]);
+            added.resize(mark);
+            continue;
+        }
+
+        stack.push_back({NoId, added.size()});
+        for (ValueId v : f.blocks[b].insts) {
+            IrInst& inst = f.insts[v];
+            resolve_operands(f, inst, fwd);
+            if (!is_expression(inst.op))
+                continue;
+
+            // Commutative operands in a fixed order.
+            if ((inst.op == IrOp::Add || inst.op == IrOp::Mul) && inst.a > inst.b)
+                std::swap(inst.a, inst.b);
+
+            auto [it, inserted] = available.try_emplace(Expression{&f, v}, v);
+            if (inserted) {
+                added.push_back(it->first);
+            }
+            else {
+                fwd.replace(v, it->second);
+                changes++;
+            }
+        }
+        for (BlockId kid : dom.kids[b])
+            stack.push_back({kid, 0});
+    }
+
+    fwd.apply(f);
+    return changes;
+}
+
+uint32_t eliminate_dead_code(IrFunction& f) {
+    std::vector<uint8_t> used(f.insts.size());
+    std::vector<ValueId> work;
+
+    auto mark = [&](ValueId v) {
+        if (!used[v]) {
+            used[v] = 1;
+            work.push_back(v);
+        }
+    };
+
+    for (const IrBlock& block : f.blocks) {
+        if (!block.live)
+            continue;
+        for (ValueId v : block.insts) {
+            const IrInst& inst = f.insts[v];
+            switch (inst.op) {
+            case IrOp::Jump:
+            case IrOp::Branch:
+            case IrOp::Ret:
+            case IrOp::Call:
+                mark(v);
+                break;
+            case IrOp::Div: {
+                const IrInst& divisor = f.insts[inst.b];
+                if (divisor.op != IrOp::Const || divisor.imm == 0)
+                    mark(v);
+                break;
+            }
+            default:
+                break;
+            }
+        }
+    }
+
+    while (!work.empty()) {
+        ValueId v = work.back();
+        work.pop_back();
+        for_each_operand(f, f.insts[v], [&](uint32_t x) { mark(x); });
+    }
+
+    uint32_t removed = 0;
+    for (IrBlock& block : f.blocks) {
+        if (!block.live)
+            continue;
+        removed += static_cast<uint32_t>(block.insts.erase_if([&](ValueId v) {
+            if (used[v])
+                return false;
+            f.insts[v].op = IrOp::Nop;
+            return true;
+        }));
+    }
+    return removed;
+}
+
+PassManager PassManager::standard() {
+    PassManager pm;
+    pm.add("fold", fold_constants);
+    pm.add("simplify-cfg", simplify_cfg);
+    pm.add("cse", eliminate_common_subexpressions);
+    pm.add("dce", eliminate_dead_code);
+    pm.add("simplify-cfg", simplify_cfg);
+    pm.add("dce", eliminate_dead_code);
+    return pm;
+}
+
+std::vector<PassReport> PassManager::run(IrModule& module) const {
+    std::vector<PassReport> reports;
+    for (const Entry& entry : passes) {
+        PassReport report{.name = entry.name};
+        auto start = std::chrono::steady_clock::now();
+
+        for (IrFunction& f : module.functions) {
+            size_t before = f.instruction_count();
+            report.changes += entry.pass(f);
+            report.removed += before - f.instruction_count();
+        }
+
+        report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        reports.push_back(report);
+    }
+    return reports;
+}
+
+void PassManager::run(IrFunction& f, std::vector<PassReport>& reports) const {
+    if (reports.empty()) {
+        for (const Entry& entry : passes)
+            reports.push_back({.name = entry.name});
+    }
+
+    for (size_t i = 0; i < passes.size(); i++) {
+        auto start    = std::chrono::steady_clock::now();
+        size_t before = f.instruction_count();
+
+        reports[i].changes += passes[i].pass(f);
+        reports[i].removed += before - f.instruction_count();
+        reports[i].seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+}
@@ -1,52 +1,110 @@
 #include "lexer.hpp"
 
-#include <cctype>
-#include <fstream>
+#include <cstdint>
+#include <iterator>
+#include <optional>
+
+namespace {
+
+struct Keyword {
+    std::string_view text;
+    TokenType type;
+};
+
+constexpr Keyword keywords[] = {
+    {"function", TokenType::Function},
+    {"let", TokenType::Let},
+    {"if", TokenType::If},
+    {"else", TokenType::Else},
+    {"return", TokenType::Return},
+};
+
+constexpr int keyword_bits          = 3;
+constexpr size_t keyword_slots      = size_t(1) << keyword_bits;
+constexpr size_t keyword_min_length = 2;
+constexpr size_t keyword_max_length = 8;
+
+// Multiplicative hash over (first char, last char, length). The seed is
+// searched for at compile time so that every keyword lands in its own slot.
+constexpr uint32_t keyword_hash(std::string_view s, uint32_t seed) {
+    uint32_t key = (uint32_t(static_cast<unsigned char>(s.front())) << 16) |
+                   (uint32_t(static_cast<unsigned char>(s.back())) << 8) | uint32_t(s.size());
+    return (key * seed) >> (32 - keyword_bits);
+}
+
+consteval uint32_t find_keyword_seed() {
+    for (uint32_t seed = 1;; seed += 2) {
+        bool taken[keyword_slots] = {};
+        bool ok                   = true;
+
+        for (const Keyword& kw : keywords) {
+            uint32_t h = keyword_hash(kw.text, seed);
+            if (taken[h]) {
+                ok = false;
+                break;
+            }
+            taken[h] = true;
+        }
+
+        if (ok)
+            return seed;
+    }
+}
+
+constexpr uint32_t keyword_seed = find_keyword_seed();
+
+struct KeywordTable {
+    int8_t slots[keyword_slots];
+};
+
+consteval KeywordTable build_keyword_table() {
+    KeywordTable table{};
+    for (size_t i = 0; i < keyword_slots; i++)
+        table.slots[i] = -1;
+
+    for (size_t i = 0; i < std::size(keywords); i++)
+        table.slots[keyword_hash(keywords[i].text, keyword_seed)] = static_cast<int8_t>(i);
+
+    return table;
+}
+
+constexpr KeywordTable keyword_table = build_keyword_table();
+
+} // namespace
 
 static std::optional<TokenType> keyword_lookup(std::string_view s) {
-    if (s == "function")
-        return TokenType::Function;
-    if (s == "let")
-        return TokenType::Let;
-    if (s == "if")
-        return TokenType::If;
-    if (s == "else")
-        return TokenType::Else;
-    if (s == "return")
-        return TokenType::Return;
-
-    return std::nullopt;
+    if (s.size() < keyword_min_length || s.size() > keyword_max_length)
+        return std::nullopt;
+
+    int8_t slot = keyword_table.slots[keyword_hash(s, keyword_seed)];
+    if (slot < 0 || keywords[slot].text != s)
+        return std::nullopt;
+
+    return keywords[slot].type;
 }
 
 Token Lexer::get_identifier() noexcept {
     const char* start = position;
+    position          = scan::skip_ident(position);
 
-    while (is_ident_char(peek())) {
-        advance();
-    }
-
-    std::string_view txt = arena.copy(start, position - start);
-
-    if (auto keyword = keyword_lookup(txt))
-        return Token(keyword.value(), txt, curr_line);
+    std::string_view txt = text(start, position - start);
+    TokenType type       = keyword_lookup(txt).value_or(TokenType::Identifier);
 
-    return Token(TokenType::Identifier, txt, curr_line);
+    return Token(type, txt, static_cast<uint32_t>(start - this->start));
 }
 
 Token Lexer::get_number() noexcept {
     const char* start = position;
-    while (is_digit(peek())) {
-        advance();
-    }
+    position          = scan::skip_digits(position);
 
-    return Token(TokenType::Number, arena.copy(start, position - start), curr_line);
+    return token(TokenType::Number, start, position - start);
 }
 
 Token Lexer::atom(TokenType t) noexcept {
     const char* start = position;
     advance();
 
-    return Token(t, arena.copy(start, 1), curr_line);
+    return token(t, start, 1);
 }
 
 Token Lexer::equal_or_arrow() noexcept {
@@ -55,30 +113,33 @@ Token Lexer::equal_or_arrow() noexcept {
     advance();
     if (peek() == '>') {
         advance();
-        return Token(TokenType::Arrow, arena.copy(start, 2), curr_line);
+        return token(TokenType::Arrow, start, 2);
     }
 
-    return Token(TokenType::Equal, arena.copy(start, 1), curr_line);
+    return token(TokenType::Equal, start, 1);
 }
 
 Token Lexer::comment() noexcept {
     const char* start = position;
-    advance();
-
-    while (peek() != '\0' && peek() != '\n')
-        advance();
+    position          = scan::skip_line(position);
 
-    return Token(TokenType::Comment, arena.copy(start, position - start), curr_line);
+    return token(TokenType::Comment, start, position - start);
 }
 
 Token Lexer::next() noexcept {
-    while (is_whitespace(peek())) {
-        if (peek() == '\n')
-            curr_line++;
-        advance();
+    while (true) {
+        if (is_whitespace(peek()))
+            position = scan::skip_whitespace(position);
+
+        if (peek() != '#' || comments == Comments::Keep)
+            break;
+        position = scan::skip_line(position);
     }
 
-    if (std::isalpha(static_cast<unsigned char>(peek())) || peek() == '_')
+    if (position >= end)
+        return token(TokenType::FileEnd, position, 0);
+
+    if (scan::has(peek(), scan::IdentStart))
         return get_identifier();
 
     if (is_digit(peek()))
@@ -86,7 +147,7 @@ Token Lexer::next() noexcept {
 
     switch (peek()) {
     case '\0':
-        return Token(TokenType::FileEnd, "", curr_line);
+        return token(TokenType::FileEnd, position, 0);
     case '(':
         return atom(TokenType::LeftParen);
     case ')':
@@ -135,27 +196,13 @@ Token Lexer::next() noexcept {
     }
 }
 
-char* Lexer::open_file(const char* path) {
-    std::streamsize size;
-    std::ifstream file(path, std::ios::binary | std::ios::ate);
-
-    if (!file.is_open()) {
-        std::cerr << "error opening file " << path << std::endl;
-        return nullptr;
-    }
-
-    size = file.tellg();
-    file.seekg(0, std::ios::beg);
-
-    char* buffer = new char[size + 1];
+std::string_view Lexer::text(const char* begin, size_t len) noexcept {
+    if (values == TokenValues::Copy)
+        return arena.copy(begin, len);
 
-    if (!file.read(buffer, size)) {
-        std::cerr << "error: could not read entire file" << std::endl;
-        delete[] buffer;
-        return nullptr;
-    }
+    return std::string_view(begin, len);
+}
 
-    buffer[size] = '\0';
-    file.close();
-    return buffer;
+Token Lexer::token(TokenType t, const char* begin, size_t len) noexcept {
+    return Token(t, text(begin, len), static_cast<uint32_t>(begin - start));
 }
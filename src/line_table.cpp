@@ -0,0 +1,20 @@
+#include "line_table.hpp"
+#include "scan.hpp"
+
+#include <algorithm>
+
+std::string SourceLocation::str() const {
+    return "line " + std::to_string(line) + ", column " + std::to_string(column);
+}
+
+void LineTable::build(std::string_view text) {
+    starts.clear();
+    starts.push_back(0);
+    scan::for_each_newline(text.data(), text.data() + text.size(),
+                           [&](size_t at) { starts.push_back(static_cast<uint32_t>(at + 1)); });
+}
+
+SourceLocation LineTable::locate(uint32_t offset) const {
+    auto it = std::upper_bound(starts.begin() + 1, starts.end(), offset) - 1;
+    return {static_cast<int>(it - starts.begin()) + 1, static_cast<int>(offset - *it) + 1};
+}
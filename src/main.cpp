@@ -1,21 +1,88 @@
-#include "lexer.hpp"
-#include "parser.hpp"
+#include "driver.hpp"
+
+#include <charconv>
 #include <iostream>
+#include <string_view>
+#include <vector>
 
 int main(int argc, char* argv[]) {
-    if (argc < 2) {
-        std::cerr << "expected file" << std::endl;
-        return -1;
-    }
+    DriverOptions options;
+    std::vector<const char*> inputs;
 
-    Arena lexer_arena;
-    Arena parser_arena;
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
 
-    Lexer lexer(argv[1], lexer_arena);
-    Parser parser(lexer, parser_arena);
+        if (arg == "--flat")
+            options.flat = true;
+        else if (arg == "--cache")
+            options.flat = options.cache = true;
+        else if (arg == "--token-array")
+            options.token_array = true;
+        else if (arg == "--pipeline")
+            options.pipeline = true;
+        else if (arg == "--resolve")
+            options.resolve = true;
+        else if (arg == "--run")
+            options.resolve = options.run = true;
+        else if (arg == "--no-opt")
+            options.optimize = false;
+        else if (arg.starts_with("--code-cache="))
+            options.code_cache = argv[i] + 13;
+        else if (arg.starts_with("--code-cache-size=")) {
+            std::string_view mb = arg.substr(18);
+            if (std::from_chars(mb.data(), mb.data() + mb.size(), options.code_cache_limit).ec != std::errc()) {
+                std::cerr << "invalid cache size " << arg << std::endl;
+                return -1;
+            }
+            options.code_cache_limit <<= 20;
+        }
+        else if (arg == "--stats")
+            options.stats = true;
+        else if (arg.starts_with("--trace="))
+            options.trace_path = argv[i] + 8;
+        else if (arg.starts_with("--emit=")) {
+            std::string_view format = arg.substr(7);
+            if (format == "tree")
+                options.format = EmitFormat::Tree;
+            else if (format == "json")
+                options.format = EmitFormat::Json;
+            else if (format == "sexpr")
+                options.format = EmitFormat::Sexpr;
+            else if (format == "asm") {
+                options.format  = EmitFormat::Asm;
+                options.resolve = true;
+            }
+            else if (format == "ir") {
+                options.format  = EmitFormat::Ir;
+                options.resolve = true;
+            }
+            else {
+                std::cerr << "unknown output format " << format << std::endl;
+                return -1;
+            }
+        }
+        else if (arg.starts_with("-j") && arg.size() > 2) {
+            std::string_view n = arg.substr(2);
+            if (std::from_chars(n.data(), n.data() + n.size(), options.jobs).ec != std::errc()) {
+                std::cerr << "invalid job count " << arg << std::endl;
+                return -1;
+            }
+        }
+        else
+            inputs.push_back(argv[i]);
+    }
 
-    auto fns = parser.parse();
-    parser.print_program(fns);
+    if (options.resolve && options.flat) {
+        std::cerr << "--resolve, --run, --emit=asm and --emit=ir work on the pointer AST and cannot be combined with "
+                     "--flat or --cache"
+                  << std::endl;
+        return -1;
+    }
+
+    if (inputs.empty()) {
+        std::cerr << "expected file" << std::endl;
+        return -1;
+    }
 
-    return 0;
+    return run_driver(inputs, options);
 }
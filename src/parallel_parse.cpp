@@ -0,0 +1,230 @@
+#include "parallel_parse.hpp"
+#include "error.hpp"
+#include "lexer.hpp"
+#include "scan.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <optional>
+#include <span>
+#include <string>
+#include <thread>
+
+std::vector<SourceChunk> split_functions(const Source& source, size_t target) {
+    std::vector<SourceChunk> chunks;
+
+    const char* begin = source.begin();
+    const char* end   = source.end();
+    size_t step       = std::max<size_t>(source.size() / std::max<size_t>(target, 1), 1);
+
+    size_t chunk_begin = 0;
+    int depth          = 0;
+
+    for (const char* p = begin; (p = scan::find_structural(p)) < end; p++) {
+        if (*p == '#') {
+            p = scan::skip_line(p) - 1;
+            continue;
+        }
+
+        if (*p == '\0')
+            break;
+
+        if (*p == '{') {
+            depth++;
+            continue;
+        }
+
+        if (--depth < 0)
+            break;
+
+        size_t cut = p + 1 - begin;
+        if (depth == 0 && cut - chunk_begin >= step) {
+            chunks.push_back({chunk_begin, cut});
+            chunk_begin = cut;
+        }
+    }
+
+    if (chunk_begin < source.size() || chunks.empty())
+        chunks.push_back({chunk_begin, source.size()});
+
+    return chunks;
+}
+
+namespace {
+
+// Rewrites chunk-local symbols and types to their merged counterparts.
+// Chunk types are shared, so they are swapped by id rather than rewritten.
+struct SymbolRemap {
+    std::span<const Symbol> to;
+    std::span<const TypeNode* const> to_types;
+
+    void type(const TypeNode*& t) { t = to_types[t->id]; }
+
+    void expr(Expr* e) {
+        switch (e->kind) {
+        case ExprKind::Identifier: {
+            auto* id = static_cast<IdentifierExpr*>(e);
+            id->name = to[id->name];
+            break;
+        }
+        case ExprKind::Literal: {
+            auto* lit  = static_cast<LiteralExpr*>(e);
+            lit->value = to[lit->value];
+            break;
+        }
+        case ExprKind::Binary: {
+            auto* bin = static_cast<BinaryExpr*>(e);
+            expr(bin->left);
+            expr(bin->right);
+            break;
+        }
+        case ExprKind::Unary:
+            expr(static_cast<UnaryExpr*>(e)->expr);
+            break;
+        case ExprKind::Paren:
+            expr(static_cast<ParenExpr*>(e)->expr);
+            break;
+        case ExprKind::Call: {
+            auto* call = static_cast<CallExpr*>(e);
+            expr(call->called);
+            for (Expr* arg : call->args)
+                expr(arg);
+            break;
+        }
+        }
+    }
+
+    void stmt(Stmt* s) {
+        switch (s->kind) {
+        case StmtKind::Let: {
+            auto* let = static_cast<LetStmt*>(s);
+            let->name = to[let->name];
+            type(let->type);
+            expr(let->expr);
+            break;
+        }
+        case StmtKind::Return:
+            expr(static_cast<ReturnStmt*>(s)->value);
+            break;
+        case StmtKind::Expr:
+            expr(static_cast<ExprStmt*>(s)->expr);
+            break;
+        case StmtKind::Scope:
+            for (Stmt* st : static_cast<ScopeStmt*>(s)->statements)
+                stmt(st);
+            break;
+        case StmtKind::If: {
+            auto* iff = static_cast<IfStmt*>(s);
+            expr(iff->condition);
+            stmt(iff->then_branch);
+            if (iff->else_branch)
+                stmt(iff->else_branch);
+            break;
+        }
+        }
+    }
+
+    void function(FunctionDecl* fn) {
+        fn->name = to[fn->name];
+        for (Param* p : fn->params) {
+            p->name = to[p->name];
+            type(p->type);
+        }
+        type(fn->return_type);
+        stmt(fn->body);
+    }
+};
+
+struct ChunkResult {
+    std::unique_ptr<Interner> names;
+    std::unique_ptr<TypeTable> types;
+    std::vector<FunctionDecl*> functions;
+    std::vector<Symbol> remap;
+    std::vector<const TypeNode*> type_remap;
+    std::optional<std::string> error;
+};
+
+// Runs `work(i)` for every i in [0, count) on up to `jobs` threads.
+template<typename F>
+void parallel_for(size_t count, unsigned jobs, F work) {
+    std::atomic<size_t> next{0};
+    auto loop = [&] {
+        for (size_t i = next++; i < count; i = next++)
+            work(i);
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned t = 1; t < std::min<size_t>(jobs, count); t++)
+        threads.emplace_back(loop);
+    loop();
+
+    for (auto& thread : threads)
+        thread.join();
+}
+
+} // namespace
+
+ParallelParser::ParallelParser(const Source& source, Interner& interner, TypeTable& types, unsigned jobs,
+                               Trace* trace)
+    : source(source), interner(interner), types(types), jobs(std::max(jobs, 1u)), trace(trace) {}
+
+std::vector<FunctionDecl*> ParallelParser::parse() {
+    // A few chunks per thread keeps threads busy when function sizes vary.
+    std::vector<SourceChunk> chunks = split_functions(source, size_t(jobs) * 4);
+    std::vector<ChunkResult> results(chunks.size());
+
+    arenas.clear();
+    for (size_t i = 0; i < chunks.size(); i++)
+        arenas.push_back(std::make_unique<Arena>());
+
+    parallel_for(chunks.size(), jobs, [&](size_t i) {
+        const SourceChunk& chunk = chunks[i];
+        ChunkResult& result      = results[i];
+        result.names             = std::make_unique<Interner>();
+        result.types             = std::make_unique<TypeTable>();
+
+        try {
+            Arena lexer_arena;
+            Lexer lexer(source, chunk.begin, chunk.end, lexer_arena);
+            Parser parser(lexer, *arenas[i], *result.names, *result.types);
+            parser.set_trace(trace);
+            result.functions = parser.parse();
+        } catch (const CompileError& e) {
+            result.error = e.what();
+        }
+    });
+
+    for (ChunkResult& result : results) {
+        if (result.error)
+            throw CompileError(*result.error);
+    }
+
+    for (ChunkResult& result : results) {
+        result.remap.resize(result.names->size());
+        for (Symbol s = 0; s < result.names->size(); s++)
+            result.remap[s] = interner.intern(result.names->view(s));
+
+        // Table order puts arguments first, so theirs are already mapped.
+        std::vector<const TypeNode*> args;
+        result.type_remap.resize(result.types->size());
+        for (uint32_t id = 0; id < result.types->size(); id++) {
+            const TypeNode* t = result.types->node(id);
+            args.clear();
+            for (const TypeNode* arg : t->types)
+                args.push_back(result.type_remap[arg->id]);
+            result.type_remap[id] = types.intern(result.remap[t->name], args);
+        }
+    }
+
+    parallel_for(results.size(), jobs, [&](size_t i) {
+        SymbolRemap remap{results[i].remap, results[i].type_remap};
+        for (FunctionDecl* fn : results[i].functions)
+            remap.function(fn);
+    });
+
+    std::vector<FunctionDecl*> functions;
+    for (ChunkResult& result : results)
+        functions.insert(functions.end(), result.functions.begin(), result.functions.end());
+
+    return functions;
+}
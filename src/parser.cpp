@@ -1,70 +1,120 @@
 #include "parser.hpp"
 #include "arena.hpp"
+#include "error.hpp"
 #include "lexer.hpp"
 
 // #include <string_view>
+#include <stdexcept>
+#include <string>
 #include <vector>
 
-Parser::Parser(Lexer& lexer, Arena& arena) : lexer(lexer), arena(arena), curr(Token(TokenType::Unknown, "", -1)) {
+Parser::Parser(Lexer& lexer, Arena& arena, Interner& interner, TypeTable& types)
+    : source(lexer.source()), lexer(&lexer), arena(arena), interner(interner), types(types),
+      curr(Token(TokenType::Unknown, "", 0)) {
     advance();
 }
 
+Parser::Parser(const TokenArray& tokens, Arena& arena, Interner& interner, TypeTable& types)
+    : source(tokens.source()), tokens(&tokens), arena(arena), interner(interner), types(types),
+      curr(tokens.token(0)) {}
+
+Parser::Parser(PipelinedLexer& stream, Arena& arena, Interner& interner, TypeTable& types)
+    : source(stream.source()), stream(&stream), arena(arena), interner(interner), types(types),
+      curr(stream.next()) {}
+
 void Parser::advance() {
-    curr = lexer.next();
+    if (tokens) {
+        curr = tokens->token(++index);
+        return;
+    }
+    if (stream) {
+        curr = stream->next();
+        return;
+    }
+
+    curr = lexer->next();
     while (curr.type == TokenType::Comment)
-        curr = lexer.next();
+        curr = lexer->next();
+}
+
+TokenType Parser::peek(uint32_t n) const {
+    if (tokens)
+        return tokens->type(index + n);
+    if (n != 0)
+        throw std::logic_error("Parser::peek past the current token needs a TokenArray");
+    return curr.type;
+}
+
+void Parser::rewind(uint32_t to) {
+    if (!tokens)
+        throw std::logic_error("Parser::rewind needs a TokenArray");
+
+    index = to;
+    curr  = tokens->token(index);
 }
 
 Token Parser::expect(TokenType t) {
     if (curr.type != t) {
-        std::cerr << "Parser error on line " << curr.line << std::endl;
-        std::cerr << "Expected: " << type_to_string(t) << std::endl;
-        std::cerr << "Got: " << type_to_string(curr.type) << std::endl;
-        std::exit(-1);
+        throw CompileError("Parser error on " + curr_location() + "\nExpected: " +
+                           type_to_string(t) + "\nGot: " + type_to_string(curr.type));
     }
     Token out = curr;
     advance();
     return out;
 }
 
+Symbol Parser::expect_symbol(TokenType t) {
+    return interner.intern(expect(t).value);
+}
+
+std::string Parser::curr_location() const {
+    return source.locate(curr.offset).str();
+}
+
 std::vector<FunctionDecl*> Parser::parse() {
     std::vector<FunctionDecl*> functions;
 
     while (curr.type != TokenType::FileEnd) {
-        functions.push_back(parse_function());
+        if (!trace) {
+            functions.push_back(parse_function());
+            continue;
+        }
+
+        auto start       = Trace::Clock::now();
+        FunctionDecl* fn = parse_function();
+        trace->complete(interner.view(fn->name), "function", start);
+        functions.push_back(fn);
     }
 
     return functions;
 }
 
-void Parser::print_program(const std::vector<FunctionDecl*>& fns) {
-    for (auto* fn : fns) {
-        print_function(fn);
-        std::cout << std::endl;
-    }
-}
-
 FunctionDecl* Parser::parse_function() {
+    uint32_t begin = curr.offset;
+    fn_begin       = begin;
 
     expect(TokenType::Function);
-    std::string_view name = expect(TokenType::Identifier).value;
+    Symbol name = expect_symbol(TokenType::Identifier);
     expect(TokenType::LeftParen);
 
     FunctionDecl* fn = arena.alloc<FunctionDecl>();
     fn->name         = name;
 
+    size_t params = param_lists.open();
     if (curr.type != TokenType::RightParen) {
-        fn->params.push_back(parse_param());
+        param_lists.push(parse_param());
         while (curr.type == TokenType::Comma) {
             advance();
-            fn->params.push_back(parse_param());
+            param_lists.push(parse_param());
         }
     }
+    fn->params = param_lists.finish(params, arena);
     expect(TokenType::RightParen);
     expect(TokenType::Arrow);
 
     fn->return_type = parse_type();
     fn->body        = parse_scope();
+    fn->span        = {begin, scope_end};
 
     return fn;
 }
@@ -72,41 +122,50 @@ FunctionDecl* Parser::parse_function() {
 Param* Parser::parse_param() {
     Param* param = arena.alloc<Param>();
 
-    param->name = expect(TokenType::Identifier).value;
+    param->offset = relative(curr.offset);
+    param->name   = expect_symbol(TokenType::Identifier);
     expect(TokenType::Colon);
     param->type = parse_type();
 
     return param;
 }
 
-TypeNode* Parser::parse_type() {
-    TypeNode* type = arena.alloc<TypeNode>();
+// Arguments are interned before the type that uses them, so the table only
+// ever compares canonical pointers.
+const TypeNode* Parser::parse_type() {
+    Symbol name = expect_symbol(TokenType::Identifier);
+    if (curr.type != TokenType::LessThan)
+        return types.intern(name, {});
 
-    type->name = expect(TokenType::Identifier).value;
-    if (curr.type == TokenType::LessThan) {
-        advance();
-        type->types.push_back(parse_type());
+    advance();
+    size_t args = type_lists.open();
+    type_lists.push(parse_type());
 
-        while (curr.type == TokenType::Comma) {
-            advance();
-            type->types.push_back(parse_type());
-        }
-        expect(TokenType::GreaterThan);
+    while (curr.type == TokenType::Comma) {
+        advance();
+        type_lists.push(parse_type());
     }
+    expect(TokenType::GreaterThan);
+
+    const TypeNode* type = types.intern(name, type_lists.view(args));
+    type_lists.close(args);
     return type;
 }
 
 ScopeStmt* Parser::parse_scope() {
     ScopeStmt* stmt = arena.alloc<ScopeStmt>();
+    stmt->offset    = relative(curr.offset);
 
     expect(TokenType::LeftCurly);
+    size_t statements = stmt_lists.open();
     while (curr.type != TokenType::RightCurly) {
         if (curr.type == TokenType::FileEnd) {
-            std::cerr << "error: expected `}` on line " << curr.line << std::endl;
-            std::exit(-1);
+            throw CompileError("error: expected `}` on " + curr_location());
         }
-        stmt->statements.push_back(parse_stmt());
+        stmt_lists.push(parse_stmt());
     }
+    stmt->statements = stmt_lists.finish(statements, arena);
+    scope_end        = curr.offset + 1;
     expect(TokenType::RightCurly);
 
     return stmt;
@@ -114,9 +173,10 @@ ScopeStmt* Parser::parse_scope() {
 
 LetStmt* Parser::parse_let() {
     LetStmt* stmt = arena.alloc<LetStmt>();
+    stmt->offset  = relative(curr.offset);
 
     expect(TokenType::Let);
-    stmt->name = expect(TokenType::Identifier).value;
+    stmt->name = expect_symbol(TokenType::Identifier);
     expect(TokenType::Colon);
     stmt->type = parse_type();
     expect(TokenType::Equal);
@@ -128,6 +188,7 @@ LetStmt* Parser::parse_let() {
 
 IfStmt* Parser::parse_if() {
     IfStmt* stmt      = arena.alloc<IfStmt>();
+    stmt->offset      = relative(curr.offset);
     stmt->else_branch = nullptr;
 
     expect(TokenType::If);
@@ -151,6 +212,7 @@ IfStmt* Parser::parse_if() {
 
 ReturnStmt* Parser::parse_return() {
     ReturnStmt* stmt = arena.alloc<ReturnStmt>();
+    stmt->offset     = relative(curr.offset);
 
     expect(TokenType::Return);
     stmt->value = parse_expr();
@@ -161,6 +223,7 @@ ReturnStmt* Parser::parse_return() {
 
 ExprStmt* Parser::parse_expr_stmt() {
     ExprStmt* expr = arena.alloc<ExprStmt>();
+    expr->offset   = relative(curr.offset);
 
     expr->expr = parse_expr();
     expect(TokenType::SemiColon);
@@ -192,23 +255,28 @@ Expr* Parser::parse_precedence(const int min_prec) {
 }
 
 Expr* Parser::parse_prefix() {
+    uint32_t at = relative(curr.offset);
+
     switch (curr.type) {
     case TokenType::Identifier: {
-        std::string_view name = expect(TokenType::Identifier).value;
-        IdentifierExpr* id    = arena.alloc<IdentifierExpr>();
-        id->name              = name;
+        Symbol name        = expect_symbol(TokenType::Identifier);
+        IdentifierExpr* id = arena.alloc<IdentifierExpr>();
+        id->offset         = at;
+        id->name           = name;
         return id;
     }
 
     case TokenType::Number: {
         LiteralExpr* literal = arena.alloc<LiteralExpr>();
-        literal->value       = expect(TokenType::Number).value;
+        literal->offset      = at;
+        literal->value       = expect_symbol(TokenType::Number);
         return literal;
     }
 
     case TokenType::LeftParen: {
         advance();
         ParenExpr* p = arena.alloc<ParenExpr>();
+        p->offset    = at;
         p->expr      = parse_expr();
         expect(TokenType::RightParen);
         return p;
@@ -218,6 +286,7 @@ Expr* Parser::parse_prefix() {
         Token op         = expect(TokenType::Exclamation);
         Expr* right      = parse_precedence(Precedence::UNARY);
         UnaryExpr* unary = arena.alloc<UnaryExpr>();
+        unary->offset    = at;
         unary->op        = op.type;
         unary->expr      = right;
         return unary;
@@ -227,29 +296,31 @@ Expr* Parser::parse_prefix() {
         Token op         = expect(TokenType::Minus);
         Expr* right      = parse_precedence(Precedence::UNARY);
         UnaryExpr* unary = arena.alloc<UnaryExpr>();
+        unary->offset    = at;
         unary->op        = op.type;
         unary->expr      = right;
         return unary;
     }
 
     default:
-        std::cerr << "Unexpected token on line " << curr.line << ": " << type_to_string(curr.type) << std::endl;
-        std::exit(-1);
+        throw CompileError("Unexpected token on " + curr_location() + ": " + type_to_string(curr.type));
     }
 }
 
 Expr* Parser::parse_infix(Expr* left, const Token& op, const int prec) {
     if (op.type == TokenType::LeftParen) {
         if (!is_callable(left)) {
-            std::cerr << "cannot call non callable expression" << std::endl;
-            std::exit(-1);
+            throw CompileError("cannot call non callable expression");
         }
-        return parse_call(left);
+        Expr* call   = parse_call(left);
+        call->offset = relative(op.offset);
+        return call;
     }
 
     Expr* right = parse_precedence(prec);
 
     BinaryExpr* bin = arena.alloc<BinaryExpr>();
+    bin->offset     = relative(op.offset);
     bin->left       = left;
     bin->op         = op.type;
     bin->right      = right;
@@ -261,13 +332,15 @@ Expr* Parser::parse_call(Expr* from) {
     CallExpr* call = arena.alloc<CallExpr>();
     call->called   = from;
 
+    size_t args = expr_lists.open();
     if (curr.type != TokenType::RightParen) {
-        call->args.push_back(parse_expr());
+        expr_lists.push(parse_expr());
         while (curr.type == TokenType::Comma) {
             advance();
-            call->args.push_back(parse_expr());
+            expr_lists.push(parse_expr());
         }
     }
+    call->args = expr_lists.finish(args, arena);
 
     expect(TokenType::RightParen);
     return call;
@@ -329,162 +402,3 @@ int Parser::get_precedence(TokenType t) {
         return Precedence::NONE;
     }
 }
-
-void Parser::indent(const int n) {
-    for (int i = 0; i < n; i++)
-        std::cout << "  ";
-}
-void Parser::print_expr(Expr* expr, const int indent_level) {
-    indent(indent_level);
-
-    switch (expr->kind) {
-
-    case ExprKind::Identifier: {
-        auto id = static_cast<IdentifierExpr*>(expr);
-        std::cout << "Identifier (" << id->name << ")" << std::endl;
-        break;
-    }
-
-    case ExprKind::Literal: {
-        auto lit = static_cast<LiteralExpr*>(expr);
-        std::cout << "Literal (" << lit->value << ")" << std::endl;
-        break;
-    }
-
-    case ExprKind::Unary: {
-        auto un = static_cast<UnaryExpr*>(expr);
-        std::cout << "Unary (" << type_to_string(un->op) << ")" << std::endl;
-        print_expr(un->expr, indent_level + 1);
-        break;
-    }
-
-    case ExprKind::Binary: {
-        auto bin = static_cast<BinaryExpr*>(expr);
-        std::cout << "Binary (" << type_to_string(bin->op) << ")" << std::endl;
-
-        indent(indent_level);
-        std::cout << "left:" << std::endl;
-        print_expr(bin->left, indent_level + 1);
-
-        indent(indent_level);
-        std::cout << "right:" << std::endl;
-        print_expr(bin->right, indent_level + 1);
-
-        break;
-    }
-
-    case ExprKind::Call: {
-        auto call = static_cast<CallExpr*>(expr);
-        std::cout << "Call " << std::endl;
-
-        indent(indent_level + 1);
-        std::cout << "callee:" << std::endl;
-        print_expr(call->called, indent_level + 2);
-
-        indent(indent_level + 1);
-        std::cout << "args:" << std::endl;
-        for (auto* arg : call->args) {
-            print_expr(arg, indent_level + 2);
-        }
-        break;
-    }
-
-    case ExprKind::Paren: {
-        auto paren = static_cast<ParenExpr*>(expr);
-        std::cout << "Paren" << std::endl;
-
-        print_expr(paren->expr, indent_level + 1);
-        break;
-    }
-    }
-}
-
-void Parser::print_stmt(Stmt* s, int indent_level) {
-    indent(indent_level);
-
-    switch (s->kind) {
-
-    case StmtKind::Let: {
-        auto* let = static_cast<LetStmt*>(s);
-        std::cout << "Let " << let->name << " : " << let->type->name << std::endl;
-        print_expr(let->expr, indent_level + 1);
-        break;
-    }
-
-    case StmtKind::Return: {
-        auto* ret = static_cast<ReturnStmt*>(s);
-        std::cout << "Return\n";
-        print_expr(ret->value, indent_level + 1);
-        break;
-    }
-
-    case StmtKind::Expr: {
-        auto* es = static_cast<ExprStmt*>(s);
-        std::cout << "ExprStmt\n";
-        print_expr(es->expr, indent_level + 1);
-        break;
-    }
-
-    case StmtKind::Scope: {
-        auto* sc = static_cast<ScopeStmt*>(s);
-        std::cout << "Scope\n";
-        for (auto* st : sc->statements)
-            print_stmt(st, indent_level + 1);
-        break;
-    }
-
-    case StmtKind::If: {
-        auto* iff = static_cast<IfStmt*>(s);
-        std::cout << "If\n";
-
-        indent(indent_level + 1);
-        std::cout << "condition:\n";
-        print_expr(iff->condition, indent_level + 2);
-
-        indent(indent_level + 1);
-        std::cout << "then:\n";
-        print_stmt(iff->then_branch, indent_level + 2);
-
-        if (iff->else_branch) {
-            indent(indent_level + 1);
-            std::cout << "else:\n";
-            print_stmt(iff->else_branch, indent_level + 2);
-        }
-        break;
-    }
-    }
-}
-
-void Parser::print_type(TypeNode* t, const int indent_level) {
-    indent(indent_level);
-    std::cout << t->name;
-
-    if (!t->types.empty()) {
-        std::cout << "<";
-        for (size_t i = 0; i < t->types.size(); i++) {
-            print_type(t->types[i]);
-            if (i + 1 < t->types.size()) {
-                std::cout << ", ";
-            }
-        }
-        std::cout << ">";
-    }
-}
-
-void Parser::print_function(FunctionDecl* fn) {
-    std::cout << "Function " << fn->name << std::endl;
-
-    std::cout << "  params:\n";
-    for (auto* p : fn->params) {
-        std::cout << "    " << p->name << " : ";
-        print_type(p->type);
-        std::cout << std::endl;
-    }
-
-    std::cout << "  return: ";
-    print_type(fn->return_type, 1);
-    std::cout << std::endl;
-
-    std::cout << "  body:\n";
-    print_stmt(fn->body, 2);
-}
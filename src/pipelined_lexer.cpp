@@ -0,0 +1,63 @@
+#include "pipelined_lexer.hpp"
+#include "arena.hpp"
+#include "error.hpp"
+#include "lexer.hpp"
+
+#include <string>
+
+PipelinedLexer::PipelinedLexer(const Source& source)
+    : input(source), base(source.begin()), producer([this] { produce(); }) {}
+
+PipelinedLexer::~PipelinedLexer() {
+    // The parser may stop early on an error, leaving the producer blocked on
+    // a full ring.
+    ring.close();
+    producer.join();
+}
+
+void PipelinedLexer::produce() {
+    Arena unused; // views into the source never touch the lexer arena
+    Lexer lexer(input, unused);
+
+    for (bool done = false; !done;) {
+        Batch* out = ring.begin_write();
+        if (!out)
+            return;
+
+        out->count  = 0;
+        out->failed = false;
+
+        while (out->count < batch_size) {
+            Token t       = lexer.next();
+            uint32_t size = static_cast<uint32_t>(t.value.size());
+
+            if (t.value.size() > TokenArray::max_length) {
+                out->failed = true;
+                t.type      = TokenType::FileEnd;
+                size        = 0;
+            }
+
+            out->tokens[out->count++] = {t.offset, static_cast<uint32_t>(t.type), size};
+            if (t.type == TokenType::FileEnd) {
+                done = true;
+                break;
+            }
+        }
+
+        ring.publish();
+    }
+}
+
+void PipelinedLexer::refill() {
+    if (batch)
+        ring.release();
+
+    batch  = ring.begin_read();
+    pos    = 0;
+    count  = batch->count;
+    failed = batch->failed;
+}
+
+void PipelinedLexer::throw_too_long() const {
+    throw CompileError("token too long on " + input.locate(last.offset).str());
+}
@@ -0,0 +1,256 @@
+#include "regalloc.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <queue>
+
+namespace {
+
+constexpr uint16_t bit(Register r) {
+    return static_cast<uint16_t>(1u << static_cast<unsigned>(r));
+}
+
+// Allocatable registers in order of preference. Caller-saved registers
+// cost nothing to use, and %rdx comes last among them since division takes
+// it; the callee-saved ones follow.
+constexpr Register preference[] = {Register::Rcx, Register::Rsi, Register::Rdi, Register::R8,
+                                   Register::R9,  Register::R10, Register::Rdx, Register::Rbx,
+                                   Register::R12, Register::R13, Register::R14, Register::R15};
+
+constexpr uint16_t callee_mask =
+    bit(Register::Rbx) | bit(Register::R12) | bit(Register::R13) | bit(Register::R14) | bit(Register::R15);
+constexpr uint16_t caller_mask = bit(Register::Rcx) | bit(Register::Rdx) | bit(Register::Rsi) | bit(Register::Rdi) |
+                                 bit(Register::R8) | bit(Register::R9) | bit(Register::R10);
+
+bool is_compare(IrOp op) {
+    return op == IrOp::Lt || op == IrOp::Gt || op == IrOp::Eqz || op == IrOp::Nez;
+}
+
+bool fits_imm32(int64_t n) {
+    return n >= std::numeric_limits<int32_t>::min() && n <= std::numeric_limits<int32_t>::max();
+}
+
+struct Interval {
+    ValueId v;
+    uint32_t start;
+    uint32_t end;
+};
+
+} // namespace
+
+Allocation allocate_registers(const IrFunction& f) {
+    Allocation out;
+    out.order = f.reverse_postorder();
+
+    size_t n = f.insts.size();
+    out.values.resize(n);
+    out.fused.resize(n);
+
+    // Positions in layout order, and of each block's terminator.
+    std::vector<uint32_t> pos(n, NoId);
+    std::vector<uint32_t> block_end(f.blocks.size(), NoId);
+    uint32_t count = 0;
+    for (BlockId b : out.order) {
+        for (ValueId v : f.blocks[b].insts)
+            pos[v] = count++;
+        block_end[b] = count - 1;
+    }
+
+    // Last use of every value, and how many calls and divisions come
+    // before each position.
+    std::vector<uint32_t> uses(n);
+    std::vector<uint32_t> last(n);
+    std::vector<uint32_t> calls(count + 1);
+    std::vector<uint32_t> divs(count + 1);
+    auto use = [&](ValueId x, uint32_t at) {
+        uses[x]++;
+        last[x] = std::max(last[x], at);
+    };
+
+    for (BlockId b : out.order) {
+        for (ValueId v : f.blocks[b].insts) {
+            const IrInst& inst = f.insts[v];
+            if (inst.op == IrOp::Phi) {
+                for (uint32_t i = 0; i < inst.count; i++) {
+                    BlockId from = f.operands[inst.args + 2 * i];
+                    if (block_end[from] != NoId)
+                        use(f.operands[inst.args + 2 * i + 1], block_end[from]);
+                }
+                continue;
+            }
+            for_each_operand(f, inst, [&](ValueId x) { use(x, pos[v]); });
+            calls[pos[v] + 1] = inst.op == IrOp::Call;
+            divs[pos[v] + 1]  = inst.op == IrOp::Div;
+        }
+    }
+    for (uint32_t i = 1; i <= count; i++) {
+        calls[i] += calls[i - 1];
+        divs[i] += divs[i - 1];
+    }
+
+    // A comparison used only by the branch right after it becomes part of
+    // the branch, so its operands are read there.
+    for (BlockId b : out.order) {
+        const ArenaVector<ValueId>& insts = f.blocks[b].insts;
+        if (insts.size() < 2)
+            continue;
+
+        const IrInst& term = f.insts[insts.back()];
+        ValueId cond       = insts[insts.size() - 2];
+        if (term.op == IrOp::Branch && term.a == cond && uses[cond] == 1 && is_compare(f.insts[cond].op)) {
+            out.fused[cond] = 1;
+            for_each_operand(f, f.insts[cond], [&](ValueId x) { last[x] = std::max(last[x], pos[cond] + 1); });
+        }
+    }
+
+    // A value passed to a call as its last use would rather already be in
+    // the argument register.
+    std::vector<uint8_t> arg_hint(n, 0xff);
+    for (BlockId b : out.order) {
+        for (ValueId v : f.blocks[b].insts) {
+            const IrInst& inst = f.insts[v];
+            if (inst.op != IrOp::Call)
+                continue;
+            for (uint32_t i = 0; i < std::min<uint32_t>(inst.count, std::size(arg_registers)); i++) {
+                ValueId x = f.operands[inst.args + i];
+                if (last[x] == pos[v])
+                    arg_hint[x] = static_cast<uint8_t>(arg_registers[i]);
+            }
+        }
+    }
+
+    std::vector<Interval> active; // holding registers
+    std::vector<Interval> spills;
+    uint16_t free = caller_mask | callee_mask;
+
+    auto reg_of = [&](ValueId x) -> int {
+        const Location& at = out.values[x];
+        return at.kind == Location::Reg ? static_cast<int>(at.reg) : -1;
+    };
+
+    for (BlockId b : out.order) {
+        for (ValueId v : f.blocks[b].insts) {
+            const IrInst& inst = f.insts[v];
+            if (inst.type == IrType::Void || !uses[v] || out.fused[v])
+                continue;
+            if (inst.op == IrOp::Const && fits_imm32(inst.imm)) {
+                out.values[v] = {.kind = Location::Imm, .imm = inst.imm};
+                continue;
+            }
+
+            uint32_t start = pos[v];
+            uint32_t end   = last[v];
+            out.intervals++;
+
+            // Intervals ending here give their register back: operands are
+            // read before the result is written.
+            std::erase_if(active, [&](const Interval& a) {
+                if (a.end > start)
+                    return false;
+                free |= bit(out.values[a.v].reg);
+                return true;
+            });
+
+            uint16_t allowed = caller_mask | callee_mask;
+            if (end > start + 1) {
+                if (calls[end] != calls[start + 1])
+                    allowed &= callee_mask;
+                if (divs[end] != divs[start + 1])
+                    allowed &= static_cast<uint16_t>(~bit(Register::Rdx));
+            }
+            uint16_t usable = free & allowed;
+
+            // Registers that would make a move unnecessary.
+            int hints[4] = {-1, -1, -1, -1};
+            switch (inst.op) {
+            case IrOp::Param:
+                if (inst.a < std::size(arg_registers))
+                    hints[0] = static_cast<int>(arg_registers[inst.a]);
+                break;
+            case IrOp::Add:
+            case IrOp::Mul:
+                hints[1] = reg_of(inst.b);
+                [[fallthrough]];
+            case IrOp::Sub:
+            case IrOp::Neg:
+            case IrOp::ZExt:
+                hints[0] = reg_of(inst.a);
+                break;
+            case IrOp::Phi:
+                for (uint32_t i = 0; i < std::min<uint32_t>(inst.count, 3); i++)
+                    hints[i] = reg_of(f.operands[inst.args + 2 * i + 1]);
+                break;
+            default:
+                break;
+            }
+            if (arg_hint[v] != 0xff)
+                hints[3] = arg_hint[v];
+
+            int chosen = -1;
+            for (int h : hints) {
+                if (h >= 0 && (usable & (1u << h))) {
+                    chosen = h;
+                    out.coalesced++;
+                    break;
+                }
+            }
+            for (Register r : preference) {
+                if (chosen < 0 && (usable & bit(r)))
+                    chosen = static_cast<int>(r);
+            }
+
+            if (chosen < 0) {
+                // Spill whichever ends last: this interval, or an active one
+                // holding a register it may use.
+                auto victim = active.end();
+                for (auto it = active.begin(); it != active.end(); ++it) {
+                    if ((allowed & bit(out.values[it->v].reg)) && (victim == active.end() || it->end > victim->end))
+                        victim = it;
+                }
+                if (victim == active.end() || victim->end <= end) {
+                    spills.push_back({v, start, end});
+                    continue;
+                }
+
+                chosen = static_cast<int>(out.values[victim->v].reg);
+                spills.push_back(*victim);
+                active.erase(victim);
+            }
+
+            auto r        = static_cast<Register>(chosen);
+            out.values[v] = {.kind = Location::Reg, .reg = r};
+            free &= static_cast<uint16_t>(~bit(r));
+            if (callee_mask & bit(r))
+                out.saved |= bit(r);
+            active.push_back({v, start, end});
+        }
+    }
+
+    // Spilled intervals share stack slots the same way registers are
+    // shared. They were spilled out of order, so they are sorted first.
+    std::sort(spills.begin(), spills.end(), [](const Interval& a, const Interval& b) { return a.start < b.start; });
+
+    using Busy = std::pair<uint32_t, uint32_t>; // end, slot
+    std::priority_queue<Busy, std::vector<Busy>, std::greater<>> busy;
+    std::vector<uint32_t> free_slots;
+    for (const Interval& s : spills) {
+        while (!busy.empty() && busy.top().first <= s.start) {
+            free_slots.push_back(busy.top().second);
+            busy.pop();
+        }
+
+        uint32_t slot = out.slots;
+        if (free_slots.empty())
+            out.slots++;
+        else {
+            slot = free_slots.back();
+            free_slots.pop_back();
+        }
+        out.values[s.v] = {.kind = Location::Stack, .slot = slot};
+        busy.push({s.end, slot});
+    }
+    out.spilled = static_cast<uint32_t>(spills.size());
+
+    return out;
+}
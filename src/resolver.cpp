@@ -0,0 +1,192 @@
+#include "resolver.hpp"
+#include "error.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <string>
+
+Resolver::Resolver(const Source& source, Arena& arena, Interner& interner)
+    : source(source), arena(arena), interner(interner), null_symbol(interner.intern("null")) {}
+
+void Resolver::resolve(std::span<FunctionDecl* const> fns) {
+    Arena::Mark start = arena.mark();
+    scope             = nullptr;
+
+    open(static_cast<uint32_t>(fns.size()) + 1);
+    declare(null_symbol, DeclKind::Builtin, nullptr);
+
+    for (FunctionDecl* fn : fns) {
+        if (!declare(fn->name, DeclKind::Function, fn))
+            throw CompileError("error: function `" + std::string(interner.view(fn->name)) +
+                               "` is defined more than once");
+    }
+
+    for (FunctionDecl* fn : fns) {
+        Arena::Mark tables = arena.mark();
+        function(fn);
+        arena.rollback(tables);
+    }
+
+    scope = nullptr;
+    arena.rollback(start);
+}
+
+// Sized for `expected` names at no more than half load, so probes stay short
+// and the table never grows.
+void Resolver::open(uint32_t expected) {
+    uint32_t bits     = std::bit_width(std::max<uint32_t>(expected, 1)) + 1;
+    uint32_t capacity = 1u << bits;
+
+    Table* t  = arena.alloc<Table>();
+    t->parent = scope;
+    t->slots  = reinterpret_cast<Entry*>(arena.alloc_bytes(sizeof(Entry) * capacity, alignof(Entry)));
+    t->mask   = capacity - 1;
+    t->shift  = 32 - bits;
+
+    for (uint32_t i = 0; i < capacity; i++)
+        t->slots[i].name = NoSymbol;
+
+    scope = t;
+}
+
+// Symbols are dense ids, so a Fibonacci multiply spreads them well enough.
+bool Resolver::declare(Symbol name, DeclKind kind, ASTNode* decl) {
+    Table* t = scope;
+    for (uint32_t i = (name * 0x9E3779B1u) >> t->shift;; i = (i + 1) & t->mask) {
+        Entry& e = t->slots[i];
+        if (e.name == NoSymbol) {
+            e = {name, kind, decl};
+            return true;
+        }
+        if (e.name == name) {
+            e = {name, kind, decl};
+            return false;
+        }
+    }
+}
+
+const Resolver::Entry* Resolver::lookup(Symbol name) const {
+    for (const Table* t = scope; t; t = t->parent) {
+        for (uint32_t i = (name * 0x9E3779B1u) >> t->shift;; i = (i + 1) & t->mask) {
+            const Entry& e = t->slots[i];
+            if (e.name == name)
+                return &e;
+            if (e.name == NoSymbol)
+                break;
+        }
+    }
+    return nullptr;
+}
+
+void Resolver::redefined(const char* what, Symbol name, uint32_t offset) const {
+    throw CompileError("error: " + std::string(what) + " `" + std::string(interner.view(name)) +
+                       "` is defined more than once in function `" + std::string(interner.view(current->name)) +
+                       "` on " + source.locate(current->span.begin + offset).str());
+}
+
+void Resolver::function(FunctionDecl* fn) {
+    current = fn;
+
+    open(static_cast<uint32_t>(fn->params.size()));
+    for (Param* p : fn->params) {
+        if (!declare(p->name, DeclKind::Param, p))
+            redefined("parameter", p->name, p->offset);
+    }
+
+    block(fn->body);
+    close();
+}
+
+void Resolver::block(ScopeStmt* s) {
+    uint32_t lets = 0;
+    for (const Stmt* st : s->statements)
+        lets += st->kind == StmtKind::Let;
+
+    // Scopes without declarations add nothing to search.
+    if (lets)
+        open(lets);
+
+    for (Stmt* st : s->statements)
+        stmt(st);
+
+    if (lets)
+        close();
+}
+
+void Resolver::stmt(Stmt* s) {
+    switch (s->kind) {
+
+    case StmtKind::Let: {
+        auto* let = static_cast<LetStmt*>(s);
+        expr(let->expr); // the initializer still sees any outer `name`
+        if (!declare(let->name, DeclKind::Let, let))
+            redefined("variable", let->name, let->offset);
+        break;
+    }
+
+    case StmtKind::Return:
+        expr(static_cast<ReturnStmt*>(s)->value);
+        break;
+
+    case StmtKind::Expr:
+        expr(static_cast<ExprStmt*>(s)->expr);
+        break;
+
+    case StmtKind::Scope:
+        block(static_cast<ScopeStmt*>(s));
+        break;
+
+    case StmtKind::If: {
+        auto* if_stmt = static_cast<IfStmt*>(s);
+        expr(if_stmt->condition);
+        stmt(if_stmt->then_branch);
+        if (if_stmt->else_branch)
+            stmt(if_stmt->else_branch);
+        break;
+    }
+    }
+}
+
+void Resolver::expr(Expr* e) {
+    switch (e->kind) {
+
+    case ExprKind::Identifier: {
+        auto* id       = static_cast<IdentifierExpr*>(e);
+        const Entry* d = lookup(id->name);
+        if (!d) {
+            throw CompileError("error: undefined identifier `" + std::string(interner.view(id->name)) +
+                               "` in function `" + std::string(interner.view(current->name)) + "` on " +
+                               source.locate(current->span.begin + id->offset).str());
+        }
+        id->decl_kind = d->kind;
+        id->decl      = d->decl;
+        break;
+    }
+
+    case ExprKind::Literal:
+        break;
+
+    case ExprKind::Binary: {
+        auto* bin = static_cast<BinaryExpr*>(e);
+        expr(bin->left);
+        expr(bin->right);
+        break;
+    }
+
+    case ExprKind::Unary:
+        expr(static_cast<UnaryExpr*>(e)->expr);
+        break;
+
+    case ExprKind::Paren:
+        expr(static_cast<ParenExpr*>(e)->expr);
+        break;
+
+    case ExprKind::Call: {
+        auto* call = static_cast<CallExpr*>(e);
+        expr(call->called);
+        for (Expr* arg : call->args)
+            expr(arg);
+        break;
+    }
+    }
+}
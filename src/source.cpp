@@ -0,0 +1,106 @@
+#include "source.hpp"
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+Source::Source(const char* path) : file_path(path) {
+    bool from_stdin = std::strcmp(path, "-") == 0;
+    int fd          = from_stdin ? STDIN_FILENO : open(path, O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0) {
+        error_message = std::string("error opening file ") + path + ": " + std::strerror(errno);
+        return;
+    }
+
+    struct stat st;
+    bool loaded = false;
+
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+        loaded = map_file(fd, st.st_size);
+    if (!loaded)
+        loaded = read_stream(fd);
+
+    if (!loaded)
+        error_message = std::string("error: could not read entire file ") + path;
+
+    if (!from_stdin)
+        close(fd);
+}
+
+Source::Source(const char* name, std::string_view text) : file_path(name) {
+    char* data = new char[text.size() + padding];
+    std::memcpy(data, text.data(), text.size());
+    std::memset(data + text.size(), 0, padding);
+
+    buffer = data;
+    length = text.size();
+}
+
+Source::~Source() {
+    if (mapped)
+        munmap(const_cast<char*>(buffer), mapped);
+    else
+        delete[] buffer;
+}
+
+// Reserves the file size plus one page of anonymous zeroed memory, then maps
+// the file over the front of it. The page after the file is never written,
+// so the sentinel and padding come for free from the kernel.
+bool Source::map_file(int fd, size_t size) {
+    size_t page  = sysconf(_SC_PAGESIZE);
+    size_t total = (size + page - 1) / page * page + page;
+
+    void* region = mmap(nullptr, total, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (region == MAP_FAILED)
+        return false;
+
+    void* file = mmap(region, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0);
+    if (file == MAP_FAILED) {
+        munmap(region, total);
+        return false;
+    }
+
+    madvise(file, size, MADV_SEQUENTIAL);
+
+    buffer = static_cast<const char*>(file);
+    length = size;
+    mapped = total;
+    return true;
+}
+
+bool Source::read_stream(int fd) {
+    size_t capacity = 64 * 1024;
+    size_t size     = 0;
+    char* data      = new char[capacity + padding];
+
+    while (true) {
+        if (size == capacity) {
+            char* grown = new char[capacity * 2 + padding];
+            std::memcpy(grown, data, size);
+            delete[] data;
+            data = grown;
+            capacity *= 2;
+        }
+
+        ssize_t n = read(fd, data + size, capacity - size);
+        if (n == 0)
+            break;
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            delete[] data;
+            return false;
+        }
+        size += n;
+    }
+
+    std::memset(data + size, 0, padding);
+    buffer = data;
+    length = size;
+    return true;
+}
@@ -0,0 +1,231 @@
+#include "stats.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <numeric>
+
+namespace {
+
+struct NodeCounter {
+    Stats& stats;
+
+    void type(const TypeNode* t) {
+        stats.types++;
+        for (const TypeNode* arg : t->types)
+            type(arg);
+    }
+
+    void expr(const Expr* e) {
+        stats.exprs[static_cast<size_t>(e->kind)]++;
+
+        switch (e->kind) {
+        case ExprKind::Binary: {
+            auto* bin = static_cast<const BinaryExpr*>(e);
+            expr(bin->left);
+            expr(bin->right);
+            break;
+        }
+        case ExprKind::Unary:
+            expr(static_cast<const UnaryExpr*>(e)->expr);
+            break;
+        case ExprKind::Paren:
+            expr(static_cast<const ParenExpr*>(e)->expr);
+            break;
+        case ExprKind::Call: {
+            auto* call = static_cast<const CallExpr*>(e);
+            expr(call->called);
+            for (const Expr* arg : call->args)
+                expr(arg);
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    void stmt(const Stmt* s) {
+        stats.stmts[static_cast<size_t>(s->kind)]++;
+
+        switch (s->kind) {
+        case StmtKind::Let: {
+            auto* let = static_cast<const LetStmt*>(s);
+            type(let->type);
+            expr(let->expr);
+            break;
+        }
+        case StmtKind::Return:
+            expr(static_cast<const ReturnStmt*>(s)->value);
+            break;
+        case StmtKind::Expr:
+            expr(static_cast<const ExprStmt*>(s)->expr);
+            break;
+        case StmtKind::Scope:
+            for (const Stmt* st : static_cast<const ScopeStmt*>(s)->statements)
+                stmt(st);
+            break;
+        case StmtKind::If: {
+            auto* stmt_if = static_cast<const IfStmt*>(s);
+            expr(stmt_if->condition);
+            stmt(stmt_if->then_branch);
+            if (stmt_if->else_branch)
+                stmt(stmt_if->else_branch);
+            break;
+        }
+        }
+    }
+};
+
+const char* expr_names[] = {"Identifier", "Literal", "Binary", "Unary", "Paren", "Call"};
+const char* stmt_names[] = {"Let", "Return", "Expr", "Scope", "If"};
+const char* phase_names[] = {"load", "lex", "parse", "resolve", "codegen", "optimize", "run", "emit"};
+
+void line(std::ostream& out, const char* name, const char* value) {
+    char buf[96];
+    std::snprintf(buf, sizeof buf, "  %-22s %14s\n", name, value);
+    out << buf;
+}
+
+void line(std::ostream& out, const char* name, uint64_t value) {
+    line(out, name, std::to_string(value).c_str());
+}
+
+} // namespace
+
+void Stats::count_tokens(const Source& source, Arena& arena) {
+    Lexer lexer(source, arena);
+    for (Token t = lexer.next(); t.type != TokenType::FileEnd; t = lexer.next())
+        tokens[static_cast<size_t>(t.type)]++;
+}
+
+void Stats::count_tokens(const TokenArray& array) {
+    for (uint32_t i = 0; i + 1 < array.size(); i++)
+        tokens[static_cast<size_t>(array.type(i))]++;
+}
+
+void Stats::count_nodes(std::span<FunctionDecl* const> fns) {
+    NodeCounter counter{*this};
+    for (const FunctionDecl* fn : fns) {
+        functions++;
+        for (const Param* p : fn->params)
+            counter.type(p->type);
+        counter.type(fn->return_type);
+        counter.stmt(fn->body);
+    }
+}
+
+void Stats::count_nodes(const FlatView& ast) {
+    functions += ast.function_count;
+
+    for (uint32_t n = 0; n < ast.node_count; n++) {
+        NodeKind kind = ast.kind(n);
+        if (kind == NodeKind::Type)
+            types++;
+        else if (kind >= NodeKind::Let)
+            stmts[static_cast<size_t>(kind) - static_cast<size_t>(NodeKind::Let)]++;
+        else
+            exprs[static_cast<size_t>(kind)]++;
+    }
+}
+
+uint64_t Stats::node_count() const {
+    return std::accumulate(exprs.begin(), exprs.end(), uint64_t(0)) +
+           std::accumulate(stmts.begin(), stmts.end(), uint64_t(0)) + types;
+}
+
+void Stats::add_passes(std::span<const PassReport> reports) {
+    if (passes.empty()) {
+        passes.assign(reports.begin(), reports.end());
+        return;
+    }
+
+    for (size_t i = 0; i < reports.size(); i++) {
+        passes[i].changes += reports[i].changes;
+        passes[i].removed += reports[i].removed;
+        passes[i].seconds += reports[i].seconds;
+    }
+}
+
+void Stats::merge(const Stats& other) {
+    files += other.files;
+    bytes += other.bytes;
+    for (size_t i = 0; i < PhaseCount; i++)
+        seconds[i] += other.seconds[i];
+    for (size_t i = 0; i < token_kinds; i++)
+        tokens[i] += other.tokens[i];
+    for (size_t i = 0; i < expr_kinds; i++)
+        exprs[i] += other.exprs[i];
+    for (size_t i = 0; i < stmt_kinds; i++)
+        stmts[i] += other.stmts[i];
+    types += other.types;
+    unique_types += other.unique_types;
+    functions += other.functions;
+    ir_lowered += other.ir_lowered;
+    add_passes(other.passes);
+    tasks += other.tasks;
+    steals += other.steals;
+    cache_hits += other.cache_hits;
+    cache_misses += other.cache_misses;
+
+    lexer_arena_peak  = std::max(lexer_arena_peak, other.lexer_arena_peak);
+    parser_arena_peak = std::max(parser_arena_peak, other.parser_arena_peak);
+}
+
+void Stats::print(std::ostream& out) const {
+    char buf[32];
+
+    out << "phases (ms, summed over files and tasks)\n";
+    for (size_t i = 0; i < PhaseCount; i++) {
+        std::snprintf(buf, sizeof buf, "%.3f", seconds[i] * 1e3);
+        line(out, phase_names[i], buf);
+    }
+
+    out << "input\n";
+    line(out, "files", files);
+    line(out, "bytes", bytes);
+
+    out << "tokens\n";
+    for (size_t i = 0; i < token_kinds; i++) {
+        if (tokens[i])
+            line(out, type_to_string(static_cast<TokenType>(i)), tokens[i]);
+    }
+    line(out, "total", std::accumulate(tokens.begin(), tokens.end(), uint64_t(0)));
+
+    out << "nodes\n";
+    line(out, "functions", functions);
+    for (size_t i = 0; i < expr_kinds; i++)
+        line(out, expr_names[i], exprs[i]);
+    for (size_t i = 0; i < stmt_kinds; i++)
+        line(out, stmt_names[i], stmts[i]);
+    line(out, "Type", types);
+    if (unique_types)
+        line(out, "Type (distinct)", unique_types);
+    line(out, "total", node_count());
+
+    if (ir_lowered) {
+        uint64_t left = ir_lowered;
+        out << "ir (instructions)\n";
+        line(out, "lowered", ir_lowered);
+        for (const PassReport& pass : passes) {
+            std::snprintf(buf, sizeof buf, "-%llu", static_cast<unsigned long long>(pass.removed));
+            line(out, pass.name, buf);
+            left -= pass.removed;
+        }
+        line(out, "remaining", left);
+    }
+
+    if (tasks) {
+        out << "tasks\n";
+        line(out, "run", tasks);
+        line(out, "stolen", steals);
+    }
+
+    if (cache_hits || cache_misses) {
+        out << "code cache (functions)\n";
+        line(out, "hits", cache_hits);
+        line(out, "misses", cache_misses);
+    }
+
+    out << "arena high water (bytes)\n";
+    line(out, "lexer", lexer_arena_peak);
+    line(out, "parser", parser_arena_peak);
+}
@@ -0,0 +1,105 @@
+#include "task_scheduler.hpp"
+
+#include <algorithm>
+#include <bit>
+
+WorkDeque::WorkDeque(size_t capacity) {
+    rings.push_back(std::make_unique<Ring>(std::bit_ceil(std::max<size_t>(capacity, 2))));
+    ring.store(rings.back().get(), std::memory_order_relaxed);
+}
+
+void WorkDeque::push(uint64_t task) {
+    int64_t b = bottom.load(std::memory_order_relaxed);
+    int64_t t = top.load(std::memory_order_acquire);
+    Ring* r   = ring.load(std::memory_order_relaxed);
+
+    if (b - t >= static_cast<int64_t>(r->capacity())) {
+        auto bigger = std::make_unique<Ring>(r->capacity() * 2);
+        for (int64_t i = t; i < b; i++)
+            (*bigger)[i].store((*r)[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+
+        r = bigger.get();
+        rings.push_back(std::move(bigger));
+        ring.store(r, std::memory_order_release);
+    }
+
+    (*r)[b].store(task, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom.store(b + 1, std::memory_order_relaxed);
+}
+
+bool WorkDeque::pop(uint64_t& task) {
+    int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+    Ring* r   = ring.load(std::memory_order_relaxed);
+    bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top.load(std::memory_order_relaxed);
+
+    if (t > b) {
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return false;
+    }
+
+    task = (*r)[b].load(std::memory_order_relaxed);
+    if (t < b)
+        return true;
+
+    // The last task: a thief may be taking it too.
+    bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+    bottom.store(b + 1, std::memory_order_relaxed);
+    return won;
+}
+
+bool WorkDeque::steal(uint64_t& task) {
+    int64_t t = top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = bottom.load(std::memory_order_acquire);
+
+    if (t >= b)
+        return false;
+
+    Ring* r = ring.load(std::memory_order_acquire);
+    task    = (*r)[t].load(std::memory_order_relaxed);
+    return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+}
+
+TaskScheduler::TaskScheduler(unsigned workers) {
+    for (unsigned i = 0; i < std::max(workers, 1u); i++)
+        deques.push_back(std::make_unique<WorkDeque>());
+}
+
+void TaskScheduler::spawn(unsigned worker, uint64_t task) {
+    pending.fetch_add(1, std::memory_order_relaxed);
+    deques[worker]->push(task);
+}
+
+bool TaskScheduler::next(unsigned worker, uint32_t& random, uint64_t& task) {
+    if (deques[worker]->pop(task))
+        return true;
+
+    size_t n = deques.size();
+    if (n == 1)
+        return false;
+
+    // xorshift32, so workers that run dry together spread their steals.
+    random ^= random << 13;
+    random ^= random >> 17;
+    random ^= random << 5;
+
+    size_t first = random % n;
+    for (size_t i = 0; i < n; i++) {
+        size_t victim = (first + i) % n;
+        if (victim != worker && deques[victim]->steal(task)) {
+            stolen.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+void TaskScheduler::fail(std::exception_ptr e) {
+    std::lock_guard lock(error_mutex);
+    if (!error)
+        error = e;
+    failed.store(true, std::memory_order_relaxed);
+}
@@ -0,0 +1,25 @@
+#include "token_array.hpp"
+#include "arena.hpp"
+#include "error.hpp"
+
+#include <string>
+
+TokenArray::TokenArray(const Source& source) : input(source), base(source.begin()) {
+    // Typical programs average a little over four bytes per token.
+    tokens.reserve(source.size() / 4 + 1);
+
+    Arena unused; // views into the source never touch the lexer arena
+    Lexer lexer(source, unused);
+
+    while (true) {
+        Token t       = lexer.next();
+        uint32_t size = static_cast<uint32_t>(t.value.size());
+
+        if (t.value.size() > max_length)
+            throw CompileError("token too long on " + source.locate(t.offset).str());
+
+        tokens.push_back({t.offset, static_cast<uint32_t>(t.type), size});
+        if (t.type == TokenType::FileEnd)
+            break;
+    }
+}
@@ -0,0 +1,70 @@
+#include "trace.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+
+namespace {
+
+// Small dense ids read better in the viewer than native thread ids.
+uint32_t thread_index() {
+    static std::atomic<uint32_t> next{0};
+    thread_local uint32_t index = next++;
+    return index;
+}
+
+void append_escaped(std::string& out, std::string_view s) {
+    for (char c : s) {
+        if (c == '"' || c == '\\')
+            out += '\\';
+        out += c;
+    }
+}
+
+void append_us(std::string& out, int64_t ns) {
+    char buf[32];
+    std::snprintf(buf, sizeof buf, "%lld.%03lld", static_cast<long long>(ns / 1000),
+                  static_cast<long long>(ns % 1000));
+    out += buf;
+}
+
+} // namespace
+
+void Trace::complete(std::string_view name, const char* category, Clock::time_point start) {
+    Clock::time_point end = Clock::now();
+
+    Event event{std::string(name), category,
+                std::chrono::duration_cast<std::chrono::nanoseconds>(start - origin).count(),
+                std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count(), thread_index()};
+
+    std::lock_guard lock(mutex);
+    events.push_back(std::move(event));
+}
+
+bool Trace::write(const char* path) const {
+    std::string out = "{\"traceEvents\":[\n";
+
+    {
+        std::lock_guard lock(mutex);
+        for (size_t i = 0; i < events.size(); i++) {
+            const Event& e = events[i];
+
+            out += "{\"name\":\"";
+            append_escaped(out, e.name);
+            out += "\",\"cat\":\"";
+            out += e.category;
+            out += "\",\"ph\":\"X\",\"pid\":1,\"tid\":";
+            out += std::to_string(e.thread);
+            out += ",\"ts\":";
+            append_us(out, e.start_ns);
+            out += ",\"dur\":";
+            append_us(out, e.duration_ns);
+            out += i + 1 < events.size() ? "},\n" : "}\n";
+        }
+    }
+    out += "],\"displayTimeUnit\":\"ms\"}\n";
+
+    std::ofstream file(path, std::ios::binary);
+    file << out;
+    return static_cast<bool>(file);
+}
@@ -0,0 +1,57 @@
+#include "type_table.hpp"
+#include "hash.hpp"
+#include "parser.hpp"
+
+#include <algorithm>
+
+TypeTable::TypeTable() : storage(4 * 1024), slots(256, Slot{0, empty}), mask(256 - 1) {}
+
+// Arguments are already canonical, so their ids identify them; ids rather
+// than addresses keep the table layout the same from run to run.
+uint32_t TypeTable::hash(Symbol name, std::span<const TypeNode* const> args) noexcept {
+    uint64_t h = hash_mix(name ^ (uint64_t(args.size()) << 32));
+    for (const TypeNode* arg : args)
+        h = hash_mix(h ^ arg->id);
+    return static_cast<uint32_t>(h);
+}
+
+const TypeNode* TypeTable::intern(Symbol name, std::span<const TypeNode* const> args) {
+    uint32_t h = hash(name, args);
+    uint32_t i = h & mask;
+
+    while (slots[i].id != empty) {
+        const TypeNode* t = nodes[slots[i].id];
+        if (slots[i].hash == h && t->name == name && std::ranges::equal(t->types, args))
+            return t;
+        i = (i + 1) & mask;
+    }
+
+    TypeNode* t = storage.alloc<TypeNode>();
+    t->name     = name;
+    t->id       = static_cast<uint32_t>(nodes.size());
+    t->types    = storage.copy_span(args.data(), args.size());
+
+    nodes.push_back(t);
+    slots[i] = Slot{h, t->id};
+
+    if (nodes.size() * 2 > slots.size())
+        grow();
+
+    return t;
+}
+
+void TypeTable::grow() {
+    std::vector<Slot> old = std::move(slots);
+    slots.assign(old.size() * 2, Slot{0, empty});
+    mask = static_cast<uint32_t>(slots.size() - 1);
+
+    for (const Slot& slot : old) {
+        if (slot.id == empty)
+            continue;
+
+        uint32_t i = slot.hash & mask;
+        while (slots[i].id != empty)
+            i = (i + 1) & mask;
+        slots[i] = slot;
+    }
+}
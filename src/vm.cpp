@@ -0,0 +1,171 @@
+#include "vm.hpp"
+#include "error.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <string>
+
+Vm::Vm(const Bytecode& code, const Interner& interner, size_t stack_registers)
+    : code(code), interner(interner), stack(std::make_unique<int64_t[]>(stack_registers)),
+      stack_size(stack_registers) {}
+
+void Vm::fail(const char* what, const Instr* pc) const {
+    // Functions are laid out in order, so the last one starting at or
+    // before `pc` is the one running.
+    uint32_t at = static_cast<uint32_t>(pc - code.code.data());
+    auto fn     = std::upper_bound(code.functions.begin(), code.functions.end(), at,
+                                   [](uint32_t at, const BytecodeFunction& f) { return at < f.entry; });
+
+    throw CompileError(std::string("runtime error: ") + what + " in function `" +
+                       std::string(interner.view(std::prev(fn)->name)) + "`");
+}
+
+namespace {
+
+int64_t wrap(uint64_t v) noexcept {
+    return static_cast<int64_t>(v);
+}
+
+} // namespace
+
+int64_t Vm::run(uint32_t function, std::span<const int64_t> args) {
+    const BytecodeFunction& entry = code.functions[function];
+    if (args.size() != entry.params) {
+        throw CompileError("runtime error: `" + std::string(interner.view(entry.name)) + "` takes " +
+                           std::to_string(entry.params) + " arguments but was given " +
+                           std::to_string(args.size()));
+    }
+
+    const Instr* const start = code.code.data();
+    const Instr* pc          = start + entry.entry;
+    int64_t* base            = stack.get();
+    int64_t* const limit     = stack.get() + stack_size;
+
+    if (base + entry.registers > limit)
+        fail("stack overflow", pc);
+    std::copy(args.begin(), args.end(), base);
+
+    frames.clear();
+    call_count++;
+
+    // Each handler ends by dispatching the next instruction itself. Without
+    // labels as values the same handlers become cases of a switch in a loop.
+#if defined(__GNUC__)
+    static const void* const labels[] = {
+        &&op_LoadInt, &&op_LoadConst, &&op_Move, &&op_Add,  &&op_Sub,         &&op_Mul,  &&op_Div,    &&op_Less,
+        &&op_Greater, &&op_Not,       &&op_Neg,  &&op_Jump, &&op_JumpIfFalse, &&op_Call, &&op_Return,
+    };
+    static_assert(std::size(labels) == op_count);
+
+#define VM_CASE(name) op_##name
+#define VM_DISPATCH() goto* labels[static_cast<size_t>(pc->op)]
+    VM_DISPATCH();
+#else
+#define VM_CASE(name) case Op::name
+#define VM_DISPATCH() continue
+    for (;;) {
+        switch (pc->op) {
+#endif
+
+    VM_CASE(LoadInt) : {
+        base[pc->a] = static_cast<int32_t>(pc->bc());
+        pc++;
+        VM_DISPATCH();
+    }
+    VM_CASE(LoadConst) : {
+        base[pc->a] = code.constants[pc->bc()];
+        pc++;
+        VM_DISPATCH();
+    }
+    VM_CASE(Move) : {
+        base[pc->a] = base[pc->b];
+        pc++;
+        VM_DISPATCH();
+    }
+    VM_CASE(Add) : {
+        base[pc->a] = wrap(uint64_t(base[pc->b]) + uint64_t(base[pc->c]));
+        pc++;
+        VM_DISPATCH();
+    }
+    VM_CASE(Sub) : {
+        base[pc->a] = wrap(uint64_t(base[pc->b]) - uint64_t(base[pc->c]));
+        pc++;
+        VM_DISPATCH();
+    }
+    VM_CASE(Mul) : {
+        base[pc->a] = wrap(uint64_t(base[pc->b]) * uint64_t(base[pc->c]));
+        pc++;
+        VM_DISPATCH();
+    }
+    VM_CASE(Div) : {
+        int64_t l = base[pc->b];
+        int64_t r = base[pc->c];
+        if (r == 0)
+            fail("division by zero", pc);
+        // The one quotient that overflows wraps like the other operators.
+        base[pc->a] = r == -1 ? wrap(0 - uint64_t(l)) : l / r;
+        pc++;
+        VM_DISPATCH();
+    }
+    VM_CASE(Less) : {
+        base[pc->a] = base[pc->b] < base[pc->c];
+        pc++;
+        VM_DISPATCH();
+    }
+    VM_CASE(Greater) : {
+        base[pc->a] = base[pc->b] > base[pc->c];
+        pc++;
+        VM_DISPATCH();
+    }
+    VM_CASE(Not) : {
+        base[pc->a] = base[pc->b] == 0;
+        pc++;
+        VM_DISPATCH();
+    }
+    VM_CASE(Neg) : {
+        base[pc->a] = wrap(0 - uint64_t(base[pc->b]));
+        pc++;
+        VM_DISPATCH();
+    }
+    VM_CASE(Jump) : {
+        pc = start + pc->bc();
+        VM_DISPATCH();
+    }
+    VM_CASE(JumpIfFalse) : {
+        pc = base[pc->a] ? pc + 1 : start + pc->bc();
+        VM_DISPATCH();
+    }
+    VM_CASE(Call) : {
+        const BytecodeFunction& callee = code.functions[pc->bc()];
+        int64_t* callee_base           = base + pc->a;
+        if (callee_base + callee.registers > limit)
+            fail("stack overflow", pc);
+
+        frames.push_back({pc + 1, base});
+        call_count++;
+        base = callee_base;
+        pc   = start + callee.entry;
+        VM_DISPATCH();
+    }
+    VM_CASE(Return) : {
+        int64_t value = base[pc->a];
+        if (frames.empty())
+            return value;
+
+        // The callee's first register is the caller's result register.
+        base[0]     = value;
+        Frame frame = frames.back();
+        frames.pop_back();
+        base = frame.base;
+        pc   = frame.return_pc;
+        VM_DISPATCH();
+    }
+
+#if !defined(__GNUC__)
+        }
+    }
+#endif
+
+#undef VM_CASE
+#undef VM_DISPATCH
+}
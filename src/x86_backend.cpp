@@ -0,0 +1,601 @@
+#include "x86_backend.hpp"
+#include "error.hpp"
+#include "regalloc.hpp"
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+constexpr const char* names64[] = {"%rax", "%rcx", "%rdx", "%rbx", "%rsp", "%rbp", "%rsi", "%rdi",
+                                   "%r8",  "%r9",  "%r10", "%r11", "%r12", "%r13", "%r14", "%r15"};
+constexpr const char* names32[] = {"%eax", "%ecx", "%edx", "%ebx", "%esp", "%ebp", "%esi", "%edi",
+                                   "%r8d", "%r9d", "%r10d", "%r11d", "%r12d", "%r13d", "%r14d", "%r15d"};
+constexpr const char* names8[]  = {"%al",  "%cl",  "%dl",   "%bl",   "%spl",  "%bpl",  "%sil",  "%dil",
+                                   "%r8b", "%r9b", "%r10b", "%r11b", "%r12b", "%r13b", "%r14b", "%r15b"};
+
+constexpr Register callee_saved[] = {Register::Rbx, Register::R12, Register::R13, Register::R14, Register::R15};
+constexpr size_t reg_args         = std::size(arg_registers);
+
+const char* name(Register r) {
+    return names64[static_cast<size_t>(r)];
+}
+
+// A value as an instruction operand: a register, memory at an offset from
+// %rbp, or an immediate.
+struct Operand {
+    enum Kind : uint8_t { None, Reg, Mem, Imm };
+
+    Kind kind    = None;
+    Register reg = Register::Rax;
+    int64_t n    = 0; // Mem offset or Imm value
+
+    static Operand of(Register r) { return {Reg, r, 0}; }
+    static Operand mem(int64_t offset) { return {Mem, Register::Rbp, offset}; }
+
+    bool is(Register r) const { return kind == Reg && reg == r; }
+    bool operator==(const Operand&) const = default;
+};
+
+const char* inverse(std::string_view cc) {
+    if (cc == "l")
+        return "ge";
+    if (cc == "g")
+        return "le";
+    if (cc == "e")
+        return "ne";
+    return "e";
+}
+
+// Values live where allocate_registers() put them. %rax and %r11 are
+// scratch: %rax holds results on their way to memory and breaks cycles in
+// parallel moves, %r11 carries memory-to-memory moves and divisors.
+class FunctionWriter {
+  public:
+    FunctionWriter(const IrModule& module, const Interner& names, Emitter& out, std::string& rodata)
+        : module(module), names(names), out(out), rodata(rodata) {}
+
+    void function(uint32_t index) {
+        f        = &module.functions[index];
+        alloc    = allocate_registers(*f);
+        code.clear();
+        stubs.clear();
+        labels   = 0;
+        div_zero = false;
+
+        saved.clear();
+        for (Register r : callee_saved) {
+            if (alloc.saved & (1u << static_cast<unsigned>(r)))
+                saved.push_back(r);
+        }
+
+        next.assign(f->blocks.size(), NoId);
+        for (size_t i = 0; i + 1 < alloc.order.size(); i++)
+            next[alloc.order[i]] = alloc.order[i + 1];
+
+        // Parameters move from where the ABI passes them to where the
+        // allocator put them.
+        std::vector<std::pair<Operand, Operand>> params;
+        for (ValueId v : f->blocks[0].insts) {
+            const IrInst& inst = f->insts[v];
+            if (inst.op != IrOp::Param || alloc.values[v].kind == Location::None)
+                continue;
+            Operand from = inst.a < reg_args ? Operand::of(arg_registers[inst.a])
+                                             : Operand::mem(16 + 8 * int64_t(inst.a - reg_args));
+            params.push_back({operand(v), from});
+        }
+        parallel_move(params);
+
+        for (BlockId b : alloc.order) {
+            place(block_label(b));
+            for (ValueId v : f->blocks[b].insts)
+                instruction(b, v);
+        }
+
+        if (div_zero) {
+            std::string message = "runtime error: division by zero in function `";
+            message += names.view(f->name);
+            message += "`\n";
+
+            stubs += local("div_zero") + ":\n";
+            stubs += "\tleaq " + local("message") + "(%rip), %rsi\n";
+            stubs += "\tmovl $" + std::to_string(message.size()) + ", %edx\n";
+            stubs += "\tjmp .Ldiv_zero\n";
+
+            rodata += local("message") + ":\n\t.ascii \"";
+            rodata += message.substr(0, message.size() - 1);
+            rodata += "\\n\"\n";
+        }
+
+        std::string sym = symbol(f->name);
+        out.put("\n\t.p2align 4\n\t.type ");
+        out.put(sym);
+        out.put(", @function\n");
+        out.put(sym);
+        out.put(":\n\tpushq %rbp\n\tmovq %rsp, %rbp\n");
+        for (Register r : saved) {
+            out.put("\tpushq ");
+            out.put(name(r));
+            out.put('\n');
+        }
+
+        // Padded so %rsp stays 16-byte aligned.
+        if (uint32_t slots = alloc.slots + (alloc.slots + saved.size()) % 2) {
+            out.put("\tsubq $");
+            out.put(std::to_string(8 * slots));
+            out.put(", %rsp\n");
+        }
+        out.put(code);
+        out.put(stubs);
+        out.put("\t.size ");
+        out.put(sym);
+        out.put(", .-");
+        out.put(sym);
+        out.put('\n');
+    }
+
+  private:
+    const IrModule& module;
+    const Interner& names;
+    Emitter& out;
+    std::string& rodata;
+
+    const IrFunction* f = nullptr;
+    Allocation alloc;
+    std::vector<Register> saved; // callee-saved registers pushed by the prologue
+    std::vector<BlockId> next;   // the block laid out after each block
+    std::string code;
+    std::string stubs; // edge moves and the division by zero exit, after the body
+    uint32_t labels = 0;
+    bool div_zero   = false;
+
+    // `fn.name`, the assembler symbol of a function.
+    std::string symbol(Symbol name) const {
+        std::string s = "fn.";
+        s += names.view(name);
+        return s;
+    }
+
+    // `.Lfn.<name>.<what>`, a label local to the function. Labels do not
+    // depend on where the function is in the file, so its code can be
+    // cached and reused when other functions move.
+    std::string local(std::string_view what) const {
+        std::string s = ".L";
+        s += symbol(f->name);
+        s += '.';
+        s += what;
+        return s;
+    }
+
+    std::string block_label(BlockId b) const {
+        std::string s = "b";
+        s += std::to_string(b);
+        return local(s);
+    }
+
+    std::string label() { return local(std::to_string(++labels)); }
+
+    void place(const std::string& label) {
+        code += label;
+        code += ":\n";
+    }
+
+    void op(std::string_view text) {
+        code += '\t';
+        code += text;
+        code += '\n';
+    }
+
+    Operand operand(ValueId v) const {
+        const Location& at = alloc.values[v];
+        switch (at.kind) {
+        case Location::Reg:
+            return Operand::of(at.reg);
+        case Location::Stack:
+            // Below the saved registers.
+            return Operand::mem(-8 * int64_t(saved.size() + 1 + at.slot));
+        case Location::Imm:
+            return {Operand::Imm, Register::Rax, at.imm};
+        case Location::None:
+            break;
+        }
+        return {};
+    }
+
+    static std::string text(const Operand& o) {
+        switch (o.kind) {
+        case Operand::Reg:
+            return name(o.reg);
+        case Operand::Mem:
+            return std::to_string(o.n) + "(%rbp)";
+        case Operand::Imm: {
+            std::string s = "$";
+            s += std::to_string(o.n);
+            return s;
+        }
+        case Operand::None:
+            break;
+        }
+        return {};
+    }
+
+    void move(const Operand& to, const Operand& from) {
+        if (to == from || to.kind == Operand::None)
+            return;
+
+        if (to.kind == Operand::Mem && from.kind == Operand::Mem) {
+            op("movq " + text(from) + ", %r11");
+            op("movq %r11, " + text(to));
+        }
+        else if (to.kind == Operand::Reg && from.kind == Operand::Imm && from.n == 0) {
+            std::string r = names32[static_cast<size_t>(to.reg)];
+            op("xorl " + r + ", " + r);
+        }
+        else {
+            op("movq " + text(from) + ", " + text(to));
+        }
+    }
+
+    // Performs all moves as if at once: no destination is written before
+    // every move reading it has been done. Cycles go through %rax.
+    void parallel_move(std::vector<std::pair<Operand, Operand>>& moves) {
+        std::erase_if(moves, [](const auto& m) { return m.first == m.second; });
+
+        while (!moves.empty()) {
+            auto ready = std::find_if(moves.begin(), moves.end(), [&](const auto& m) {
+                return std::none_of(moves.begin(), moves.end(), [&](const auto& other) { return other.second == m.first; });
+            });
+
+            if (ready == moves.end()) {
+                // Everything left is in cycles. Saving one destination in
+                // %rax frees it.
+                Operand blocked = moves.front().first;
+                move(Operand::of(Register::Rax), blocked);
+                for (auto& m : moves) {
+                    if (m.second == blocked)
+                        m.second = Operand::of(Register::Rax);
+                }
+                continue;
+            }
+
+            move(ready->first, ready->second);
+            moves.erase(ready);
+        }
+    }
+
+    bool has_phis(BlockId b) const { return f->insts[f->blocks[b].insts[0]].op == IrOp::Phi; }
+
+    // Sets the phis of `to` for arriving from `from`.
+    void edge_moves(BlockId from, BlockId to) {
+        std::vector<std::pair<Operand, Operand>> moves;
+        for (ValueId v : f->blocks[to].insts) {
+            const IrInst& phi = f->insts[v];
+            if (phi.op != IrOp::Phi)
+                break;
+            for (uint32_t i = 0; i < phi.count; i++) {
+                if (f->operands[phi.args + 2 * i] == from)
+                    moves.push_back({operand(v), operand(f->operands[phi.args + 2 * i + 1])});
+            }
+        }
+        parallel_move(moves);
+    }
+
+    // Where a branch from `from` to `to` jumps: the block itself, or a stub
+    // after the body that sets the phis of `to` first.
+    std::string edge(BlockId from, BlockId to) {
+        if (!has_phis(to))
+            return block_label(to);
+
+        std::string stub = block_label(from) + ".b" + std::to_string(to);
+        std::string body;
+        std::swap(code, body);
+        place(stub);
+        edge_moves(from, to);
+        op("jmp " + block_label(to));
+        std::swap(code, body);
+
+        stubs += body;
+        return stub;
+    }
+
+    void jump(BlockId from, BlockId to) {
+        edge_moves(from, to);
+        if (next[from] != to)
+            op("jmp " + block_label(to));
+    }
+
+    // Loads `o` into `scratch` unless it is already usable where a register
+    // or memory operand is required.
+    Operand in_place(const Operand& o, Register scratch) {
+        if (o.kind != Operand::Imm)
+            return o;
+        move(Operand::of(scratch), o);
+        return Operand::of(scratch);
+    }
+
+    // Sets the flags for `c` and returns the condition code that holds when
+    // it is true.
+    std::string compare(const IrInst& c) {
+        Operand a = operand(c.a);
+        if (c.op == IrOp::Eqz || c.op == IrOp::Nez) {
+            test(in_place(a, Register::Rax));
+            return c.op == IrOp::Eqz ? "e" : "ne";
+        }
+
+        Operand b      = operand(c.b);
+        std::string cc = c.op == IrOp::Lt ? "l" : "g";
+        if (a.kind == Operand::Imm && b.kind != Operand::Imm) {
+            std::swap(a, b);
+            cc = cc == "l" ? "g" : "l";
+        }
+        else if (a.kind == Operand::Imm || (a.kind == Operand::Mem && b.kind == Operand::Mem)) {
+            move(Operand::of(Register::Rax), a);
+            a = Operand::of(Register::Rax);
+        }
+        op("cmpq " + text(b) + ", " + text(a));
+        return cc;
+    }
+
+    void test(const Operand& o) {
+        if (o.kind == Operand::Reg)
+            op("testq " + text(o) + ", " + text(o));
+        else
+            op("cmpq $0, " + text(o));
+    }
+
+    void instruction(BlockId b, ValueId v) {
+        const IrInst& inst = f->insts[v];
+        Operand dst        = operand(v);
+
+        switch (inst.op) {
+        case IrOp::Const:
+            if (dst.kind == Operand::Reg) {
+                op("movabsq $" + std::to_string(inst.imm) + ", " + text(dst));
+            }
+            else if (dst.kind == Operand::Mem) {
+                op("movabsq $" + std::to_string(inst.imm) + ", %rax");
+                move(dst, Operand::of(Register::Rax));
+            }
+            break;
+        case IrOp::Add:
+        case IrOp::Sub:
+        case IrOp::Mul:
+            if (dst.kind != Operand::None)
+                arithmetic(inst, dst);
+            break;
+        case IrOp::Div:
+            divide(inst, dst);
+            break;
+        case IrOp::Lt:
+        case IrOp::Gt:
+        case IrOp::Eqz:
+        case IrOp::Nez: {
+            if (alloc.fused[v] || dst.kind == Operand::None)
+                break;
+            std::string cc = compare(inst);
+            Register r     = dst.kind == Operand::Reg ? dst.reg : Register::Rax;
+            op("set" + cc + " " + names8[static_cast<size_t>(r)]);
+            op(std::string("movzbl ") + names8[static_cast<size_t>(r)] + ", " + names32[static_cast<size_t>(r)]);
+            move(dst, Operand::of(r));
+            break;
+        }
+        case IrOp::ZExt:
+            move(dst, operand(inst.a));
+            break;
+        case IrOp::Neg:
+            if (dst.kind != Operand::None) {
+                Operand r = dst.kind == Operand::Reg ? dst : Operand::of(Register::Rax);
+                move(r, operand(inst.a));
+                op("negq " + text(r));
+                move(dst, r);
+            }
+            break;
+        case IrOp::Call:
+            call(inst, dst);
+            break;
+        case IrOp::Jump:
+            jump(b, inst.a);
+            break;
+        case IrOp::Branch:
+            branch(b, inst);
+            break;
+        case IrOp::Ret:
+            move(Operand::of(Register::Rax), operand(inst.a));
+            if (saved.empty()) {
+                op("leave");
+            }
+            else {
+                op("leaq " + std::to_string(-8 * int64_t(saved.size())) + "(%rbp), %rsp");
+                for (auto r = saved.rbegin(); r != saved.rend(); ++r)
+                    op(std::string("popq ") + name(*r));
+                op("popq %rbp");
+            }
+            op("ret");
+            break;
+        case IrOp::Param: // moved in on entry
+        case IrOp::Phi:   // set by the edges into the block
+        case IrOp::Nop:
+            break;
+        }
+    }
+
+    // dst = a `op` b, computed in dst's register, or %rax when dst is in
+    // memory or is `b` of a subtraction.
+    void arithmetic(const IrInst& inst, const Operand& dst) {
+        Operand a = operand(inst.a);
+        Operand b = operand(inst.b);
+        Operand r = dst.kind == Operand::Reg ? dst : Operand::of(Register::Rax);
+
+        if (b == r && inst.op != IrOp::Sub)
+            std::swap(a, b);
+        if (b == r)
+            r = Operand::of(Register::Rax);
+
+        const char* mnemonic = inst.op == IrOp::Add ? "addq " : inst.op == IrOp::Sub ? "subq " : "imulq ";
+        move(r, a);
+        op(mnemonic + text(b) + ", " + text(r));
+        move(dst, r);
+    }
+
+    // idiv faults on a zero divisor and on INT64_MIN / -1, so both are
+    // checked unless the divisor is a constant that is neither. The divisor
+    // must not be an immediate, nor in %rdx, which cqto overwrites.
+    void divide(const IrInst& inst, const Operand& dst) {
+        Operand b = operand(inst.b);
+        bool safe = b.kind == Operand::Imm && b.n != 0 && b.n != -1;
+        if (b.kind == Operand::Imm || b.is(Register::Rdx)) {
+            move(Operand::of(Register::R11), b);
+            b = Operand::of(Register::R11);
+        }
+        move(Operand::of(Register::Rax), operand(inst.a));
+
+        if (safe) {
+            op("cqto");
+            op("idivq " + text(b));
+        }
+        else {
+            div_zero            = true;
+            std::string general = label();
+            std::string done    = label();
+
+            test(b);
+            op("je " + local("div_zero"));
+            op("cmpq $-1, " + text(b));
+            op("jne " + general);
+            op("negq %rax");
+            op("jmp " + done);
+            place(general);
+            op("cqto");
+            op("idivq " + text(b));
+            place(done);
+        }
+        move(dst, Operand::of(Register::Rax));
+    }
+
+    void branch(BlockId b, const IrInst& inst) {
+        std::string cc;
+        if (alloc.fused[inst.a]) {
+            cc = compare(f->insts[inst.a]);
+        }
+        else {
+            Operand cond = operand(inst.a);
+            if (cond.kind == Operand::Imm) {
+                jump(b, cond.n ? inst.b : inst.c);
+                return;
+            }
+            test(cond);
+            cc = "ne";
+        }
+
+        std::string then_to = edge(b, inst.b);
+        std::string else_to = edge(b, inst.c);
+        if (then_to == block_label(next[b])) {
+            op("j" + std::string(inverse(cc)) + " " + else_to);
+            return;
+        }
+
+        op("j" + cc + " " + then_to);
+        if (else_to != block_label(next[b]))
+            op("jmp " + else_to);
+    }
+
+    void call(const IrInst& inst, const Operand& dst) {
+        // Stack arguments are pushed last first, so the seventh ends up on
+        // top, where the callee expects it.
+        size_t n          = inst.count;
+        size_t stack_args = n > reg_args ? n - reg_args : 0;
+        size_t pad        = stack_args % 2;
+        if (pad)
+            op("subq $8, %rsp");
+        for (size_t i = n; i-- > reg_args;)
+            op("pushq " + text(operand(f->operands[inst.args + i])));
+
+        std::vector<std::pair<Operand, Operand>> moves;
+        for (size_t i = 0; i < std::min(n, reg_args); i++)
+            moves.push_back({Operand::of(arg_registers[i]), operand(f->operands[inst.args + i])});
+        parallel_move(moves);
+
+        op("call " + symbol(module.functions[inst.a].name));
+        if (size_t bytes = 8 * (pad + stack_args))
+            op("addq $" + std::to_string(bytes) + ", %rsp");
+        move(dst, Operand::of(Register::Rax));
+    }
+};
+
+} // namespace
+
+X86Function write_x86_function(const IrModule& module, const Interner& interner, uint32_t index) {
+    X86Function result;
+    Emitter text(interner);
+    FunctionWriter(module, interner, text, result.rodata).function(index);
+    result.text = text.take();
+    return result;
+}
+
+void write_x86(const IrModule& module, const Interner& interner, Emitter& out) {
+    std::vector<X86Function> functions;
+    functions.reserve(module.functions.size());
+    for (uint32_t i = 0; i < module.functions.size(); i++)
+        functions.push_back(write_x86_function(module, interner, i));
+
+    write_x86(module, interner, functions, out);
+}
+
+void write_x86(const IrModule& module, const Interner& interner, std::span<const X86Function> functions,
+               Emitter& out) {
+    const IrFunction* main = nullptr;
+    for (const IrFunction& f : module.functions) {
+        if (interner.view(f.name) == "main")
+            main = &f;
+    }
+    if (!main)
+        throw CompileError("error: no `main` function");
+
+    out.put("\t.text\n");
+    for (const X86Function& f : functions)
+        out.put(f.text);
+
+    // The C entry point: calls the program's main with zeros and prints the
+    // result.
+    out.put("\n\t.globl main\n\t.type main, @function\nmain:\n\tpushq %rbp\n\tmovq %rsp, %rbp\n");
+
+    size_t n          = main->params;
+    size_t stack_args = n > reg_args ? n - reg_args : 0;
+    if (stack_args % 2)
+        out.put("\tsubq $8, %rsp\n");
+    for (size_t i = 0; i < stack_args; i++)
+        out.put("\tpushq $0\n");
+    for (size_t i = 0; i < std::min(n, reg_args); i++) {
+        out.put("\tmovq $0, ");
+        out.put(name(arg_registers[i]));
+        out.put('\n');
+    }
+
+    out.put("\tcall fn.");
+    out.put(interner.view(main->name));
+    out.put("\n\tmovq %rax, %rsi\n"
+            "\tleaq .Lformat(%rip), %rdi\n"
+            "\txorl %eax, %eax\n"
+            "\tcall printf@PLT\n"
+            "\txorl %eax, %eax\n"
+            "\tleave\n"
+            "\tret\n"
+            "\t.size main, .-main\n");
+
+    // Reached with the message in %rsi and its length in %rdx: write(2, ...)
+    // then exit(1), straight through system calls.
+    out.put("\n.Ldiv_zero:\n"
+            "\tmovl $1, %eax\n"
+            "\tmovl $2, %edi\n"
+            "\tsyscall\n"
+            "\tmovl $60, %eax\n"
+            "\tmovl $1, %edi\n"
+            "\tsyscall\n");
+
+    out.put("\n\t.section .rodata\n.Lformat:\n\t.string \"%ld\\n\"\n");
+    for (const X86Function& f : functions)
+        out.put(f.rodata);
+    out.put("\n\t.section .note.GNU-stack,\"\",@progbits\n");
+}
@@ -0,0 +1,32 @@
+#!/bin/sh
+# Compiles one program to assembly, assembles and runs it with the system
+# compiler, and checks that it prints what `main --run` prints and fails
+# exactly when the interpreter does. A program that does not compile must
+# fail the same way under both.
+#
+#     native.sh <path to main> <program>
+
+main=$1
+input=$2
+dir=$(mktemp -d) || exit 1
+trap 'rm -rf "$dir"' EXIT
+
+expected=$("$main" --run "$input" 2>&1)
+expected_status=$?
+
+if ! "$main" --emit=asm "$input" > "$dir/prog.s" 2> "$dir/error"; then
+    actual=$(cat "$dir/error")
+    actual_status=1
+else
+    cc "$dir/prog.s" -o "$dir/prog" || exit 1
+    actual=$("$dir/prog" 2>&1)
+    actual_status=$?
+fi
+
+if [ "$expected" != "$actual" ] || [ $((expected_status == 0)) -ne $((actual_status == 0)) ]; then
+    echo "--run printed (status $expected_status):"
+    echo "$expected"
+    echo "native run printed (status $actual_status):"
+    echo "$actual"
+    exit 1
+fi
@@ -0,0 +1,147 @@
+#include "check.hpp"
+
+#include "fixtures.hpp"
+
+#include "arena.hpp"
+#include "ast_cache.hpp"
+#include "flat_ast.hpp"
+#include "interner.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+#include "source.hpp"
+#include "type_table.hpp"
+
+#include <atomic>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr const char* program = R"(
+function divide(a: u32, b: u32) => optional<f32> {
+    if !b {
+        return null;
+    }
+    return a / b;
+}
+
+function main(argc: u32, argv: array<string>) => i32 {
+    let x: u32 = 5;
+    return divide(x, 1);
+}
+)";
+
+// A source file in a fresh directory, removed with it.
+struct TempSource {
+    TempDir temp;
+    std::string path  = (temp.dir / "prog.txt").string();
+    std::string cache = AstCache::path_for(path.c_str());
+
+    TempSource() { std::ofstream(path) << program; }
+};
+
+bool write_cache(const TempSource& file) {
+    Source source(file.path.c_str());
+    Arena lexer_arena;
+    Arena parser_arena;
+    Interner interner;
+    TypeTable types;
+    Lexer lexer(source, lexer_arena);
+    Parser parser(lexer, parser_arena, interner, types);
+    FlatAst ast = parser.parse_flat();
+    return AstCache::write(file.cache.c_str(), source, ast.view(), interner);
+}
+
+} // namespace
+
+TEST(ast_cache_round_trips) {
+    TempSource file;
+    CHECK(write_cache(file));
+
+    AstCache cache(file.cache.c_str());
+    CHECK(cache.ok());
+    CHECK(cache.fresh_for(file.path.c_str()));
+
+    Interner names;
+    FlatView view = cache.load(names);
+    CHECK(view.function_count == 2);
+    CHECK(names.view(view.funcs()[1].name) == "main");
+}
+
+TEST(corrupt_ast_cache_is_a_miss) {
+    TempSource file;
+    CHECK(write_cache(file));
+
+    std::string bytes;
+    {
+        std::ifstream in(file.cache, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(in), {});
+    }
+    for (size_t i = bytes.size() / 3; i < bytes.size() * 2 / 3; i++)
+        bytes[i] = char(0xff);
+    std::ofstream(file.cache, std::ios::binary) << bytes;
+    CHECK(!AstCache(file.cache.c_str()).ok());
+
+    bytes.resize(bytes.size() / 2);
+    std::ofstream(file.cache, std::ios::binary | std::ios::trunc) << bytes;
+    CHECK(!AstCache(file.cache.c_str()).ok());
+}
+
+// Written by AstCache itself, so the hash matches, but the tree is not one
+// the parser could build.
+TEST(ast_cache_rejects_bad_indices) {
+    TempSource file;
+    Source source(file.path.c_str());
+    Interner names;
+    Symbol x = names.intern("x");
+
+    auto rejected = [&](auto build) {
+        FlatAst ast;
+        build(ast);
+        CHECK(AstCache::write(file.cache.c_str(), source, ast.view(), names));
+        return !AstCache(file.cache.c_str()).ok();
+    };
+
+    CHECK(!rejected([&](FlatAst& ast) { ast.add(NodeKind::Identifier, x); }));
+    CHECK(rejected([&](FlatAst& ast) { ast.add(NodeKind::Identifier, x + 1); }));
+    CHECK(rejected([&](FlatAst& ast) { ast.add(NodeKind::Binary, 0, 7, TokenType::Plus); }));
+    CHECK(rejected([&](FlatAst& ast) {
+        NodeIndex id = ast.add(NodeKind::Identifier, x);
+        ast.add(NodeKind::Binary, id, id, TokenType(200));
+    }));
+    CHECK(rejected([&](FlatAst& ast) {
+        NodeIndex type = ast.add(NodeKind::Type, x, 0);
+        ast.add(NodeKind::Return, type);
+    }));
+    CHECK(rejected([&](FlatAst& ast) {
+        NodeIndex id        = ast.add(NodeKind::Identifier, x);
+        uint32_t too_long[] = {5, id};
+        ast.add(NodeKind::Call, id, ast.add_extra(too_long));
+    }));
+    CHECK(rejected([&](FlatAst& ast) {
+        NodeIndex type = ast.add(NodeKind::Type, x, 0);
+        ast.add_function({x, 0, type, 12345});
+    }));
+}
+
+// Threads of one process writing the same cache must not share a
+// temporary file.
+TEST(concurrent_ast_cache_writes_all_succeed) {
+    TempSource file;
+    std::atomic<int> failed{0};
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&] {
+            for (int i = 0; i < 20; i++)
+                failed += !write_cache(file);
+        });
+    }
+    for (std::thread& thread : threads)
+        thread.join();
+
+    CHECK(failed == 0);
+    CHECK(AstCache(file.cache.c_str()).ok());
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdio>
+#include <functional>
+#include <vector>
+
+// Just enough of a test framework for tests/unit. A TEST registers a
+// function that main() runs; a failed CHECK reports its line and fails the
+// test without stopping it.
+
+struct TestCase {
+    const char* name;
+    void (*body)();
+};
+
+std::vector<TestCase>& test_cases();
+bool& test_failed();
+
+inline bool register_test(const char* name, void (*body)()) {
+    test_cases().push_back({name, body});
+    return true;
+}
+
+#define TEST(name)                                                   \
+    static void name();                                              \
+    static const bool name##_registered = register_test(#name, name); \
+    static void name()
+
+#define CHECK(condition)                                                              \
+    do {                                                                              \
+        if (!(condition)) {                                                           \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            test_failed() = true;                                                     \
+        }                                                                             \
+    } while (0)
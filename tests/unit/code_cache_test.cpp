@@ -0,0 +1,119 @@
+#include "check.hpp"
+
+#include "fixtures.hpp"
+
+#include "arena.hpp"
+#include "code_cache.hpp"
+#include "codegen.hpp"
+#include "stats.hpp"
+#include "task_scheduler.hpp"
+
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+namespace {
+
+constexpr const char* program = R"(
+function twice(a: i64) => i64 {
+    return a * 2;
+}
+
+function main() => i64 {
+    return twice(21);
+}
+)";
+
+constexpr const char* edited = R"(
+function twice(a: i64) => i64 {
+    return a + a;
+}
+
+function main() => i64 {
+    return twice(21);
+}
+)";
+
+// Generates IR for `text` through a cache in `dir`, or without one.
+std::string generate(const char* text, const TempDir* dir, Stats* stats = nullptr) {
+    Program parsed(text);
+    Arena ir_arena;
+
+    std::optional<CodeCache> cache;
+    if (dir)
+        cache.emplace(dir->dir.string(), uint64_t(1) << 20);
+
+    CodegenOptions codegen{
+        .format = EmitFormat::Ir,
+        .cache  = cache ? &*cache : nullptr,
+        .source = parsed.source.text(),
+        .path   = "/test.txt",
+    };
+    TaskScheduler scheduler(1);
+    Emitter out(parsed.interner);
+    generate_code(parsed.fns, parsed.interner, codegen, scheduler, ir_arena, out, stats);
+    return out.take();
+}
+
+std::optional<std::string> cached(const char* text, const TempDir& dir) {
+    CodeCache cache(dir.dir.string(), uint64_t(1) << 20);
+    CodegenOptions codegen{
+        .format = EmitFormat::Ir,
+        .cache  = &cache,
+        .source = text,
+        .path   = "/test.txt",
+    };
+    return cached_output(codegen);
+}
+
+} // namespace
+
+TEST(unchanged_file_comes_from_its_manifest) {
+    TempDir dir;
+    std::string expected = generate(program, nullptr);
+
+    CHECK(!cached(program, dir));
+    CHECK(generate(program, &dir) == expected);
+    CHECK(cached(program, dir) == expected);
+    CHECK(!cached(edited, dir));
+}
+
+TEST(edited_file_finds_unchanged_functions_in_its_manifest) {
+    TempDir dir;
+    generate(program, &dir);
+
+    Stats stats;
+    CHECK(generate(edited, &dir, &stats) == generate(edited, nullptr));
+    CHECK(stats.cache_hits == 1); // main, from the manifest
+    CHECK(stats.cache_misses == 1);
+    CHECK(cached(edited, dir) == generate(edited, nullptr));
+}
+
+// Another build's temporary file is left alone while it may still be being
+// written, and evicted once it is an hour old.
+TEST(eviction_skips_fresh_temporary_files) {
+    TempDir dir;
+    std::filesystem::path shard = dir.dir / "0";
+    std::filesystem::create_directories(shard);
+    std::filesystem::path temp = shard / "00000000000000000000000000000001.tmp.1.0";
+    std::ofstream(temp) << std::string(4096, 'x');
+
+    // Each shard may hold 64 bytes, so closing the cache evicts shard 0.
+    auto fill = [&] {
+        CodeCache cache(dir.dir.string(), 16 * 64);
+        cache.store(CacheKey{0, 2}, std::string(100, 'y'));
+    };
+
+    fill();
+    CHECK(std::filesystem::exists(temp));
+
+    struct timespec old[2] = {{0, UTIME_OMIT}, {time(nullptr) - 7200, 0}};
+    CHECK(utimensat(AT_FDCWD, temp.c_str(), old, 0) == 0);
+    fill();
+    CHECK(!std::filesystem::exists(temp));
+}
@@ -0,0 +1,153 @@
+#include "check.hpp"
+
+#include "fixtures.hpp"
+
+#include "arena.hpp"
+#include "codegen.hpp"
+#include "ir.hpp"
+#include "ir_passes.hpp"
+#include "task_scheduler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+
+namespace {
+
+// Branches and constants, so that the passes add phi operands, entry
+// constants and predecessors, growing the function's vectors.
+constexpr const char* branchy = R"(
+function pick(a: i64, b: i64) => i64 {
+    let x: i64 = 1;
+    if a < b {
+        return x * 7 + a;
+    } else {
+        if b < a {
+            let y: i64 = 3;
+            return y + b / x;
+        }
+    }
+    return x + b / 3;
+}
+
+function main() => i64 {
+    return pick(1, 2) + pick(4, 3) + pick(5, 5);
+}
+)";
+
+std::string generate(Program& program, unsigned workers) {
+    TaskScheduler scheduler(workers);
+    Arena arena;
+    Emitter out(program.interner);
+    generate_code(program.fns, program.interner, CodegenOptions{}, scheduler, arena, out);
+    return out.take();
+}
+
+} // namespace
+
+// One worker lowers a function and queues its optimization, then waits
+// until the other has stolen and run it, as in generate_code(). The passes
+// must then allocate from the thief's arena only: the lowering worker could
+// be lowering the next function into its own arena meanwhile.
+TEST(optimize_after_steal_leaves_lowering_arena_alone) {
+    Program program(branchy);
+    IrLowering lowering(program.fns, program.interner);
+    PassManager passes = PassManager::standard();
+
+    Arena module_arena;
+    Arena arenas[2];
+    IrModule module = lowering.declare(module_arena);
+
+    std::atomic<bool> optimized{false};
+    unsigned lowerer   = 0;
+    unsigned optimizer = 0;
+    size_t before      = 0;
+    size_t after       = 0;
+
+    TaskScheduler scheduler(2);
+    uint64_t lower = 0;
+    scheduler.run(std::span(&lower, 1), [&](uint64_t task, unsigned worker) {
+        if (task == 0) {
+            lowerer = worker;
+            lowering.lower(module, 0, arenas[worker]);
+            scheduler.spawn(worker, 1);
+            while (!optimized.load(std::memory_order_acquire))
+                std::this_thread::yield();
+            return;
+        }
+
+        std::vector<PassReport> reports;
+        before = arenas[lowerer].used();
+        module.functions[0].rehome(arenas[worker]);
+        passes.run(module.functions[0], reports);
+        after     = arenas[lowerer].used();
+        optimizer = worker;
+        optimized.store(true, std::memory_order_release);
+    });
+
+    CHECK(optimizer != lowerer);
+    CHECK(scheduler.steals() >= 1);
+    CHECK(before == after);
+    CHECK(arenas[optimizer].used() > 0);
+}
+
+// Many small functions on many workers steal each other's optimize and
+// write tasks; the output must not change.
+TEST(parallel_codegen_matches_one_worker) {
+    std::string text;
+    for (int i = 0; i < 400; i++) {
+        std::string n = std::to_string(i);
+        text += "function f" + n + "(a: i64, b: i64) => i64 {\n    let x: i64 = " + n +
+                ";\n    if a < b {\n        return a * 3;\n    } else {\n        return b + x;\n    }\n    "
+                "return x / 2;\n}\n\n";
+    }
+    text += "function main() => i64 {\n    return f1(1, 2) + f399(5, 4);\n}\n";
+
+    Program program(text);
+    std::string expected = generate(program, 1);
+    for (int run = 0; run < 20; run++)
+        CHECK(generate(program, 8) == expected);
+}
+
+// The exit block's phi takes one entry per return, past what 16 bits hold.
+TEST(exit_phi_keeps_every_return) {
+    std::string text = "function f(a: i64) => i64 {\n";
+    for (int i = 0; i < 70000; i++)
+        text += "    if a > " + std::to_string(i) + " {\n        return " + std::to_string(i) + ";\n    }\n";
+    text += "    return 0;\n}\n";
+
+    Program program(text);
+    Arena arena;
+    IrModule module     = lower_ir(program.fns, program.interner, arena);
+    const IrFunction& f = module.functions[0];
+    uint32_t most       = 0;
+    for (const IrInst& inst : f.insts) {
+        if (inst.op == IrOp::Phi)
+            most = std::max(most, inst.count);
+    }
+    CHECK(most == 70001);
+}
+
+// Threading every arm of a long if/else chain into the exit block must not
+// copy the exit phi once per arm, which took memory quadratic in the arms.
+TEST(passes_on_long_else_if_chain_stay_linear) {
+    constexpr int arms = 5000;
+    std::string text   = "function f(a: i64) => i64 {\n    if a < 0 {\n        return 0;\n    }\n";
+    for (int i = 0; i < arms; i++) {
+        std::string n = std::to_string(i);
+        text += "    else {\n    if a < " + n + " {\n        return " + n + ";\n    }\n";
+    }
+    text += "    return 1;\n";
+    for (int i = 0; i < arms; i++)
+        text += "    }\n";
+    text += "    return 2;\n}\n";
+
+    Program program(text);
+    Arena arena;
+    IrModule module = lower_ir(program.fns, program.interner, arena);
+    size_t lowered  = arena.used();
+    (void)PassManager::standard().run(module);
+
+    CHECK(arena.used() - lowered < lowered);
+}
@@ -0,0 +1,30 @@
+#include "check.hpp"
+
+#include "emitter.hpp"
+#include "interner.hpp"
+
+#include <string>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+// Every write to /dev/full fails with ENOSPC.
+TEST(emitter_reports_failed_writes) {
+    int fd = open("/dev/full", O_WRONLY | O_CLOEXEC);
+    CHECK(fd >= 0);
+    if (fd < 0)
+        return;
+
+    Interner names;
+    {
+        Emitter out(names, EmitFormat::Tree, fd);
+        out.put("function main() => i64 {}\n");
+        CHECK(!out.flush());
+        CHECK(!out.flush()); // stays failed with nothing left to write
+    }
+    close(fd);
+
+    Emitter memory(names);
+    memory.put("x");
+    CHECK(memory.flush());
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "arena.hpp"
+#include "interner.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+#include "resolver.hpp"
+#include "source.hpp"
+#include "type_table.hpp"
+
+#include <cstdlib>
+#include <filesystem>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+// Shared setup for tests/unit.
+
+// `text` parsed into functions, and resolved unless `resolved` is false so
+// that a test can call resolve() itself and catch what it throws.
+struct Program {
+    Source source;
+    Arena lexer_arena;
+    Arena parser_arena;
+    Arena resolver_arena;
+    Interner interner;
+    TypeTable types;
+    std::vector<FunctionDecl*> fns;
+
+    explicit Program(std::string_view text, bool resolved = true) : source("<test>", text) {
+        Lexer lexer(source, lexer_arena);
+        Parser parser(lexer, parser_arena, interner, types);
+        fns = parser.parse();
+        if (resolved)
+            resolve();
+    }
+
+    void resolve() { Resolver(source, resolver_arena, interner).resolve(fns); }
+};
+
+// A fresh directory under /tmp, removed with everything in it.
+struct TempDir {
+    std::filesystem::path dir;
+
+    TempDir() {
+        char name[] = "/tmp/unit-test-XXXXXX";
+        dir         = mkdtemp(name);
+    }
+
+    ~TempDir() {
+        std::error_code ignored;
+        std::filesystem::remove_all(dir, ignored);
+    }
+
+    TempDir(const TempDir&)            = delete;
+    TempDir& operator=(const TempDir&) = delete;
+};
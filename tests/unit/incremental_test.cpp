@@ -0,0 +1,61 @@
+#include "check.hpp"
+
+#include "fixtures.hpp"
+
+#include "emitter.hpp"
+#include "incremental.hpp"
+#include "interner.hpp"
+#include "source.hpp"
+
+#include <string>
+
+namespace {
+
+std::string program(int count) {
+    std::string text;
+    for (int i = 0; i < count; i++) {
+        std::string n = std::to_string(i);
+        text += "function f" + n + "(a: i64) => i64 {\n    let x: i64 = a + " + n + ";\n    return x * 2;\n}\n\n";
+    }
+    return text;
+}
+
+// Tree dump of a fresh parse of `text`.
+std::string full_parse(const std::string& text) {
+    Program parsed(text, false);
+    Emitter out(parsed.interner);
+    out.program(parsed.fns);
+    return out.take();
+}
+
+} // namespace
+
+TEST(incremental_edits_match_full_parse) {
+    std::string text = program(20);
+    Interner interner;
+    IncrementalParser parser(interner);
+    {
+        Source source("<test>", text);
+        parser.parse(source);
+    }
+
+    // Enough one-byte edits to push the arena past its limit several times.
+    bool rebuilt_all = false;
+    for (uint32_t i = 0; i < 200; i++) {
+        const FunctionDecl* fn = parser.functions()[i * 7 % 20];
+        uint32_t at            = fn->span.begin + 8; // after `function`
+        text.insert(at, " ");
+
+        Source source("<test>", text);
+        TextEdit edit{at, at, 1};
+        const auto& fns = parser.reparse(source, {&edit, 1});
+        CHECK(fns.size() == 20);
+        rebuilt_all |= parser.reparsed() == fns.size();
+    }
+    CHECK(rebuilt_all);
+
+    Emitter out(interner);
+    out.program(parser.functions());
+    CHECK(out.take() == full_parse(text));
+    CHECK(parser.functions().back()->span.end == text.size() - 2);
+}
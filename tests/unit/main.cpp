@@ -0,0 +1,41 @@
+#include "check.hpp"
+
+#include <cstring>
+#include <exception>
+
+std::vector<TestCase>& test_cases() {
+    static std::vector<TestCase> cases;
+    return cases;
+}
+
+bool& test_failed() {
+    static bool failed = false;
+    return failed;
+}
+
+// Runs every test, or only those whose names are given, and exits with the
+// number that failed.
+int main(int argc, char* argv[]) {
+    int failures = 0;
+
+    for (const TestCase& test : test_cases()) {
+        bool selected = argc == 1;
+        for (int i = 1; i < argc; i++)
+            selected |= std::strcmp(argv[i], test.name) == 0;
+        if (!selected)
+            continue;
+
+        test_failed() = false;
+        try {
+            test.body();
+        } catch (const std::exception& e) {
+            std::fprintf(stderr, "%s: threw %s\n", test.name, e.what());
+            test_failed() = true;
+        }
+
+        std::printf("%s %s\n", test_failed() ? "FAIL" : "ok  ", test.name);
+        failures += test_failed();
+    }
+
+    return failures;
+}
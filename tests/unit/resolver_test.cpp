@@ -0,0 +1,37 @@
+#include "check.hpp"
+
+#include "fixtures.hpp"
+
+#include "error.hpp"
+
+#include <string>
+
+namespace {
+
+// The resolver's message, or "" if the program resolves.
+std::string resolve(const char* text) {
+    Program program(text, false);
+    try {
+        program.resolve();
+    } catch (const CompileError& e) {
+        return e.what();
+    }
+    return "";
+}
+
+} // namespace
+
+TEST(resolver_rejects_duplicate_parameters) {
+    CHECK(resolve("function f(a: i64, a: i64) => i64 {\n    return a;\n}\n") ==
+          "error: parameter `a` is defined more than once in function `f` on line 1, column 20");
+}
+
+TEST(resolver_rejects_duplicate_lets_in_one_scope) {
+    CHECK(resolve("function f() => i64 {\n    let x: i64 = 1;\n    let x: i64 = 2;\n    return x;\n}\n") ==
+          "error: variable `x` is defined more than once in function `f` on line 3, column 5");
+}
+
+TEST(resolver_allows_shadowing_outer_names) {
+    CHECK(resolve("function f(x: i64) => i64 {\n    let x: i64 = x;\n    if x {\n        let x: i64 = 2;\n"
+                  "        return x;\n    }\n    return x;\n}\n") == "");
+}